@@ -8,10 +8,31 @@ namespace AppData {
 QString dataDir();
 // Primary inventory storage path.
 QString inventoryFilePath();
+// Binary snapshot of the inventory (a load cache kept next to the CSV).
+QString inventorySnapshotPath();
+// Append-only log of edits made since the CSV was last written.
+QString inventoryJournalPath();
+// Per-product reorder levels (id,level) kept next to the CSV.
+QString reorderLevelsPath();
+// SQLite database for the SQLite storage backend.
+QString databasePath();
 // Primary users storage path.
 QString usersFilePath();
+// Sealed blocks of per-product stock movements.
+QString stockHistoryPath();
+// Recent stock movements not yet in a block.
+QString stockHistoryLogPath();
+// Lock file held by the one process that writes the data files.
+QString lockFilePath();
 // Ensure the AppData directory exists on disk.
 bool ensureDataDir(QString *errorMessage = nullptr);
+// Take the data folder's write lock for the rest of the process. False
+// (with the reason) when another process holds it; open read-only then.
+bool lockDataDir(QString *errorMessage = nullptr);
+// True once lockDataDir has succeeded in this process.
+bool hasDataLock();
+// Size and mtime identifying a file's current contents (-1 when missing).
+void fileStamp(const QString &path, qint64 *size, qint64 *modified);
 }
 
 #endif
@@ -0,0 +1,41 @@
+#ifndef BATCHJOB_H
+#define BATCHJOB_H
+
+#include <QString>
+#include <QStringList>
+
+class InventoryStore;
+class QTextStream;
+
+// Commands of the headless batch tool (SupermarketInventoryBatch). Each
+// command prints one compact JSON object on its own line: "command", "ok",
+// then counts on success or "error" on failure.
+namespace BatchJob {
+
+// Process exit codes; scripts and cron can rely on these staying put.
+enum ExitCode {
+    Ok = 0,
+    // A command failed, or validate found bad data.
+    Failed = 1,
+    // Bad command line or script line.
+    Usage = 2,
+    // Wrong username or password, or a write by a non-admin.
+    Denied = 3,
+    // The inventory or users could not be opened, loaded or saved, or a
+    // write was asked for while another process holds the data folder.
+    StorageError = 4
+};
+
+// Run one command (its name, then its arguments) against a loaded store.
+ExitCode run(InventoryStore *store, bool admin, const QStringList &command,
+             QTextStream &out);
+
+// Split a script line into words; double quotes keep spaces in a word.
+QStringList splitLine(const QString &line);
+
+// Command-line help.
+QString usage();
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef INVENTORYEXPORTER_H
+#define INVENTORYEXPORTER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include "productstore.h"
+
+class QThread;
+
+// Streams products to a file on a worker thread. Like InventorySaver it
+// works on an implicitly shared ProductStore copy, so the export sees one
+// consistent state while edits continue. Output is written through a small
+// buffer, so memory stays flat however many rows are exported.
+class InventoryExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        // id,name,price,quantity (same layout as inventory.csv).
+        Csv,
+        // One JSON object per line.
+        JsonLines,
+        // "SMINVEXP" header, then price (cents), quantity, ID and name columns.
+        Binary,
+        // Human-readable ID:/Name:/Price:/Qty: blocks.
+        Report
+    };
+
+    explicit InventoryExporter(QObject *parent = nullptr);
+    // Cancels and waits for a running export.
+    ~InventoryExporter();
+
+    // Write rows of products (in that order; empty means every product) to
+    // path on the calling thread. cancelled may be null.
+    static bool writeFile(const ProductStore &products, const QVector<int> &rows,
+                          Format format, const QString &path, QString *errorMessage,
+                          const QAtomicInt *cancelled = nullptr,
+                          InventoryExporter *reporter = nullptr);
+
+    // True while a background export is running.
+    bool isBusy() const;
+    // Start a background export. Returns false if one is already running.
+    bool start(const ProductStore &products, const QVector<int> &rows, Format format,
+               const QString &path);
+    // Ask a running export to stop; the file is left untouched.
+    void cancel();
+
+signals:
+    void progress(qint64 done, qint64 total);
+    void finished(bool ok, bool cancelled, qint64 rows, const QString &errorMessage);
+
+private:
+    void collect();
+
+    QThread *worker;
+    QAtomicInt cancelRequested;
+    bool ok;
+    qint64 rowsWritten;
+    QString error;
+};
+
+#endif
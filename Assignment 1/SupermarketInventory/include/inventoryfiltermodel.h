@@ -0,0 +1,50 @@
+#ifndef INVENTORYFILTERMODEL_H
+#define INVENTORYFILTERMODEL_H
+
+#include <QBitArray>
+#include <QSortFilterProxyModel>
+#include <QString>
+
+class InventoryModel;
+class InventoryStore;
+
+// Search filter over an InventoryModel. Text searches of three or more
+// characters are answered by the store's trigram index, everything else by a
+// vectorized scan of the store's case-folded text. Sorting is handed to the
+// source model, which orders rows with the store's cached sorter (and
+// narrows them to the low-stock ones); this proxy keeps the source order.
+class InventoryFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit InventoryFilterModel(QObject *parent = nullptr);
+
+    // Case-insensitive substring filter over every column (empty shows all).
+    void setSearchText(const QString &text);
+    QString searchText() const;
+
+    // Store row shown at a proxy index.
+    int storeRow(const QModelIndex &proxyIndex) const;
+
+    void setSourceModel(QAbstractItemModel *model) override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    const InventoryModel *source() const;
+    const InventoryStore *inventory() const;
+    void computeMatches();
+    void refreshMatches();
+
+    QString search;
+    // Rows matched by the index or scan, valid while the store is still at
+    // matchesRevision; later single-row changes are checked one by one.
+    QBitArray matches;
+    quint64 matchesRevision = 0;
+    bool haveMatches = false;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef INVENTORYHISTORY_H
+#define INVENTORYHISTORY_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "productstore.h"
+
+// The fields of one row that an edit changed, with the values to put back.
+// Unchanged fields are left empty, so a price tweak costs a few bytes.
+// Quantity is the change to add back rather than a value, so sales applied
+// since the edit survive its undo.
+struct FieldDelta {
+    enum Field { Id = 1, Name = 2, Price = 4, Quantity = 8 };
+    int row = 0;
+    int fields = 0;
+    Product values;
+};
+
+// One undoable (or redoable) step. Applying it sets changes (last first),
+// removes removeCount rows at first, then inserts products at first.
+// Applying a step yields its inverse, which goes on the opposite stack.
+struct HistoryStep {
+    QString label;
+    QVector<FieldDelta> changes;
+    int first = 0;
+    int removeCount = 0;
+    QVector<Product> products;
+    // Reorder levels of products that had their own, by ID, put back with
+    // them.
+    QHash<QString, int> reorderLevels;
+};
+
+// Undo and redo stacks with a memory cap. The oldest steps are dropped once
+// the estimated size of both stacks passes the limit.
+class InventoryHistory
+{
+public:
+    explicit InventoryHistory(qint64 limitBytes = 32 * 1024 * 1024);
+
+    void clear();
+    void setLimit(qint64 limitBytes);
+    qint64 limit() const;
+    qint64 memoryUsed() const;
+
+    // A new edit: clears the redo stack.
+    void record(const HistoryStep &undo);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    QString undoLabel() const;
+    QString redoLabel() const;
+
+    // Move steps between the stacks (callers push the applied inverse).
+    HistoryStep takeUndo();
+    HistoryStep takeRedo();
+    void pushUndo(const HistoryStep &step);
+    void pushRedo(const HistoryStep &step);
+
+    // Rough heap footprint of a step.
+    static qint64 cost(const HistoryStep &step);
+
+private:
+    void trim();
+
+    QVector<HistoryStep> undoSteps;
+    QVector<HistoryStep> redoSteps;
+    qint64 limitBytes;
+    qint64 usedBytes;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef INVENTORYIMPORT_H
+#define INVENTORYIMPORT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "productstore.h"
+
+// One line of an import file that could not be used.
+struct ImportRejection {
+    // 1-based line number in the file.
+    int line = 0;
+    QString reason;
+    QString text;
+};
+
+// Parsed supplier file: valid products in file order plus rejected lines.
+struct ImportResult {
+    QVector<Product> products;
+    QVector<ImportRejection> rejected;
+    int lines = 0;
+};
+
+// Bulk import of supplier CSV files ("id,name,price,quantity"). The file is
+// split into byte ranges on line boundaries and parsed on all cores.
+namespace InventoryImport {
+
+// Parse and validate the file at path.
+bool parseFile(const QString &path, ImportResult *out, QString *errorMessage);
+// Same for data already in memory.
+void parseData(const QByteArray &data, ImportResult *out);
+
+// Write rejected lines as a CSV report ("line,reason,text").
+bool writeRejections(const QVector<ImportRejection> &rejected, const QString &path,
+                     QString *errorMessage);
+
+}
+
+#endif
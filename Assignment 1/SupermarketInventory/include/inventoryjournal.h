@@ -0,0 +1,77 @@
+#ifndef INVENTORYJOURNAL_H
+#define INVENTORYJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include "productstore.h"
+
+// One recorded mutation.
+struct JournalEntry {
+    enum Op { Add, Update, Delete };
+    Op op = Add;
+    // Product ID the entry applies to (the old ID for updates).
+    QString key;
+    // New values (unused for deletes).
+    Product product;
+};
+
+// Append-only log of inventory edits kept next to inventory.csv.
+// The first line stamps the CSV state the entries apply to. A save is a
+// checkpoint: edits made while the CSV is rewritten go to a pending segment,
+// and once the new CSV is in place the journal is re-stamped for it and keeps
+// only those edits. Appends are flushed right away; bursts share one fsync a
+// few milliseconds later.
+class InventoryJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InventoryJournal(const QString &path, QObject *parent = nullptr);
+    ~InventoryJournal();
+
+    // Open for appending and return the entries recorded against the CSV at
+    // csvPath. A journal stamped for another CSV state is discarded, as are
+    // torn trailing lines; a leftover pending segment is folded in.
+    bool open(const QString &csvPath, QVector<JournalEntry> *out, QString *errorMessage);
+
+    // Route new edits to the pending segment while the CSV is rewritten.
+    bool beginCheckpoint(QString *errorMessage);
+    // Fold the pending segment back in. When saved is true the journal is
+    // re-stamped for the CSV now at csvPath and keeps only the pending edits.
+    bool finishCheckpoint(const QString &csvPath, bool saved, QString *errorMessage);
+
+    // Record one edit. Returns false if the write failed.
+    bool logAdd(const Product &product);
+    bool logUpdate(const QString &oldId, const Product &product);
+    bool logDelete(const QString &id);
+    // Record a batch of upserts with a single write.
+    bool logUpserts(const QVector<Product> &products);
+    // Record a batch of deletes with a single write.
+    bool logDeletes(const QStringList &ids);
+
+    // Entries written since the last reset or checkpoint.
+    int entryCount() const;
+
+public slots:
+    // Flush and fsync anything pending.
+    void sync();
+
+private:
+    bool append(const QByteArray &lines, int count = 1);
+    bool rewrite(const QByteArray &header, const QByteArray &body, QString *errorMessage);
+    bool openForAppend(const QString &path, QString *errorMessage);
+
+    QString mainPath;
+    QString pendingPath;
+    QByteArray pendingToken;
+    QFile file;
+    QTimer syncTimer;
+    int entries;
+};
+
+#endif
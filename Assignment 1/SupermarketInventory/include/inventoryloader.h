@@ -0,0 +1,41 @@
+#ifndef INVENTORYLOADER_H
+#define INVENTORYLOADER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include "productstore.h"
+
+// Parse one inventory CSV line ("id,name,price,quantity"). Header, blank and
+// malformed lines return false.
+bool parseProductLine(const QString &line, Product *out);
+
+// Streams inventory.csv on a worker thread and hands rows over in batches,
+// so the table can show the first rows while the rest is still parsing.
+class InventoryLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InventoryLoader(const QString &path, QObject *parent = nullptr);
+
+    // Ask a running load to stop early (safe from any thread); it then
+    // finishes with ok false.
+    void cancel();
+
+public slots:
+    // Read the whole file; call this on the worker thread.
+    void run();
+
+signals:
+    void batchReady(const QVector<Product> &products);
+    void progress(qint64 bytesRead, qint64 bytesTotal);
+    void finished(bool ok, const QString &errorMessage);
+
+private:
+    QString path;
+    QAtomicInt cancelled;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef INVENTORYMODEL_H
+#define INVENTORYMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include "productsorter.h"
+
+class InventoryStore;
+
+// Table model over an InventoryStore. Cells are produced on demand, so the
+// view only ever touches the rows that are on screen; the store's row
+// signals are forwarded as model signals. When sorted, rows are shown in
+// the order the store's sorter keeps, and edits that move a row are sent as
+// row moves. The low-stock view shows only the rows of the store's
+// low-stock index, so showing and refreshing it is O(k) in the flagged
+// count rather than a pass over the catalog.
+class InventoryModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    // Table layout.
+    enum Column { ColId = 0, ColName, ColPrice, ColQty, ColumnCount };
+
+    explicit InventoryModel(InventoryStore *store, QObject *parent = nullptr);
+
+    // ---- QAbstractTableModel ----
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+    // Sort by column first, keeping earlier sort columns as tie-breakers
+    // (e.g. Name then Quantity sorts by quantity, then name). A negative
+    // column restores file order.
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    // Only show products at or below their reorder level (in the current
+    // sort order, or most urgent first when unsorted).
+    void setLowStockOnly(bool enabled);
+    bool lowStockOnly() const;
+
+    // The store this model shows.
+    InventoryStore *inventory() const;
+    // Store row shown at a model row.
+    int storeRow(int row) const;
+
+private:
+    void beginStoreInsert(int first, int last);
+    void endStoreInsert();
+    void beginStoreRemove(int first, int last);
+    void endStoreRemove();
+    void storeRowChanged(int row);
+    void storeRowsChanged(const QVector<int> &rows);
+    // Switch to another order, carrying persistent indexes along.
+    void setOrder(const QVector<SortKey> &nextKeys, const QVector<int> &nextOrder);
+    // True when model rows are store rows (whole catalog, file order).
+    bool inFileOrder() const;
+    // Rows shown for these keys: the sorter's order, or the low-stock rows.
+    QVector<int> rowsFor(const QVector<SortKey> &sortKeys) const;
+    // Rebuild positions after order was replaced.
+    void indexOrder();
+    // Bring the low-stock rows up to date after rows changed in place.
+    void syncLowStock();
+
+    InventoryStore *source;
+    // Active sort keys (empty for file order) and the rows in that order.
+    QVector<SortKey> keys;
+    QVector<int> order;
+    // Inverse of order (store row -> model row) while the whole catalog is
+    // sorted; empty otherwise.
+    QVector<int> positions;
+    bool lowOnly = false;
+    // Store rows of the insert or remove in progress, and whether it was
+    // turned into a reset.
+    int pendingFirst = 0;
+    int pendingLast = 0;
+    bool pendingReset = false;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef INVENTORYSAVER_H
+#define INVENTORYSAVER_H
+
+#include <QObject>
+#include <QString>
+#include "productstore.h"
+
+class QThread;
+
+// Writes inventory.csv and its snapshot on a worker thread. The caller hands
+// over a ProductStore copy; its columns are implicitly shared, so taking the
+// copy is O(1) and later edits on the GUI thread do not disturb the write.
+class InventorySaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InventorySaver(QObject *parent = nullptr);
+    // Waits for a running save.
+    ~InventorySaver();
+
+    // Write products to the CSV and snapshot paths on the calling thread.
+    static bool writeFiles(const ProductStore &products, QString *errorMessage);
+
+    // True while a background save is running.
+    bool isBusy() const;
+    // Start a background save. Returns false if one is already running.
+    bool start(const ProductStore &products);
+    // Block until a running save is done (finished is emitted before return).
+    void waitForFinished();
+
+signals:
+    void finished(bool ok, qint64 elapsedMs, const QString &errorMessage);
+
+private:
+    void collect();
+
+    QThread *worker;
+    quint64 jobs;
+    bool ok;
+    qint64 elapsedMs;
+    QString error;
+};
+
+#endif
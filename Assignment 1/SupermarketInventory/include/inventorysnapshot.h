@@ -0,0 +1,33 @@
+#ifndef INVENTORYSNAPSHOT_H
+#define INVENTORYSNAPSHOT_H
+
+#include <QString>
+
+class ProductStore;
+
+// Versioned binary snapshot of the inventory. Layout (native little-endian,
+// every section 8-byte aligned):
+//   64-byte header (magic, version, row count, text length, CSV size and
+//   mtime it was built from, checksum of everything after the header)
+//   qint64   priceCents[rows]
+//   qint32   quantity[rows]           (padded)
+//   quint32  idSlice[rows][2]         (offset, length into the text heap)
+//   quint32  nameSlice[rows][2]
+//   char16   text[textLength]         (padded)
+// The file is mapped and its columns copied straight into a ProductStore.
+// inventory.csv stays the source of truth: a snapshot that does not match
+// the CSV's size and mtime is treated as stale.
+namespace InventorySnapshot {
+
+// Write a snapshot of products, stamped with the current state of csvPath.
+bool write(const ProductStore &products, const QString &snapshotPath,
+           const QString &csvPath, QString *errorMessage);
+
+// Load a snapshot if it exists, is intact and matches csvPath.
+// Returns false (with out untouched) when the caller should fall back to CSV.
+bool read(const QString &snapshotPath, const QString &csvPath,
+          ProductStore *out, QString *errorMessage);
+
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef INVENTORYSTORE_H
+#define INVENTORYSTORE_H
+
+#include <QBitArray>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "inventoryhistory.h"
+#include "lowstockindex.h"
+#include "productsorter.h"
+#include "productstore.h"
+#include "salesqueue.h"
+#include "scanbuffer.h"
+#include "searchindex.h"
+#include "stockhistory.h"
+
+// Running totals over a set of products. Value is kept in whole cents, so
+// it stays exact however many edits are applied.
+struct InventoryTotals {
+    int products = 0;
+    qint64 units = 0;
+    qint64 valueCents = 0;
+    int lowStock = 0;
+};
+
+// Outcome of applying a batch of stock changes.
+struct StockDeltaResult {
+    // Rows whose quantity changed.
+    int applied = 0;
+    // IDs not in the catalog (skipped).
+    int unknown = 0;
+    // Products that would have gone below zero and were stopped at zero.
+    int clamped = 0;
+};
+
+class InventoryJournal;
+class InventoryLoader;
+class InventorySaver;
+class StorageBackend;
+struct JournalEntry;
+class QThread;
+class QTimer;
+
+// The inventory without any UI: products, validation, search and
+// persistence (CSV, snapshot, journal and autosave, or a StorageBackend).
+// Depends on QtCore only (backends such as SqliteBackend live in their own
+// libraries), so batch jobs and benchmarks can drive it directly; views
+// listen to the row signals.
+class InventoryStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InventoryStore(QObject *parent = nullptr);
+    // Stops a running load and waits for a running save.
+    ~InventoryStore();
+
+    // Check raw field text and build a product from it.
+    static bool parseProduct(const QString &id, const QString &name, const QString &price,
+                             const QString &quantity, Product *out, QString *errorMessage);
+
+    // ---- Reads ----
+    const ProductStore &products() const;
+    int size() const;
+    // Row holding this product ID, or -1.
+    int find(const QString &id) const;
+    // Rows with needle in any column (case-insensitive). Uses the trigram
+    // index when it can, otherwise one scan of the case-folded text.
+    void filter(const QString &needle, QBitArray *rows) const;
+    // Same test for a single row.
+    bool matches(int row, const QString &needle) const;
+    // Bumped on every write; equal revisions mean identical contents.
+    quint64 revision() const;
+    // True while edits are not yet in inventory.csv (never with a backend).
+    bool isModified() const;
+    bool isLoading() const;
+
+    // Read-only stores reject writes and never save (journal replay still applies).
+    void setWritable(bool enabled);
+    bool isWritable() const;
+
+    // Keep products in this backend (not owned) instead of the CSV files;
+    // every edit is written through as it is made. Set before load.
+    void setBackend(StorageBackend *storage);
+    StorageBackend *storageBackend() const;
+
+    // Totals over every product, maintained on each write (O(1)).
+    InventoryTotals totals() const;
+    // Totals over just these rows (e.g. the ones a filter shows).
+    InventoryTotals totals(const QVector<int> &rows) const;
+    // Price of row in whole cents.
+    qint64 priceCents(int row) const;
+
+    // Rows ordered by keys (see ProductSorter). Sorted on all cores the
+    // first time, then cached and kept in step with single-row edits, so
+    // switching between recent orders is free. Valid until the next write.
+    const QVector<int> &sortedRows(const QVector<SortKey> &keys) const;
+    // Position of a row in that order (O(1) once cached).
+    int sortedPosition(const QVector<SortKey> &keys, int row) const;
+
+    // ---- Reorder levels ----
+    // Stock at or below this level is low (10 unless set for the product).
+    int reorderLevel(int row) const;
+    bool isLowStock(int row) const;
+    // Low rows, furthest below their level first; O(k) in the low count.
+    QVector<int> lowStockRows() const;
+    int lowStockCount() const;
+    // Set a product's level (negative is rejected); reorder.csv is written
+    // with the next autosave or save.
+    bool setReorderLevel(int row, int level, QString *errorMessage);
+
+    // ---- Writes (false with a message on bad input or a duplicate ID) ----
+    bool add(const Product &product, QString *errorMessage);
+    bool update(int row, const Product &product, QString *errorMessage);
+    bool remove(int row, QString *errorMessage);
+    // Update the rows whose IDs exist and append the rest, in order, as one
+    // batch (views see a single reset). Counts are optional.
+    bool upsert(const QVector<Product> &batch, int *inserted, int *updated,
+                QString *errorMessage);
+
+    // Add the sales' deltas (negative for units sold) to quantities as one
+    // batch: each product is written once, indexes, totals and low-stock
+    // flags follow, the changes are journaled in one write, and views get a
+    // single rowsChanged. Stock stops at zero, and each sale enters the
+    // stock history at its own timestamp. Not undoable, since these are not
+    // edits made here.
+    bool applyStockDeltas(const QVector<SaleEvent> &sales, StockDeltaResult *result,
+                          QString *errorMessage);
+
+    // ---- Stock history ----
+    // Every quantity change made through the store (sales, edits, adds and
+    // deletes), opened by load and written with each edit, like the journal.
+    const StockHistory &stockHistory() const;
+
+    // ---- Undo (add, update, delete and import) ----
+    bool canUndo() const;
+    bool canRedo() const;
+    // Label of the step undo/redo would apply, e.g. "Delete P-100".
+    QString undoText() const;
+    QString redoText() const;
+    bool undo(QString *errorMessage);
+    bool redo(QString *errorMessage);
+    // Cap on the memory both stacks may use; the oldest steps go first.
+    void setHistoryLimit(qint64 bytes);
+
+    // ---- Persistence ----
+    // Load inventory.csv (straight from the snapshot when it is current) and
+    // replay the journal. In the background the CSV is parsed on a worker
+    // and loadFinished reports the end; otherwise this blocks. A load that
+    // fails or is cancelled leaves the store read-only, so the partial
+    // catalog is never saved over the files.
+    bool load(bool background, QString *errorMessage);
+    // Stop a background load early.
+    void cancelLoad();
+    // Write everything now on the calling thread (waits for an autosave).
+    bool save(QString *errorMessage);
+
+signals:
+    // Row notifications for views.
+    void rowsAboutToBeInserted(int first, int last);
+    void rowsInserted();
+    void rowsAboutToBeRemoved(int first, int last);
+    void rowsRemoved();
+    void rowChanged(int row);
+    // Many rows changed in place at once (ascending store rows).
+    void rowsChanged(const QVector<int> &rows);
+    void aboutToReset();
+    void resetDone();
+
+    void loadProgress(qint64 bytesRead, qint64 bytesTotal);
+    void loadFinished(bool ok, const QString &errorMessage);
+    void saveFinished(bool ok, qint64 elapsedMs, int changed, const QString &errorMessage);
+    // Undo/redo availability changed.
+    void historyChanged();
+    // Non-fatal problems (journal or history I/O) the user should hear
+    // about; a problem that persists is reported once.
+    void warning(const QString &message);
+
+public slots:
+    // Background save of a consistent copy; skipped when nothing changed.
+    void autosave();
+
+private slots:
+    void appendBatch(const QVector<Product> &batch);
+    void finishLoading(bool ok, const QString &errorMessage);
+    void completeSave(bool ok, qint64 elapsedMs, const QString &errorMessage);
+
+private:
+    static bool validate(const Product &product, QString *errorMessage);
+    bool checkWrite(QString *errorMessage) const;
+    int appendRow(const Product &product);
+    void updateRow(int row, const Product &product);
+    void removeRow(int row);
+    void insertProduct(int row, const Product &product);
+    void storeProduct(int row, const Product &product);
+    void storeQuantity(int row, int quantity);
+    void dropProduct(int row);
+    void truncateRows(int rows);
+    // Note a stock change for the history, now or at timestamp.
+    void recordMovement(const QString &id, int delta, StockMovement::Reason reason);
+    void recordMovement(const QString &id, int delta, StockMovement::Reason reason,
+                        qint64 timestamp);
+    void flushMovements();
+    static bool diffRow(int row, const Product &before, const Product &after,
+                        HistoryStep *undo);
+    void keepReorderLevel(int row, HistoryStep *step) const;
+    void recordStep(const HistoryStep &undo);
+    HistoryStep applyStep(const HistoryStep &step);
+    void resetRows(const ProductStore &replacement);
+    bool completeLoad(bool ok, const QString &loadError, QString *errorMessage);
+    bool replayJournal(QString *errorMessage);
+    void applyJournalEntry(const JournalEntry &entry);
+    void storeAdd(const Product &product);
+    void storeUpdate(const QString &oldId, const Product &product);
+    void storeDeletes(const QStringList &ids);
+    void storeBatch(const QVector<Product> &upserts, const QStringList &deletes);
+    void storeResult(bool written, const QString &errorMessage);
+    void reportStored();
+    void journalEdit(bool written);
+    void markDirty(const QString &id);
+    bool beginSave(QString *errorMessage);
+    void stopLoader();
+    void indexStock(int row);
+    void countRow(int row, int sign);
+    void loadReorderLevels();
+    bool saveReorderLevels(QString *errorMessage);
+    // Write reorder.csv if a level changed, warning on failure.
+    void flushReorderLevels();
+
+    ProductStore catalog;
+    SearchIndex trigramIndex;
+    ScanBuffer scanText;
+    ProductSorter sorter;
+    // Levels that differ from the default, by product ID, and the products
+    // currently at or below their level.
+    QHash<QString, int> reorderLevels;
+    LowStockIndex lowStock;
+    InventoryTotals running;
+    InventoryHistory history;
+    StockHistory movements;
+    bool reorderLevelsChanged;
+    quint64 changes;
+    bool writable;
+    // Background load state.
+    QThread *loaderThread;
+    InventoryLoader *loader;
+    bool loading;
+    // Journal entries being re-applied; their movements were recorded when
+    // the edits were first made.
+    bool replaying;
+    // Writes that failed last time; each problem is reported once until a
+    // write succeeds again.
+    bool historyFailing;
+    bool journalFailing;
+    StorageBackend *backend;
+    // Edits since the last full save.
+    InventoryJournal *journal;
+    // Autosave state: revision on disk, revision being written, and product
+    // IDs edited since the last save.
+    InventorySaver *saver;
+    QTimer *autosaveTimer;
+    quint64 savedRevision;
+    quint64 checkpointRevision;
+    QSet<QString> dirtyIds;
+    QSet<QString> savingIds;
+};
+
+#endif
@@ -19,6 +19,10 @@ public:
 
 private:
     Ui::LoginWindow *ui;
+    // True while a password check runs on a worker thread.
+    bool verifying;
+    void setBusy(bool busy);
+    void finishLogin(bool found, bool isAdmin);
 
 private slots:
     // Validate credentials and open the main window.
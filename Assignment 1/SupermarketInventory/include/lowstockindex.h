@@ -0,0 +1,32 @@
+#ifndef LOWSTOCKINDEX_H
+#define LOWSTOCKINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <set>
+#include <utility>
+
+// Products at or below their reorder level, ordered by stock minus level
+// (furthest below first). Only flagged products are kept, so listing them
+// is O(k) in the flagged count and each change is O(log k).
+class LowStockIndex
+{
+public:
+    void clear();
+
+    // Record a product's stock and level; it leaves the index once above.
+    void update(const QString &id, int quantity, int level);
+    void remove(const QString &id);
+
+    bool contains(const QString &id) const;
+    int size() const;
+    // Flagged product IDs, most urgent first.
+    QStringList ids() const;
+
+private:
+    std::set<std::pair<qint64, QString>> ordered;
+    QHash<QString, qint64> margins;
+};
+
+#endif
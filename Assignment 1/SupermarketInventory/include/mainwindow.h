@@ -5,8 +5,18 @@
 
 #include <QMainWindow>
 #include <QCloseEvent>
-
-class QTableWidgetItem;
+#include "productstore.h"
+
+class InventoryExporter;
+class InventoryStore;
+class SharedCatalogPublisher;
+class InventoryModel;
+class InventoryFilterModel;
+class SalesIngest;
+class QLabel;
+class QProgressBar;
+class QPushButton;
+class QTimer;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -34,33 +44,58 @@ protected:
 private:
     Ui::MainWindow *ui;
     bool admin;
+    // Products and persistence; the window only shows and edits them.
+    InventoryStore *inventory;
+    InventoryModel *inventoryModel;
+    InventoryFilterModel *filterModel;
+    QProgressBar *loadProgress;
+    InventoryExporter *exporter;
+    QProgressBar *exportProgress;
+    QPushButton *cancelExportBtn;
+    QTimer *dashboardTimer;
+    // Shares saved states with till processes (writable admins only).
+    SharedCatalogPublisher *catalogPublisher;
+    // Sales pushed by tills (writable admins only) and the figures shown for them.
+    SalesIngest *salesIngest;
+    QLabel *salesStatus;
+    quint64 salesSeen;
     // ---- UI setup helpers ----
     void initUi();
     void clearInputs();
     void populateInputsFromSelection();
+    void setWritesEnabled(bool enabled);
 
-    // ---- Validation and table helpers ----
-    bool getInputValues(QString *id, QString *name, double *price, int *qty,
-                        QString *errorMessage) const;
-    int findRowById(const QString &id, int excludeRow = -1) const;
-    void applyStockStyle(int row, int qty);
+    // ---- Input and selection helpers ----
+    bool readInputs(Product *product, QString *errorMessage) const;
+    bool readReorderLevel(int *level, QString *errorMessage) const;
+    int currentSourceRow() const;
     bool ensureAdmin(const QString &action);
-    QTableWidgetItem *ensureItem(int row, int column);
-    void setRowValues(int row, const QString &id, const QString &name,
-                      const QString &priceText, int qty);
-    bool rowToText(int row, QString *id, QString *name,
-                   QString *price, QString *qty) const;
     bool shouldIgnoreClear(QWidget *clicked) const;
+    void publishCatalog();
 
 private slots:
     // ---- Inventory actions ----
     void addProduct();
     void updateProduct();
     void deleteProduct();
+    void importProducts();
+    void undoEdit();
+    void redoEdit();
+    void updateHistoryButtons();
     void saveToFile();
     void loadFromFile();
+    void updateLoadProgress(qint64 bytesRead, qint64 bytesTotal);
+    void finishLoading(bool ok, const QString &errorMessage);
+    void reportSave(bool ok, qint64 elapsedMs, int changed, const QString &errorMessage);
+    void showWarning(const QString &message);
     void searchProduct();
+    void showLowStockOnly(bool enabled);
+    void updateDashboard();
     void exportReport();
+    void updateExportProgress(qint64 done, qint64 total);
+    void finishExport(bool ok, bool cancelled, qint64 rows, const QString &errorMessage);
+    void updateSalesStatus();
+    void setTracing(bool enabled);
     void logout();
 
 
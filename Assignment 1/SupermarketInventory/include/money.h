@@ -0,0 +1,37 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QString>
+
+// An amount of money in whole minor units (cents, kobo). Prices are parsed
+// straight into this and only turned back into text for display and files,
+// so sums and comparisons are exact integer operations.
+class Money
+{
+public:
+    Money() = default;
+    static Money fromCents(qint64 cents);
+
+    // Parse plain C-locale decimal text such as "12", "12.5" or "-0.99".
+    // Digits past the second decimal round to the nearest cent. False for
+    // anything else (grouping, exponents, empty text).
+    static bool parse(const QString &text, Money *out);
+    static bool parse(const QByteArray &text, Money *out);
+
+    qint64 cents() const;
+    // "12.34": always two decimals, no grouping.
+    QString toString() const;
+    QByteArray toLatin1() const;
+
+    bool operator==(Money other) const { return value == other.value; }
+    bool operator!=(Money other) const { return value != other.value; }
+    bool operator<(Money other) const { return value < other.value; }
+
+private:
+    qint64 value = 0;
+};
+Q_DECLARE_TYPEINFO(Money, Q_PRIMITIVE_TYPE);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+// Number of worker threads to use for count items when each thread should
+// get at least minPerThread of them.
+inline int threadCount(long long count, long long minPerThread)
+{
+    const long long hardware = std::max(1u, std::thread::hardware_concurrency());
+    const long long wanted = minPerThread > 0 ? count / minPerThread : hardware;
+    return static_cast<int>(std::max(1LL, std::min(hardware, wanted)));
+}
+
+// Split [0, count) into contiguous chunks and run fn(begin, end, chunk) on
+// each, one thread per chunk (the calling thread takes the first). Blocks
+// until every chunk is done. Returns the number of chunks used.
+template <typename Fn>
+int forChunks(long long count, long long minPerThread, Fn fn)
+{
+    const int chunks = threadCount(count, minPerThread);
+    if (chunks <= 1) {
+        fn(0LL, count, 0);
+        return 1;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    const long long step = (count + chunks - 1) / chunks;
+    for (int chunk = 1; chunk < chunks; ++chunk) {
+        const long long begin = std::min(count, chunk * step);
+        const long long end = std::min(count, begin + step);
+        workers.emplace_back([&fn, begin, end, chunk]() { fn(begin, end, chunk); });
+    }
+    fn(0LL, std::min(count, step), 0);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    return chunks;
+}
+
+}
+
+#endif
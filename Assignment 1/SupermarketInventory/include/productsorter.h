@@ -0,0 +1,70 @@
+#ifndef PRODUCTSORTER_H
+#define PRODUCTSORTER_H
+
+#include <QVector>
+
+class ProductStore;
+
+// One sort column and its direction.
+struct SortKey {
+    enum Column { Id, Name, Price, Quantity };
+    Column column = Id;
+    bool descending = false;
+
+    bool operator==(const SortKey &other) const
+    {
+        return column == other.column && descending == other.descending;
+    }
+};
+
+// Row orders (position -> store row) for lists of sort keys. Later keys
+// break ties of earlier ones and the row number breaks any that remain, so
+// every order is total and incremental updates land exactly where a full
+// sort would. An order is built with a parallel sort on first use; a few
+// recent ones stay cached, each with its inverse (store row -> position),
+// and follow single-row edits in O(n) without re-sorting. An edit that
+// leaves a row between the same neighbours costs O(1). Batch changes just
+// drop the cache.
+class ProductSorter
+{
+public:
+    // Rows of store ordered by keys (empty keys are not allowed). The
+    // reference is valid until the next call on this sorter.
+    const QVector<int> &rows(const ProductStore &store, const QVector<SortKey> &keys) const;
+    // Position of a store row in that order; O(1) once it is cached.
+    int position(const ProductStore &store, const QVector<SortKey> &keys, int row) const;
+    // Sort just these rows (e.g. the low-stock ones) the same way; nothing
+    // is cached, so the cost is O(k log k) in the row count.
+    static void sortRows(const ProductStore &store, const QVector<SortKey> &keys,
+                         QVector<int> *rows);
+
+    // Keep cached orders current; the store must already hold the change.
+    void rowInserted(const ProductStore &store, int row);
+    // Rows from first to the end were appended in one go.
+    void rowsAppended(const ProductStore &store, int first);
+    void rowChanged(const ProductStore &store, int row);
+    // Only column changed in these rows (ascending). Orders not sorted on
+    // it are kept as they are; the rest take the rows in or are dropped.
+    void rowsChanged(const ProductStore &store, const QVector<int> &rows,
+                     SortKey::Column column);
+    void rowRemoved(int row);
+    void clear();
+
+private:
+    struct Entry {
+        QVector<SortKey> keys;
+        QVector<int> rows;
+        // Inverse of rows: the position of each store row.
+        QVector<int> positions;
+        quint64 used = 0;
+    };
+
+    Entry &entry(const ProductStore &store, const QVector<SortKey> &keys) const;
+    // Refresh positions for rows[first..last].
+    static void reindex(Entry *entry, int first, int last);
+
+    mutable QVector<Entry> entries;
+    mutable quint64 clock = 0;
+};
+
+#endif
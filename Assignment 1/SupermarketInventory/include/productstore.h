@@ -0,0 +1,86 @@
+#ifndef PRODUCTSTORE_H
+#define PRODUCTSTORE_H
+
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include "money.h"
+#include "stringpool.h"
+
+// One product as seen by callers (the store itself keeps columns, not these).
+struct Product {
+    QString id;
+    QString name;
+    Money price;
+    int quantity = 0;
+};
+Q_DECLARE_METATYPE(Product)
+
+// Columnar product storage. Numbers live in fixed-width columns (prices in
+// cents, quantities as plain ints) and IDs and names are handles into two
+// interned string pools, so a row costs a few dozen bytes and a name shared
+// by many products is stored once. The ID pool's index doubles as the
+// ID -> row lookup, O(1).
+class ProductStore
+{
+public:
+    // Row count helpers.
+    int size() const;
+    bool isEmpty() const;
+    void clear();
+    void reserve(int rows);
+
+    // Column reads (row must be in range).
+    QString id(int row) const;
+    QString name(int row) const;
+    Money price(int row) const;
+    int quantity(int row) const;
+    Product product(int row) const;
+
+    // Row holding this product ID, or -1.
+    int findId(const QString &id) const;
+    // Compare two rows' IDs or names like QString::compare (by UTF-16 code
+    // unit) without creating strings; safe to call from several threads.
+    int compareIds(int a, int b) const;
+    int compareNames(int a, int b) const;
+    // Interned name; rows with equal names have equal handles.
+    quint32 nameHandle(int row) const;
+
+    // Zero-copy views into the string pools; only valid until the next write.
+    QString idRef(int row) const;
+    QString nameRef(int row) const;
+
+    // Writes. Removing a row shifts later rows up by one.
+    int append(const Product &product);
+    void update(int row, const Product &product);
+    // Change only a row's quantity (no string work).
+    void setQuantity(int row, int quantity);
+    void remove(int row);
+    // Put a row back at a given position (later rows shift down by one).
+    void insert(int row, const Product &product);
+    // Drop every row from rows on; O(rows dropped).
+    void truncate(int rows);
+    // Give back the text of deleted rows now rather than when enough piles up.
+    void compact();
+
+    // Replace every row from raw columns (used by the binary snapshot).
+    // Slices are (offset, length) pairs into heap. Returns false when a
+    // slice is out of range, leaving the store empty.
+    bool assign(const qint64 *priceColumn, const qint32 *quantityColumn,
+                const quint32 *idSlices, const quint32 *nameSlices,
+                int rows, const QString &heap);
+
+private:
+    void setIdRow(quint32 handle, int row);
+
+    QVector<quint32> ids;
+    QVector<quint32> names;
+    QVector<qint64> prices;
+    QVector<int> quantities;
+    StringPool idPool;
+    StringPool namePool;
+    // Row of each ID handle (stale for released handles).
+    QVector<int> idRows;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef SALESINGEST_H
+#define SALESINGEST_H
+
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include "salesqueue.h"
+
+class InventoryStore;
+class QLocalServer;
+class QLocalSocket;
+class QThread;
+class QTimer;
+
+// Counters of the sales pipeline, for the status bar and monitoring.
+struct SalesMetrics {
+    // Events queued, refused by push() because the queue was full, and
+    // unreadable lines from tills.
+    quint64 received = 0;
+    quint64 refused = 0;
+    quint64 malformed = 0;
+    // Times a till connection stopped reading because the queue was full.
+    quint64 stalls = 0;
+    // Events applied, and the row writes they came down to.
+    quint64 applied = 0;
+    quint64 rowsWritten = 0;
+    // IDs not in the catalog (counted once per batch), and products
+    // stopped at zero stock.
+    quint64 unknownIds = 0;
+    quint64 clamped = 0;
+    // Queue fill now, its high-water mark and capacity.
+    int depth = 0;
+    int maxDepth = 0;
+    int capacity = 0;
+    // Cost of the last batch and the age of its oldest event.
+    qint64 lastBatchUs = 0;
+    qint64 lagMs = 0;
+};
+
+// Point-of-sale ingestion. Tills (or any thread) push sale events into a
+// bounded lock-free queue. Every 50 ms a timer on the store's thread drains
+// it and applies the batch with one InventoryStore::applyStockDeltas call,
+// which writes each product once, so views, totals and low-stock flags
+// refresh once per batch however many sales arrived. When the queue
+// is full push() refuses, and the socket listener stops reading so the
+// tills' writes block until the store catches up.
+class SalesIngest : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SalesIngest(InventoryStore *store, QObject *parent = nullptr);
+    // Stops the listener.
+    ~SalesIngest();
+
+    // Queue one event; safe from any thread. False when the queue is full.
+    bool push(const SaleEvent &event);
+
+    // Accept "id,delta[,timestamp]" lines from tills on a local socket
+    // (read on a worker thread). Timestamps are ms since the epoch; ones
+    // in the future are applied as now.
+    bool listen(const QString &name, QString *errorMessage);
+    void stopListening();
+    // Local socket name tills connect to.
+    static QString serverName();
+
+    SalesMetrics metrics() const;
+
+signals:
+    // A batch was applied.
+    void batchApplied();
+
+private:
+    bool enqueue(const SaleEvent &event);
+    void drain();
+    void acceptTills();
+    void readSales(QLocalSocket *socket);
+
+    InventoryStore *store;
+    SalesQueue queue;
+    QTimer *drainTimer;
+    QThread *listenerThread;
+    QLocalServer *server;
+    // Set by stopListening so a listener waiting for room gives up.
+    std::atomic<bool> stopping{false};
+    // Updated from any thread.
+    std::atomic<quint64> received{0};
+    std::atomic<quint64> refused{0};
+    std::atomic<quint64> malformed{0};
+    std::atomic<quint64> stalls{0};
+    std::atomic<int> maxDepth{0};
+    // Updated on the store's thread only.
+    SalesMetrics totals;
+};
+
+#endif
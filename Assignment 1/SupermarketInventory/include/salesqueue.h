@@ -0,0 +1,52 @@
+#ifndef SALESQUEUE_H
+#define SALESQUEUE_H
+
+#include <QString>
+#include <atomic>
+#include <memory>
+
+// One sale (or return) reported by a till.
+struct SaleEvent {
+    QString productId;
+    // Change in stock: negative for units sold, positive for returns.
+    int delta = 0;
+    // When the till recorded it, in ms since the epoch.
+    qint64 timestamp = 0;
+};
+
+// Bounded lock-free queue of sale events (Vyukov's array queue): any number
+// of threads may push and pop at once, each slot carries a sequence number
+// that says whose turn it is, and nothing ever blocks. push fails instead
+// of growing when the queue is full, which is where back-pressure starts.
+class SalesQueue
+{
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SalesQueue(int capacity);
+
+    SalesQueue(const SalesQueue &) = delete;
+    SalesQueue &operator=(const SalesQueue &) = delete;
+
+    // False when the queue is full.
+    bool push(const SaleEvent &event);
+    // False when the queue is empty.
+    bool pop(SaleEvent *event);
+
+    int capacity() const;
+    // Events waiting; exact only while no one else is using the queue.
+    int size() const;
+
+private:
+    struct Slot {
+        std::atomic<quint64> sequence{0};
+        SaleEvent event;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    quint64 mask;
+    // Producers and the consumer each get their own cache line.
+    alignas(64) std::atomic<quint64> tail{0};
+    alignas(64) std::atomic<quint64> head{0};
+};
+
+#endif
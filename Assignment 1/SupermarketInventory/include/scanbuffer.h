@@ -0,0 +1,59 @@
+#ifndef SCANBUFFER_H
+#define SCANBUFFER_H
+
+#include <QBitArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class ProductStore;
+
+// Case-folded copy of every searchable column laid out back to back as
+// "id\0name\0price\0qty\0" per row, so a search is one linear scan of a
+// contiguous UTF-16 buffer. Writes are patched in place: appends extend it,
+// an edited row is rewritten in its slot (padded with NULs) or, when it
+// outgrew the slot, kept on the side, and a deleted row is blanked. It is
+// only rebuilt once too much has moved aside or gone blank.
+class ScanBuffer
+{
+public:
+    // Drop the contents; the next scan rebuilds from the store.
+    void invalidate();
+    // The store has a new row here (later rows moved down by one).
+    void insertRow(const ProductStore &store, int row);
+    // Any of the store's row's fields changed.
+    void updateRow(const ProductStore &store, int row);
+    // Only the store's row's quantity changed (cheaper than updateRow).
+    void updateQuantity(const ProductStore &store, int row);
+    // The row was removed from the store (later rows moved up by one).
+    void removeRow(int row);
+    // The store dropped every row from rows on.
+    void truncate(int rows);
+
+    // Mark every row of store containing needle (case-insensitive) in rows.
+    void scan(const QString &needle, const ProductStore &store, QBitArray *rows) const;
+
+private:
+    void rebuild(const ProductStore &store) const;
+    void appendFolded(const ProductStore &store, int row) const;
+    // Put a row's text in its slot; false when it does not fit.
+    bool writeSlot(int row, const QString &folded);
+    // Blank a row's slot and keep its text on the side instead.
+    void moveAside(int row, const QString &folded);
+    // Add shift to the row numbers of side rows at or after row.
+    void shiftMoved(int row, int shift);
+    // Rebuild next time once blank text makes up half the buffer.
+    void dropIfSparse();
+
+    mutable QVector<char16_t> text;
+    // Offset of each row in text, plus the end offset. A row kept on the
+    // side has an empty or blank slot.
+    mutable QVector<qint64> rowStarts;
+    // Folded text ("id\0name\0price\0qty\0") of rows that outgrew their slot.
+    QHash<int, QString> movedRows;
+    // Units of text blanked by moved and deleted rows.
+    qint64 blankUnits = 0;
+    mutable bool current = false;
+};
+
+#endif
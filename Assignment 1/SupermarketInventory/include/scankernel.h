@@ -0,0 +1,26 @@
+#ifndef SCANKERNEL_H
+#define SCANKERNEL_H
+
+#include <QtGlobal>
+
+// Vectorized UTF-16 substring search. The best implementation for the
+// running CPU (AVX2, SSE2 or plain C++) is picked on first use.
+namespace ScanKernel {
+
+// Offset of the first occurrence of needle in text, or -1.
+qint64 find(const char16_t *text, qint64 size, const char16_t *needle, int needleSize);
+
+// Name of the implementation in use ("avx2", "sse2" or "scalar").
+const char *implementation();
+
+// Each implementation, so tests and benchmarks can compare them.
+enum Implementation { Scalar, Sse2, Avx2 };
+// True when this build and CPU can run it.
+bool isAvailable(Implementation implementation);
+// find() with a given available implementation.
+qint64 findWith(Implementation implementation, const char16_t *text, qint64 size,
+                const char16_t *needle, int needleSize);
+
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class ProductStore;
+
+// Trigram inverted index over product IDs and names (case-folded). Each
+// product gets a stable serial number so row shifts on delete do not touch
+// the posting lists; a serial -> row table maps results back to rows.
+class SearchIndex
+{
+public:
+    // Shortest needle the index can answer; shorter ones need a scan.
+    static const int kMinNeedle = 3;
+
+    void clear();
+    void rebuild(const ProductStore &store);
+
+    // Mirror ProductStore writes (call with the text before/after the change).
+    void insertRow(int row, const QString &id, const QString &name);
+    void updateRow(int row, const QString &oldId, const QString &oldName,
+                   const QString &id, const QString &name);
+    void removeRow(int row, const QString &id, const QString &name);
+
+    // Rows whose ID or name contains needle, case-insensitively, in row
+    // order. Returns false when the needle is too short to use the index.
+    bool lookup(const QString &needle, const ProductStore &store, QVector<int> *rows) const;
+
+private:
+    static QVector<quint64> trigrams(const QString &id, const QString &name);
+    void addPostings(quint32 serial, const QVector<quint64> &keys);
+    void removePostings(quint32 serial, const QVector<quint64> &keys);
+
+    // Sorted serials per trigram.
+    QHash<quint64, QVector<quint32>> postings;
+    QVector<quint32> serialOfRow;
+    QVector<int> rowOfSerial;
+    // Serials of deleted rows, handed out again before new ones so the
+    // serial -> row table stays as large as the catalog ever was.
+    QVector<quint32> freeSerials;
+};
+
+#endif
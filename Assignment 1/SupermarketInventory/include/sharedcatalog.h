@@ -0,0 +1,105 @@
+#ifndef SHAREDCATALOG_H
+#define SHAREDCATALOG_H
+
+#include <QMutex>
+#include <QSharedMemory>
+#include <QString>
+#include "money.h"
+#include "productstore.h"
+
+class QThread;
+
+// Read-only product catalog shared between processes on one machine. A
+// small control segment holds the current generation number; each
+// generation is its own immutable segment with a prebuilt ID hash table,
+// the numeric columns and a UTF-16 text heap, so readers look products up
+// in place without copying or locking. Publishing writes a new generation
+// and then flips the number, so readers switch over atomically on their
+// next refresh() while old generations stay valid until detached.
+namespace SharedCatalog {
+// Default segment key for this machine.
+QString defaultKey();
+}
+
+// Writer side; one per machine (the admin's window).
+class SharedCatalogPublisher
+{
+public:
+    explicit SharedCatalogPublisher(const QString &key = SharedCatalog::defaultKey());
+    // Waits for a background publish.
+    ~SharedCatalogPublisher();
+
+    // Publish products as the next generation on the calling thread.
+    bool publish(const ProductStore &products, QString *errorMessage);
+    // Publish on a worker thread instead. The copy taken here is O(1) (the
+    // columns are implicitly shared); a request made while one is running
+    // replaces any still waiting, so only the newest state is written.
+    void publishInBackground(const ProductStore &products);
+    // Block until no background publish is running or waiting.
+    void waitForFinished();
+    // Why the last background publish failed (empty once one succeeds).
+    QString lastError() const;
+    quint64 generation() const;
+
+private:
+    bool attachControl(QString *errorMessage);
+    void publishPending();
+
+    QString key;
+    QSharedMemory control;
+    QSharedMemory *current;
+    quint64 published;
+    // Background state, guarded by pendingLock.
+    mutable QMutex pendingLock;
+    QThread *worker;
+    ProductStore pending;
+    bool hasPending;
+    bool busy;
+    QString error;
+};
+
+// Reader side: cheap to create, any number per machine.
+class SharedCatalogReader
+{
+public:
+    explicit SharedCatalogReader(const QString &key = SharedCatalog::defaultKey());
+    ~SharedCatalogReader();
+
+    // Attach to the newest generation; false when nothing is published.
+    bool attach(QString *errorMessage);
+    // Switch to a newer generation if one was published. Returns true when
+    // the catalog changed; row numbers from before are then invalid.
+    bool refresh();
+    bool isAttached() const;
+    quint64 generation() const;
+
+    // ---- Lookups (row must be in range; strings point into the segment) ----
+    int size() const;
+    // Row holding this product ID, or -1.
+    int find(const QString &id) const;
+    QString id(int row) const;
+    QString name(int row) const;
+    Money price(int row) const;
+    int quantity(int row) const;
+
+private:
+    quint64 publishedGeneration();
+    bool attachGeneration(quint64 generation);
+    void mapSections();
+
+    QString key;
+    QSharedMemory control;
+    QSharedMemory *data;
+    quint64 attached;
+    // Section pointers into the attached generation.
+    int rows;
+    quint32 slotMask;
+    const qint32 *slots;
+    const qint64 *prices;
+    const qint32 *quantities;
+    const quint32 *idSlices;
+    const quint32 *nameSlices;
+    const QChar *text;
+};
+
+#endif
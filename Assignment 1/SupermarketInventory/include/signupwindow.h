@@ -20,6 +20,10 @@ public:
 
 private:
     Ui::SignupWindow *ui;
+    // True while the new account is hashed and written on a worker thread.
+    bool creating;
+    void setBusy(bool busy);
+    void finishSignup(bool ok, bool isAdmin, const QString &errorMessage);
 
 private slots:
     // Validate input and create a new user.
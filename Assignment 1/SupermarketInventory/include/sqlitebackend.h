@@ -0,0 +1,54 @@
+#ifndef SQLITEBACKEND_H
+#define SQLITEBACKEND_H
+
+#include <QAtomicInteger>
+#include <QThreadStorage>
+#include "storagebackend.h"
+
+// StorageBackend on an embedded SQLite file (Qt's bundled QSQLITE driver).
+// The database runs in WAL mode with synchronous=FULL, so each edit is a
+// single-row transaction that survives a crash. Products are keyed by ID
+// (primary key) with a second index on name, and every statement is
+// prepared once per connection. Each thread gets its own connection, which
+// is closed when the thread exits.
+class SqliteBackend : public StorageBackend
+{
+public:
+    explicit SqliteBackend(const QString &path);
+    ~SqliteBackend() override;
+
+    // True when Qt was built with the SQLite driver.
+    static bool isAvailable();
+
+    // Create the schema and, the first time only, import inventory.csv and
+    // users.csv from the data directory. Call once before anything else.
+    bool open(QString *errorMessage);
+
+    bool loadProducts(ProductStore *out, QString *errorMessage) override;
+    bool addProduct(const Product &product, QString *errorMessage) override;
+    bool updateProduct(const QString &oldId, const Product &product,
+                       QString *errorMessage) override;
+    bool removeProduct(const QString &id, QString *errorMessage) override;
+    bool applyBatch(const QVector<Product> &upserts, const QStringList &deletes,
+                    QString *errorMessage) override;
+
+    bool usersChanged() override;
+    bool loadUsers(QVector<UserStore::UserRecord> *out, QString *errorMessage) override;
+    bool addUser(const UserStore::UserRecord &record, QString *errorMessage) override;
+    bool updateUser(const UserStore::UserRecord &record, QString *errorMessage) override;
+
+private:
+    struct Connection;
+
+    Connection *connection(QString *errorMessage);
+    bool migrate(Connection *db, QString *errorMessage);
+    qint64 usersVersion(Connection *db);
+
+    QString path;
+    QThreadStorage<Connection *> connections;
+    QAtomicInteger<quint64> connectionCount;
+    // users_version seen by the last loadUsers.
+    QAtomicInteger<qint64> loadedUsersVersion;
+};
+
+#endif
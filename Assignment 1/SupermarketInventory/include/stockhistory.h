@@ -0,0 +1,118 @@
+#ifndef STOCKHISTORY_H
+#define STOCKHISTORY_H
+
+#include <QDate>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+// One change in a product's stock.
+struct StockMovement {
+    enum Reason {
+        // Till sales (negative) and returns (positive).
+        Sale,
+        // Edits, imports, undo and redo.
+        Edit,
+        // The product was added or removed with this stock.
+        Added,
+        Removed
+    };
+    // When it was applied, in ms since the epoch.
+    qint64 timestamp = 0;
+    int delta = 0;
+    Reason reason = Edit;
+};
+
+// Every quantity change per product, kept for years. Each product's
+// movements are packed in blocks of up to 1024: timestamps as varint
+// delta-of-deltas, deltas (with the reason in the low two bits) as zigzag
+// varints, a few bytes per movement. Full blocks are appended to one file
+// whose block headers (time span, units sold, net change) stay in memory,
+// so a range query adds up the headers of blocks inside the range and only
+// decodes the two at its edges. Movements not yet in a full block go to a
+// small log that is replayed on open. Products are tracked by ID; a renamed
+// product starts a new history.
+class StockHistory
+{
+public:
+    StockHistory(const QString &blocksPath, const QString &logPath);
+    ~StockHistory();
+
+    StockHistory(const StockHistory &) = delete;
+    StockHistory &operator=(const StockHistory &) = delete;
+
+    // Read both files (creating them if needed). A torn block at the end of
+    // the file is dropped; its movements are still in the log. A read-only
+    // history (another process writes the files) never changes them.
+    bool open(bool writable, QString *errorMessage);
+    bool isOpen() const;
+
+    // Remember one change; it is written by the next flush. Timestamps of
+    // a product never go backwards (an earlier one is moved up).
+    void record(const QString &productId, int delta, StockMovement::Reason reason,
+                qint64 timestamp);
+    // Write what was recorded since the last flush and seal full blocks;
+    // cheap enough to call after every edit.
+    bool flush(QString *errorMessage);
+
+    // ---- Queries (times in ms since the epoch, ranges are [from, to)) ----
+    QVector<StockMovement> movements(const QString &productId, qint64 from, qint64 to) const;
+    // Units sold (sales minus returns) between each pair of ascending edges.
+    QVector<qint64> unitsSold(const QString &productId, const QVector<qint64> &edges) const;
+    // Units sold on each of days local days starting at first.
+    QVector<qint64> dailyUnitsSold(const QString &productId, const QDate &first, int days) const;
+    // The count products with the most units sold in the range, most first.
+    QVector<QPair<QString, qint64>> topSellers(qint64 from, qint64 to, int count) const;
+
+private:
+    struct Block {
+        qint64 firstTimestamp = 0;
+        qint64 lastTimestamp = 0;
+        qint64 sold = 0;
+        qint64 net = 0;
+        // Payload position in the blocks file.
+        qint64 offset = 0;
+        quint32 timestampBytes = 0;
+        quint32 deltaBytes = 0;
+        int count = 0;
+    };
+    struct Series {
+        QVector<Block> blocks;
+        // Movements not in a block yet, oldest first; the first logged of
+        // them are already in the log.
+        QVector<StockMovement> open;
+        int logged = 0;
+        // Movements ever sealed into blocks (the next one's sequence number).
+        qint64 sealed = 0;
+    };
+
+    bool readBlocks(QString *errorMessage);
+    bool readLog(QString *errorMessage);
+    bool appendLog(QString *errorMessage);
+    bool rewriteLog(QString *errorMessage);
+    bool seal(const QString &productId, Series *series, QString *errorMessage);
+    QByteArray payload(const Block &block) const;
+    void decode(const Block &block, QVector<StockMovement> *out) const;
+    // Add the units sold in [edges.first, edges.last) to the buckets.
+    void addSales(const Series &series, const QVector<qint64> &edges,
+                  QVector<qint64> *buckets) const;
+
+    QString logPath;
+    mutable QFile blocksFile;
+    qint64 blocksSize;
+    mutable uchar *mapped;
+    mutable qint64 mappedSize;
+    qint64 logSize;
+    // Log size that triggers the next rewrite; it grows with what a
+    // rewrite has to keep, so flushing every edit never rewrites each time.
+    qint64 logLimit;
+    bool writable;
+    QHash<QString, Series> series;
+    // Products recorded since the last flush.
+    QSet<QString> touched;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef STORAGEBACKEND_H
+#define STORAGEBACKEND_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "productstore.h"
+#include "userstore.h"
+
+// Pluggable persistence for products and users. Without a backend the app
+// keeps its CSV files (inventory.csv with its journal, snapshot and
+// autosave, and users.csv). With one, every edit is written through it as
+// it happens and nothing is rewritten wholesale. Implementations must be
+// usable from any thread.
+class StorageBackend
+{
+public:
+    virtual ~StorageBackend() = default;
+
+    // Backend used by this process, or nullptr for the CSV files.
+    static StorageBackend *current();
+    // Install (not owned) before any window or store is created.
+    static void setCurrent(StorageBackend *backend);
+
+    // ---- Products (false with a message on failure) ----
+    // Every product, in the order they were added.
+    virtual bool loadProducts(ProductStore *out, QString *errorMessage) = 0;
+    virtual bool addProduct(const Product &product, QString *errorMessage) = 0;
+    virtual bool updateProduct(const QString &oldId, const Product &product,
+                               QString *errorMessage) = 0;
+    virtual bool removeProduct(const QString &id, QString *errorMessage) = 0;
+    // Insert-or-update and delete many products as one transaction.
+    virtual bool applyBatch(const QVector<Product> &upserts, const QStringList &deletes,
+                            QString *errorMessage) = 0;
+
+    // ---- Users ----
+    // True when users were written (by any process) since the last loadUsers.
+    virtual bool usersChanged() = 0;
+    virtual bool loadUsers(QVector<UserStore::UserRecord> *out, QString *errorMessage) = 0;
+    virtual bool addUser(const UserStore::UserRecord &record, QString *errorMessage) = 0;
+    // Replace the stored record with the same username.
+    virtual bool updateUser(const UserStore::UserRecord &record, QString *errorMessage) = 0;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QString>
+#include <QVector>
+
+// Interned strings in one append-only UTF-16 arena. Each distinct string
+// is stored once and named by a handle, so equal strings have equal
+// handles and comparing them is O(1). Handles are reference counted and
+// stay valid until their last reference is released; freed handles are
+// reused. Dead text is reclaimed by compact(), which moves the live
+// strings but keeps every handle.
+class StringPool
+{
+public:
+    void clear();
+
+    // Handle for value, adding a reference (storing it if it is new).
+    quint32 intern(const QString &value);
+    // Handle of value without adding a reference, or -1.
+    int find(const QString &value) const;
+    // Drop one reference; the string goes when the last one does.
+    void release(quint32 handle);
+
+    // Zero-copy view into the arena; only valid until the next write.
+    QString text(quint32 handle) const;
+    int length(quint32 handle) const;
+    // Order of two strings like QString::compare (by UTF-16 code unit).
+    int compare(quint32 a, quint32 b) const;
+
+    // Distinct strings currently held.
+    int count() const;
+    // Rebuild the arena with only live strings. Runs by itself once enough
+    // text is dead; call it after mass deletes to reclaim memory at once.
+    void compact();
+
+private:
+    struct Entry {
+        quint32 offset = 0;
+        quint32 length = 0;
+        quint32 refs = 0;
+        quint32 hash = 0;
+    };
+
+    int findSlot(const QChar *data, int size, quint32 hash) const;
+    void rehash(int capacity);
+    void unindex(quint32 handle);
+
+    QString arena;
+    QVector<Entry> entries;
+    QVector<quint32> freeHandles;
+    // Open-addressing index of live handles (-1 when empty).
+    QVector<qint32> slots;
+    int live = 0;
+    int garbage = 0;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QAtomicInt>
+#include <QString>
+
+// Scoped timing spans for hot paths, written out as Chrome trace JSON
+// (chrome://tracing or ui.perfetto.dev). Each thread records into its own
+// fixed-size ring, so recording never locks; the oldest spans are dropped
+// once a ring is full. While tracing is off a span costs one relaxed load.
+namespace Trace {
+
+namespace Detail {
+extern QAtomicInt enabled;
+// Monotonic clock in nanoseconds.
+qint64 now();
+// Append one finished span to the calling thread's ring.
+void record(const char *name, qint64 start, qint64 end);
+}
+
+inline bool isEnabled()
+{
+    return Detail::enabled.loadRelaxed() != 0;
+}
+
+// Start or stop recording. Starting again discards spans from earlier runs.
+void setEnabled(bool enabled);
+
+// Times the enclosing scope. name must outlive the trace (use a literal).
+class Span
+{
+public:
+    explicit Span(const char *name)
+        : name(isEnabled() ? name : nullptr)
+        , start(this->name ? Detail::now() : 0)
+    {
+    }
+
+    ~Span()
+    {
+        if (name) {
+            Detail::record(name, start, Detail::now());
+        }
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+private:
+    const char *name;
+    qint64 start;
+};
+
+// Write every span recorded since tracing was last enabled to path.
+bool writeJson(const QString &path, QString *errorMessage);
+// Time-stamped trace file in the AppData directory.
+QString defaultPath();
+
+}
+
+#endif
@@ -14,6 +14,8 @@ struct UserRecord {
     QByteArray salt;
     QByteArray hash;
     bool isAdmin = false;
+    // PBKDF2 iterations; 0 marks a legacy single SHA-256 hash.
+    int iterations = 0;
 };
 
 // File locations.
@@ -25,19 +27,37 @@ bool loadUsersIfExists(QVector<UserRecord> *records, QString *errorMessage, QStr
 // Save all users to the primary file (legacy records are migrated to hashed format).
 bool saveUsers(const QVector<UserRecord> &records, QString *errorMessage);
 
-// Verify credentials against loaded records.
-bool verifyUser(const QVector<UserRecord> &records,
-                const QString &username,
-                const QString &password,
-                bool *isAdmin);
+// ---- Process-wide user directory ----
+// The directory caches users.csv with a hash index by username and is only
+// re-read when the file's size or modified time changes. With a storage
+// backend installed it caches the backend's users instead. Safe to use from
+// any thread.
 
-// Simple queries on loaded records.
-bool usernameExists(const QVector<UserRecord> &records, const QString &username);
-bool anyAdmin(const QVector<UserRecord> &records);
+// Bring the cache in line with users.csv (cheap when nothing changed).
+bool refresh(QString *errorMessage);
 
-// Create a new hashed user record.
+// Queries on the cached directory (call refresh first).
+bool hasUsers();
+bool usernameExists(const QString &username);
+bool anyAdmin();
+// Slow by design (one KDF run, plus a rewrite when a legacy hash or one
+// under half the current work factor is upgraded); call it off the GUI
+// thread.
+bool verifyUser(const QString &username, const QString &password, bool *isAdmin);
+
+// Append one user to users.csv and the cache. Fails if the name is taken.
+bool addUser(const UserRecord &record, QString *errorMessage);
+
+// Create a new hashed user record (slow by design, like verifyUser).
 UserRecord createUser(const QString &username, const QString &password, bool isAdmin);
 
+// ---- Password work factor ----
+// Time a short KDF run and set the work factor so one hash takes about
+// budgetMs on this machine. Returns the chosen iteration count.
+int calibrateWorkFactor(int budgetMs);
+// Iterations used for new and upgraded hashes.
+int workFactor();
+
 }
 
 #endif
@@ -1,7 +1,20 @@
 #include "appdata.h"
 
+#include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
 #include <QStandardPaths>
+#include <memory>
+
+namespace {
+// The data folder's lock, once this process has taken it.
+std::unique_ptr<QLockFile> &dataLock()
+{
+    static std::unique_ptr<QLockFile> lock;
+    return lock;
+}
+}
 
 namespace AppData {
 
@@ -32,16 +45,96 @@ bool ensureDataDir(QString *errorMessage)
     return false;
 }
 
+bool lockDataDir(QString *errorMessage)
+{
+    // Two writers would each overwrite the other's edits on their next save.
+    if (dataLock()) {
+        return true;
+    }
+    if (!ensureDataDir(errorMessage)) {
+        return false;
+    }
+    std::unique_ptr<QLockFile> lock(new QLockFile(lockFilePath()));
+    // A live holder never goes stale, however long it runs; a lock left by a
+    // process that crashed is taken over.
+    lock->setStaleLockTime(0);
+    if (!lock->tryLock()) {
+        if (errorMessage) {
+            *errorMessage = lock->error() == QLockFile::LockFailedError
+                                ? "The inventory is open in another program."
+                                : "Could not lock the data directory: " + dataDir();
+        }
+        return false;
+    }
+    dataLock() = std::move(lock);
+    return true;
+}
+
+bool hasDataLock()
+{
+    return dataLock() != nullptr;
+}
+
+void fileStamp(const QString &path, qint64 *size, qint64 *modified)
+{
+    // Cheap "has this file changed" check used by caches and the journal.
+    const QFileInfo info(path);
+    *size = info.exists() ? info.size() : -1;
+    *modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QString lockFilePath()
+{
+    // Held next to the files it guards.
+    return dataDir() + QDir::separator() + "inventory.lock";
+}
+
 QString inventoryFilePath()
 {
     // Main inventory storage path.
     return dataDir() + QDir::separator() + "inventory.csv";
 }
 
+QString inventorySnapshotPath()
+{
+    // Fast-start snapshot next to the CSV.
+    return dataDir() + QDir::separator() + "inventory.bin";
+}
+
+QString inventoryJournalPath()
+{
+    // Edit journal next to the CSV.
+    return dataDir() + QDir::separator() + "inventory.journal";
+}
+
+QString reorderLevelsPath()
+{
+    // Reorder levels next to the CSV.
+    return dataDir() + QDir::separator() + "reorder.csv";
+}
+
+QString databasePath()
+{
+    // SQLite database used instead of the CSV files once created.
+    return dataDir() + QDir::separator() + "inventory.sqlite";
+}
+
 QString usersFilePath()
 {
     // Main users storage path.
     return dataDir() + QDir::separator() + "users.csv";
 }
 
+QString stockHistoryPath()
+{
+    // Stock movement history next to the CSV.
+    return dataDir() + QDir::separator() + "stock-history.blocks";
+}
+
+QString stockHistoryLogPath()
+{
+    // Movements waiting to fill a block.
+    return dataDir() + QDir::separator() + "stock-history.log";
+}
+
 }
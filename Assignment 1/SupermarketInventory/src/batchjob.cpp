@@ -0,0 +1,537 @@
+#include "batchjob.h"
+
+#include "inventoryexporter.h"
+#include "inventoryimport.h"
+#include "inventorystore.h"
+#include "sharedcatalog.h"
+#include <QBitArray>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+namespace {
+// Problems listed inline by validate; the full list goes to --rejections.
+const int kListedProblems = 20;
+// Default ranges of history and top, in days up to and including today.
+const int kHistoryDays = 90;
+const int kTopDays = 7;
+const int kTopCount = 10;
+
+void print(QTextStream &out, const QJsonObject &object)
+{
+    out << QJsonDocument(object).toJson(QJsonDocument::Compact) << '\n';
+    out.flush();
+}
+
+BatchJob::ExitCode fail(QTextStream &out, const QString &command, const QString &error,
+                        BatchJob::ExitCode code = BatchJob::Failed)
+{
+    QJsonObject object;
+    object["command"] = command;
+    object["ok"] = false;
+    object["error"] = error;
+    print(out, object);
+    return code;
+}
+
+// Remove "name value" from args. False when the value is missing.
+bool takeOption(QStringList *args, const QString &name, QString *value)
+{
+    const int at = args->indexOf(name);
+    if (at < 0) {
+        return true;
+    }
+    if (at + 1 >= args->size()) {
+        return false;
+    }
+    *value = args->at(at + 1);
+    args->removeAt(at + 1);
+    args->removeAt(at);
+    return true;
+}
+
+// Remove "name N" from args; N must be a whole number of at least 1.
+bool takeCount(QStringList *args, const QString &name, int *value)
+{
+    QString text;
+    if (!takeOption(args, name, &text)) {
+        return false;
+    }
+    if (text.isEmpty()) {
+        return true;
+    }
+    bool ok = false;
+    *value = text.toInt(&ok);
+    return ok && *value > 0;
+}
+
+// Local midnight starting date.
+qint64 midnight(const QDate &date)
+{
+    return QDateTime(date, QTime(0, 0)).toMSecsSinceEpoch();
+}
+
+bool takeFlag(QStringList *args, const QString &name)
+{
+    return args->removeAll(name) > 0;
+}
+
+QJsonArray listProblems(const QVector<ImportRejection> &rejected)
+{
+    QJsonArray list;
+    for (int i = 0; i < rejected.size() && i < kListedProblems; ++i) {
+        QJsonObject problem;
+        problem["line"] = rejected.at(i).line;
+        problem["reason"] = rejected.at(i).reason;
+        list.append(problem);
+    }
+    return list;
+}
+
+bool writeRejections(const QVector<ImportRejection> &rejected, const QString &path,
+                     QString *errorMessage)
+{
+    return path.isEmpty() || InventoryImport::writeRejections(rejected, path, errorMessage);
+}
+
+// import FILE [--rejections FILE]
+BatchJob::ExitCode importFile(InventoryStore *store, QStringList args, QTextStream &out)
+{
+    QString rejectionsPath;
+    if (!takeOption(&args, "--rejections", &rejectionsPath) || args.size() != 1) {
+        return fail(out, "import", "Usage: import FILE [--rejections FILE]", BatchJob::Usage);
+    }
+
+    QString error;
+    ImportResult result;
+    if (!InventoryImport::parseFile(args.first(), &result, &error)) {
+        return fail(out, "import", error);
+    }
+    int inserted = 0;
+    int updated = 0;
+    if (!result.products.isEmpty() &&
+        !store->upsert(result.products, &inserted, &updated, &error)) {
+        return fail(out, "import", error);
+    }
+    if (!writeRejections(result.rejected, rejectionsPath, &error)) {
+        return fail(out, "import", error);
+    }
+
+    QJsonObject object;
+    object["command"] = "import";
+    object["ok"] = true;
+    object["lines"] = result.lines;
+    object["inserted"] = inserted;
+    object["updated"] = updated;
+    object["rejected"] = result.rejected.size();
+    print(out, object);
+    return BatchJob::Ok;
+}
+
+// update FILE [--rejections FILE]
+// Lines are "id,name,price,quantity" for existing products; an empty field
+// keeps the current value, so "P-100,,,25" only sets the quantity.
+BatchJob::ExitCode updateFile(InventoryStore *store, QStringList args, QTextStream &out)
+{
+    QString rejectionsPath;
+    if (!takeOption(&args, "--rejections", &rejectionsPath) || args.size() != 1) {
+        return fail(out, "update", "Usage: update FILE [--rejections FILE]", BatchJob::Usage);
+    }
+    QFile file(args.first());
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return fail(out, "update", "Could not open update file.");
+    }
+
+    const ProductStore &products = store->products();
+    auto keep = [](const QString &field, const QString &current) {
+        return field.trimmed().isEmpty() ? current : field;
+    };
+    QVector<Product> batch;
+    QVector<ImportRejection> rejected;
+    QTextStream in(&file);
+    int lines = 0;
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        ++lines;
+        const QStringList fields = line.split(',');
+        if (line.trimmed().isEmpty() ||
+            (lines == 1 && fields.first().trimmed().toLower() == "id")) {
+            continue;
+        }
+
+        ImportRejection rejection;
+        rejection.line = lines;
+        rejection.text = line;
+        const int row = fields.size() == 4 ? store->find(fields.first().trimmed()) : -1;
+        Product product;
+        if (fields.size() != 4) {
+            rejection.reason = QString("Expected 4 fields (id,name,price,quantity), found %1.")
+                                   .arg(fields.size());
+        } else if (row < 0) {
+            rejection.reason = "Unknown product ID.";
+        } else if (InventoryStore::parseProduct(
+                       products.id(row), keep(fields.at(1), products.name(row)),
+                       keep(fields.at(2), products.price(row).toString()),
+                       keep(fields.at(3), QString::number(products.quantity(row))),
+                       &product, &rejection.reason)) {
+            batch.push_back(product);
+            continue;
+        }
+        rejected.push_back(rejection);
+    }
+
+    QString error;
+    int updated = 0;
+    if (!batch.isEmpty() && !store->upsert(batch, nullptr, &updated, &error)) {
+        return fail(out, "update", error);
+    }
+    if (!writeRejections(rejected, rejectionsPath, &error)) {
+        return fail(out, "update", error);
+    }
+
+    QJsonObject object;
+    object["command"] = "update";
+    object["ok"] = true;
+    object["lines"] = lines;
+    object["updated"] = updated;
+    object["rejected"] = rejected.size();
+    print(out, object);
+    return BatchJob::Ok;
+}
+
+// export FILE [--format csv|jsonl|binary|report] [--filter TEXT] [--low-stock]
+BatchJob::ExitCode exportFile(InventoryStore *store, QStringList args, QTextStream &out)
+{
+    QString formatName = "csv";
+    QString needle;
+    const bool lowStockOnly = takeFlag(&args, "--low-stock");
+    if (!takeOption(&args, "--format", &formatName) || !takeOption(&args, "--filter", &needle) ||
+        args.size() != 1) {
+        return fail(out, "export",
+                    "Usage: export FILE [--format csv|jsonl|binary|report] "
+                    "[--filter TEXT] [--low-stock]",
+                    BatchJob::Usage);
+    }
+
+    InventoryExporter::Format format = InventoryExporter::Csv;
+    if (formatName == "jsonl") {
+        format = InventoryExporter::JsonLines;
+    } else if (formatName == "binary") {
+        format = InventoryExporter::Binary;
+    } else if (formatName == "report") {
+        format = InventoryExporter::Report;
+    } else if (formatName != "csv") {
+        return fail(out, "export", "Unknown format: " + formatName, BatchJob::Usage);
+    }
+
+    // Same selection as the window: low stock comes most urgent first, a
+    // search keeps catalog order.
+    QVector<int> rows;
+    const bool selected = lowStockOnly || !needle.isEmpty();
+    if (selected) {
+        QBitArray hits;
+        if (!needle.isEmpty()) {
+            store->filter(needle, &hits);
+        }
+        const QVector<int> candidates = lowStockOnly ? store->lowStockRows() : QVector<int>();
+        const int count = lowStockOnly ? candidates.size() : store->size();
+        for (int i = 0; i < count; ++i) {
+            const int row = lowStockOnly ? candidates.at(i) : i;
+            if (needle.isEmpty() || hits.testBit(row)) {
+                rows.push_back(row);
+            }
+        }
+    }
+
+    // An empty row list means "everything", so an empty selection is written
+    // from an empty catalog (headers only).
+    const bool none = selected && rows.isEmpty();
+    QString error;
+    if (!InventoryExporter::writeFile(none ? ProductStore() : store->products(), rows, format,
+                                      args.first(), &error)) {
+        return fail(out, "export", error);
+    }
+
+    QJsonObject object;
+    object["command"] = "export";
+    object["ok"] = true;
+    object["rows"] = selected ? rows.size() : store->size();
+    object["format"] = formatName;
+    print(out, object);
+    return BatchJob::Ok;
+}
+
+// validate [FILE [--rejections FILE]]
+// With a file: a dry run of importing it. Without: re-checks every product
+// in the inventory and reports the totals.
+BatchJob::ExitCode validate(InventoryStore *store, QStringList args, QTextStream &out)
+{
+    QString rejectionsPath;
+    if (!takeOption(&args, "--rejections", &rejectionsPath) || args.size() > 1) {
+        return fail(out, "validate", "Usage: validate [FILE [--rejections FILE]]",
+                    BatchJob::Usage);
+    }
+
+    QString error;
+    QJsonObject object;
+    object["command"] = "validate";
+    QVector<ImportRejection> rejected;
+    if (args.size() == 1) {
+        ImportResult result;
+        if (!InventoryImport::parseFile(args.first(), &result, &error)) {
+            return fail(out, "validate", error);
+        }
+        int known = 0;
+        for (const Product &product : result.products) {
+            known += store->find(product.id) >= 0 ? 1 : 0;
+        }
+        rejected = result.rejected;
+        object["lines"] = result.lines;
+        object["valid"] = result.products.size();
+        object["wouldInsert"] = result.products.size() - known;
+        object["wouldUpdate"] = known;
+    } else {
+        // Rows are reported by 1-based position, like lines of the CSV.
+        const ProductStore &products = store->products();
+        for (int row = 0; row < products.size(); ++row) {
+            Product product;
+            ImportRejection rejection;
+            if (!InventoryStore::parseProduct(products.id(row), products.name(row),
+                                              products.price(row).toString(),
+                                              QString::number(products.quantity(row)),
+                                              &product, &rejection.reason)) {
+                rejection.line = row + 1;
+                rejection.text = products.id(row);
+                rejected.push_back(rejection);
+            }
+        }
+        const InventoryTotals totals = store->totals();
+        object["products"] = totals.products;
+        object["units"] = totals.units;
+        object["valueCents"] = totals.valueCents;
+        object["lowStock"] = totals.lowStock;
+    }
+    if (!writeRejections(rejected, rejectionsPath, &error)) {
+        return fail(out, "validate", error);
+    }
+
+    object["ok"] = rejected.isEmpty();
+    object["rejected"] = rejected.size();
+    if (!rejected.isEmpty()) {
+        object["problems"] = listProblems(rejected);
+    }
+    print(out, object);
+    return rejected.isEmpty() ? BatchJob::Ok : BatchJob::Failed;
+}
+
+// history ID [--days N]
+// Units sold (sales minus returns) on each of the last N days, oldest first.
+BatchJob::ExitCode history(InventoryStore *store, QStringList args, QTextStream &out)
+{
+    int days = kHistoryDays;
+    if (!takeCount(&args, "--days", &days) || args.size() != 1) {
+        return fail(out, "history", "Usage: history ID [--days N]", BatchJob::Usage);
+    }
+    const StockHistory &movements = store->stockHistory();
+    if (!movements.isOpen()) {
+        return fail(out, "history", "The stock history could not be opened.");
+    }
+
+    const QDate first = QDate::currentDate().addDays(1 - days);
+    const QVector<qint64> sold = movements.dailyUnitsSold(args.first(), first, days);
+    QJsonArray perDay;
+    qint64 total = 0;
+    for (qint64 units : sold) {
+        perDay.append(units);
+        total += units;
+    }
+
+    QJsonObject object;
+    object["command"] = "history";
+    object["ok"] = true;
+    object["id"] = args.first();
+    object["first"] = first.toString(Qt::ISODate);
+    object["days"] = days;
+    object["sold"] = total;
+    object["perDay"] = perDay;
+    print(out, object);
+    return BatchJob::Ok;
+}
+
+// top [--days N] [--count K]
+// The products with the most units sold over the last N days.
+BatchJob::ExitCode topSellers(InventoryStore *store, QStringList args, QTextStream &out)
+{
+    int days = kTopDays;
+    int count = kTopCount;
+    if (!takeCount(&args, "--days", &days) || !takeCount(&args, "--count", &count) ||
+        !args.isEmpty()) {
+        return fail(out, "top", "Usage: top [--days N] [--count K]", BatchJob::Usage);
+    }
+    const StockHistory &movements = store->stockHistory();
+    if (!movements.isOpen()) {
+        return fail(out, "top", "The stock history could not be opened.");
+    }
+
+    const QDate today = QDate::currentDate();
+    const QVector<QPair<QString, qint64>> sellers =
+        movements.topSellers(midnight(today.addDays(1 - days)), midnight(today.addDays(1)), count);
+    QJsonArray list;
+    for (const QPair<QString, qint64> &seller : sellers) {
+        QJsonObject product;
+        product["id"] = seller.first;
+        product["sold"] = seller.second;
+        list.append(product);
+    }
+
+    QJsonObject object;
+    object["command"] = "top";
+    object["ok"] = true;
+    object["days"] = days;
+    object["products"] = list;
+    print(out, object);
+    return BatchJob::Ok;
+}
+
+// lookup ID [ID...]
+// Reads products from the catalog an admin's window shares on this machine,
+// as a till would, without touching the loaded inventory.
+BatchJob::ExitCode lookup(QStringList args, QTextStream &out)
+{
+    if (args.isEmpty()) {
+        return fail(out, "lookup", "Usage: lookup ID [ID...]", BatchJob::Usage);
+    }
+    QString error;
+    SharedCatalogReader catalog;
+    if (!catalog.attach(&error)) {
+        return fail(out, "lookup", error);
+    }
+
+    QJsonArray found;
+    QJsonArray missing;
+    for (const QString &id : args) {
+        const int row = catalog.find(id);
+        if (row < 0) {
+            missing.append(id);
+            continue;
+        }
+        QJsonObject product;
+        product["id"] = catalog.id(row);
+        product["name"] = catalog.name(row);
+        product["price"] = catalog.price(row).toString();
+        product["quantity"] = catalog.quantity(row);
+        found.append(product);
+    }
+
+    QJsonObject object;
+    object["command"] = "lookup";
+    object["ok"] = missing.isEmpty();
+    object["generation"] = QString::number(catalog.generation());
+    object["products"] = found;
+    if (!missing.isEmpty()) {
+        object["missing"] = missing;
+    }
+    print(out, object);
+    return missing.isEmpty() ? BatchJob::Ok : BatchJob::Failed;
+}
+}
+
+namespace BatchJob {
+
+ExitCode run(InventoryStore *store, bool admin, const QStringList &command, QTextStream &out)
+{
+    if (command.isEmpty()) {
+        return fail(out, QString(), "No command given.", Usage);
+    }
+    const QString name = command.first();
+    const QStringList args = command.mid(1);
+    const bool writes = name == "import" || name == "update";
+    if (writes && !admin) {
+        return fail(out, name, "Only admins can change the inventory.", Denied);
+    }
+    if (writes && !store->isWritable()) {
+        return fail(out, name, "The inventory is open in another program.", StorageError);
+    }
+
+    if (name == "import") {
+        return importFile(store, args, out);
+    }
+    if (name == "update") {
+        return updateFile(store, args, out);
+    }
+    if (name == "export") {
+        return exportFile(store, args, out);
+    }
+    if (name == "validate") {
+        return validate(store, args, out);
+    }
+    if (name == "history") {
+        return history(store, args, out);
+    }
+    if (name == "top") {
+        return topSellers(store, args, out);
+    }
+    if (name == "lookup") {
+        return lookup(args, out);
+    }
+    return fail(out, name, "Unknown command: " + name, Usage);
+}
+
+QStringList splitLine(const QString &line)
+{
+    QStringList words;
+    QString word;
+    bool quoted = false;
+    bool started = false;
+    for (const QChar c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            started = true;
+        } else if (c.isSpace() && !quoted) {
+            if (started) {
+                words.push_back(word);
+                word.clear();
+                started = false;
+            }
+        } else {
+            word += c;
+            started = true;
+        }
+    }
+    if (started) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+QString usage()
+{
+    return "Usage: SupermarketInventoryBatch --user NAME [--password-stdin] [--sqlite]\n"
+           "                                 (COMMAND [ARGS] | --script FILE)\n"
+           "\n"
+           "The password is read from SUPERMARKET_PASSWORD, or from the first line\n"
+           "of standard input with --password-stdin. A script holds one command per\n"
+           "line (\"-\" reads standard input); blank lines and lines starting with #\n"
+           "are skipped, and the script stops at the first failing command.\n"
+           "\n"
+           "Commands (each prints one JSON object per line):\n"
+           "  import FILE [--rejections FILE]      add or update products (admin)\n"
+           "  update FILE [--rejections FILE]      edit existing products; empty\n"
+           "                                       fields keep their value (admin)\n"
+           "  export FILE [--format csv|jsonl|binary|report] [--filter TEXT]\n"
+           "              [--low-stock]\n"
+           "  validate [FILE [--rejections FILE]]  check a file, or the inventory\n"
+           "  history ID [--days N]                units sold per day (default 90)\n"
+           "  top [--days N] [--count K]           best sellers (default 7 days, 10)\n"
+           "  lookup ID [ID...]                    products as tills see them in the\n"
+           "                                       catalog an admin's window shares\n"
+           "\n"
+           "Exit codes: 0 ok, 1 command failed or invalid data, 2 usage,\n"
+           "3 login failed or not an admin, 4 storage error (including a write\n"
+           "while the app has the inventory open).\n";
+}
+
+}
@@ -0,0 +1,132 @@
+#include "appdata.h"
+#include "batchjob.h"
+#include "inventorystore.h"
+#include "sqlitebackend.h"
+#include "userstore.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+// Headless entry point for nightly and scripted jobs: QtCore (plus QtSql
+// for the SQLite backend) and no widgets, so it runs without a display. It
+// skips the GUI's work-factor calibration; the one deliberate cost at
+// startup is checking the password (about 150 ms).
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Same identity as the GUI, so both use the same AppData folder.
+    QCoreApplication::setOrganizationName("SupermarketInventory");
+    QCoreApplication::setApplicationName("SupermarketInventory");
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QTextStream in(stdin);
+
+    // Options come first; the rest is a single command.
+    QStringList args = app.arguments().mid(1);
+    QString username;
+    QString scriptPath;
+    bool passwordFromStdin = false;
+    bool useSqlite = false;
+    while (!args.isEmpty() && args.first().startsWith("--")) {
+        const QString option = args.takeFirst();
+        if (option == "--user" && !args.isEmpty()) {
+            username = args.takeFirst();
+        } else if (option == "--script" && !args.isEmpty()) {
+            scriptPath = args.takeFirst();
+        } else if (option == "--password-stdin") {
+            passwordFromStdin = true;
+        } else if (option == "--sqlite") {
+            useSqlite = true;
+        } else if (option == "--help") {
+            out << BatchJob::usage();
+            return BatchJob::Ok;
+        } else {
+            err << "Unknown option: " << option << "\n" << BatchJob::usage();
+            return BatchJob::Usage;
+        }
+    }
+    if (username.isEmpty() || scriptPath.isEmpty() == args.isEmpty()) {
+        err << BatchJob::usage();
+        return BatchJob::Usage;
+    }
+    // Never on the command line, where other users could read it.
+    const QString password = passwordFromStdin ? in.readLine()
+                                               : qEnvironmentVariable("SUPERMARKET_PASSWORD");
+
+    // Same storage choice as the GUI.
+    QString error;
+    SqliteBackend database(AppData::databasePath());
+    if (useSqlite || QFileInfo::exists(AppData::databasePath())) {
+        if (!database.open(&error)) {
+            err << error << "\n";
+            return BatchJob::StorageError;
+        }
+        StorageBackend::setCurrent(&database);
+    }
+
+    bool admin = false;
+    if (!UserStore::refresh(&error)) {
+        err << error << "\n";
+        StorageBackend::setCurrent(nullptr);
+        return BatchJob::StorageError;
+    }
+    if (!UserStore::verifyUser(username, password, &admin)) {
+        err << "Invalid username or password.\n";
+        StorageBackend::setCurrent(nullptr);
+        return BatchJob::Denied;
+    }
+
+    BatchJob::ExitCode code = BatchJob::Ok;
+    {
+        // While an admin's window (or another job) holds the data folder
+        // this run only reads; write commands then fail with a storage error.
+        QString lockError;
+        const bool locked = admin && AppData::lockDataDir(&lockError);
+        if (admin && !locked) {
+            err << lockError << " Opening it read-only.\n";
+        }
+        InventoryStore store;
+        store.setWritable(locked);
+        store.setBackend(StorageBackend::current());
+        QObject::connect(&store, &InventoryStore::warning, [&err](const QString &message) {
+            err << message << "\n";
+            err.flush();
+        });
+        if (!store.load(false, &error)) {
+            err << error << "\n";
+            StorageBackend::setCurrent(nullptr);
+            return BatchJob::StorageError;
+        }
+
+        if (scriptPath.isEmpty()) {
+            code = BatchJob::run(&store, admin, args, out);
+        } else {
+            // "-" reads the script from stdin, after the password line if any.
+            const bool fromStdin = scriptPath == "-";
+            QFile script(scriptPath);
+            const bool opened = fromStdin || script.open(QIODevice::ReadOnly | QIODevice::Text);
+            if (!opened) {
+                err << "Could not open script: " << scriptPath << "\n";
+                code = BatchJob::Usage;
+            }
+            QTextStream lines(&script);
+            QTextStream &source = fromStdin ? in : lines;
+            while (opened && code == BatchJob::Ok && !source.atEnd()) {
+                const QString line = source.readLine().trimmed();
+                if (!line.isEmpty() && !line.startsWith('#')) {
+                    code = BatchJob::run(&store, admin, BatchJob::splitLine(line), out);
+                }
+            }
+        }
+
+        // Write the CSV now rather than leaving the edits in the journal.
+        if (store.isWritable() && !store.save(&error)) {
+            err << error << "\n";
+            code = code == BatchJob::Ok ? BatchJob::StorageError : code;
+        }
+    }
+    StorageBackend::setCurrent(nullptr);
+    return code;
+}
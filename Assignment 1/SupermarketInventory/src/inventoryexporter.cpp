@@ -0,0 +1,311 @@
+#include "inventoryexporter.h"
+
+#include "trace.h"
+#include <QSaveFile>
+#include <QThread>
+#include <cstring>
+
+namespace {
+// Output is handed to the file in pieces of about this size.
+const int kFlushBytes = 1 << 20;
+// Rows between progress reports and cancel checks.
+const int kProgressRows = 65536;
+
+const char kMagic[8] = {'S', 'M', 'I', 'N', 'V', 'E', 'X', 'P'};
+// Version 2 writes prices as integer cents (version 1 had doubles).
+const quint32 kVersion = 2;
+
+// Fixed 24-byte header of the binary format.
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 rowCount;
+    quint8 reserved[8];
+};
+static_assert(sizeof(Header) == 24, "export header must stay 24 bytes");
+
+// JSON string literal for text.
+QByteArray jsonString(const QString &text)
+{
+    QByteArray out = "\"";
+    for (const char c : text.toUtf8()) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += QByteArray::number(static_cast<unsigned char>(c), 16).rightJustified(2, '0');
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+// Buffered writer over a QSaveFile that also reports progress and checks
+// for cancellation every kProgressRows rows.
+class Sink
+{
+public:
+    Sink(QSaveFile *file, qint64 total, const QAtomicInt *cancelled,
+         InventoryExporter *reporter)
+        : file(file)
+        , total(total)
+        , cancelled(cancelled)
+        , reporter(reporter)
+    {
+        buffer.reserve(kFlushBytes + 4096);
+    }
+
+    void write(const QByteArray &bytes)
+    {
+        buffer += bytes;
+    }
+
+    void write(const void *data, int size)
+    {
+        buffer.append(static_cast<const char *>(data), size);
+    }
+
+    // Count one row; false when writing failed or the export was cancelled.
+    bool rowDone()
+    {
+        ++done;
+        if (buffer.size() >= kFlushBytes && !flush()) {
+            return false;
+        }
+        if (done % kProgressRows == 0) {
+            if (reporter) {
+                emit reporter->progress(done, total);
+            }
+            if (cancelled && cancelled->loadRelaxed()) {
+                stopped = true;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool flush()
+    {
+        if (!buffer.isEmpty() && file->write(buffer) != buffer.size()) {
+            return false;
+        }
+        buffer.clear();
+        return true;
+    }
+
+    bool wasCancelled() const
+    {
+        return stopped;
+    }
+
+private:
+    QSaveFile *file;
+    QByteArray buffer;
+    qint64 total;
+    qint64 done = 0;
+    const QAtomicInt *cancelled;
+    InventoryExporter *reporter;
+    bool stopped = false;
+};
+
+bool writeRows(const ProductStore &products, const QVector<int> &rows,
+               InventoryExporter::Format format, Sink *sink)
+{
+    const int count = rows.isEmpty() ? products.size() : rows.size();
+    auto rowAt = [&](int i) { return rows.isEmpty() ? i : rows.at(i); };
+
+    switch (format) {
+    case InventoryExporter::Csv:
+        sink->write("id,name,price,quantity\n");
+        for (int i = 0; i < count; ++i) {
+            const int row = rowAt(i);
+            sink->write(products.idRef(row).toUtf8() + ',' + products.nameRef(row).toUtf8() +
+                        ',' + products.price(row).toLatin1() + ',' +
+                        QByteArray::number(products.quantity(row)) + '\n');
+            if (!sink->rowDone()) {
+                return false;
+            }
+        }
+        return true;
+
+    case InventoryExporter::JsonLines:
+        for (int i = 0; i < count; ++i) {
+            const int row = rowAt(i);
+            sink->write("{\"id\":" + jsonString(products.idRef(row)) +
+                        ",\"name\":" + jsonString(products.nameRef(row)) +
+                        ",\"price\":" + products.price(row).toLatin1() +
+                        ",\"quantity\":" + QByteArray::number(products.quantity(row)) + "}\n");
+            if (!sink->rowDone()) {
+                return false;
+            }
+        }
+        return true;
+
+    case InventoryExporter::Binary: {
+        // One pass per column: int64 cents, int32s, then length-prefixed UTF-8.
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.rowCount = static_cast<quint32>(count);
+        sink->write(&header, sizeof(header));
+        for (int i = 0; i < count; ++i) {
+            const qint64 price = products.price(rowAt(i)).cents();
+            sink->write(&price, sizeof(price));
+            if (!sink->rowDone()) {
+                return false;
+            }
+        }
+        for (int i = 0; i < count; ++i) {
+            const qint32 quantity = products.quantity(rowAt(i));
+            sink->write(&quantity, sizeof(quantity));
+            if (!sink->rowDone()) {
+                return false;
+            }
+        }
+        for (int column = 0; column < 2; ++column) {
+            for (int i = 0; i < count; ++i) {
+                const int row = rowAt(i);
+                const QByteArray text = (column == 0 ? products.idRef(row)
+                                                     : products.nameRef(row)).toUtf8();
+                const quint32 length = static_cast<quint32>(text.size());
+                sink->write(&length, sizeof(length));
+                sink->write(text);
+                if (!sink->rowDone()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    case InventoryExporter::Report:
+        sink->write("SUPERMARKET INVENTORY REPORT\n\n");
+        for (int i = 0; i < count; ++i) {
+            const int row = rowAt(i);
+            sink->write("ID: " + products.idRef(row).toUtf8() + "\n" +
+                        "Name: " + products.nameRef(row).toUtf8() + "\n" +
+                        "Price: " + products.price(row).toLatin1() + "\n" +
+                        "Qty: " + QByteArray::number(products.quantity(row)) + "\n\n");
+            if (!sink->rowDone()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+}
+
+InventoryExporter::InventoryExporter(QObject *parent)
+    : QObject(parent)
+    , worker(nullptr)
+    , ok(false)
+    , rowsWritten(0)
+{
+}
+
+InventoryExporter::~InventoryExporter()
+{
+    if (worker) {
+        cancel();
+        worker->wait();
+        delete worker;
+    }
+}
+
+bool InventoryExporter::writeFile(const ProductStore &products, const QVector<int> &rows,
+                                  Format format, const QString &path, QString *errorMessage,
+                                  const QAtomicInt *cancelled, InventoryExporter *reporter)
+{
+    Trace::Span span("InventoryExporter::writeFile");
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorMessage) {
+            *errorMessage = "Could not create export file.";
+        }
+        return false;
+    }
+
+    const qint64 count = rows.isEmpty() ? products.size() : rows.size();
+    const qint64 total = format == Binary ? count * 4 : count;
+    Sink sink(&file, total, cancelled, reporter);
+    if (!writeRows(products, rows, format, &sink) || !sink.flush()) {
+        // Nothing is left behind; an existing file keeps its old contents.
+        file.cancelWriting();
+        if (errorMessage) {
+            *errorMessage = sink.wasCancelled() ? QString("Export cancelled.")
+                                                : QString("Could not write export file.");
+        }
+        return false;
+    }
+    if (!file.commit()) {
+        if (errorMessage) {
+            *errorMessage = "Could not finalize export file.";
+        }
+        return false;
+    }
+    if (reporter) {
+        emit reporter->progress(total, total);
+    }
+    return true;
+}
+
+bool InventoryExporter::isBusy() const
+{
+    return worker != nullptr;
+}
+
+bool InventoryExporter::start(const ProductStore &products, const QVector<int> &rows,
+                              Format format, const QString &path)
+{
+    if (worker) {
+        return false;
+    }
+
+    cancelRequested.storeRelaxed(0);
+    rowsWritten = rows.isEmpty() ? products.size() : rows.size();
+    worker = QThread::create([this, products, rows, format, path]() {
+        QString message;
+        ok = writeFile(products, rows, format, path, &message, &cancelRequested, this);
+        error = message;
+    });
+    connect(worker, &QThread::finished, this, &InventoryExporter::collect);
+    worker->start();
+    return true;
+}
+
+void InventoryExporter::cancel()
+{
+    cancelRequested.storeRelaxed(1);
+}
+
+void InventoryExporter::collect()
+{
+    if (!worker) {
+        return;
+    }
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+    const bool stopped = !ok && cancelRequested.loadRelaxed();
+    emit finished(ok, stopped, ok ? rowsWritten : 0, error);
+}
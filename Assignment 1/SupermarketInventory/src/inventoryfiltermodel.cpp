@@ -0,0 +1,117 @@
+#include "inventoryfiltermodel.h"
+
+#include "inventorymodel.h"
+#include "inventorystore.h"
+
+InventoryFilterModel::InventoryFilterModel(QObject *parent)
+    : QSortFilterProxyModel(parent)
+{
+}
+
+void InventoryFilterModel::setSearchText(const QString &text)
+{
+    const QString normalized = text.trimmed();
+    if (normalized == search) {
+        return;
+    }
+    search = normalized;
+
+    // Work out the matching rows once; the proxy's filter pass then only
+    // reads a bitmap.
+    computeMatches();
+    invalidateFilter();
+}
+
+QString InventoryFilterModel::searchText() const
+{
+    return search;
+}
+
+void InventoryFilterModel::setSourceModel(QAbstractItemModel *model)
+{
+    if (sourceModel()) {
+        disconnect(sourceModel(), &QAbstractItemModel::modelReset,
+                   this, &InventoryFilterModel::refreshMatches);
+        disconnect(sourceModel(), &QAbstractItemModel::layoutChanged,
+                   this, &InventoryFilterModel::refreshMatches);
+    }
+    // Connected before the base class hooks up, so a reset (e.g. a bulk
+    // import) or a re-layout (sales moving rows in a sorted view)
+    // recomputes a stale bitmap before the proxy re-filters every row.
+    // Switching the low-stock view resets without touching the store, so
+    // it keeps the bitmap.
+    if (model) {
+        connect(model, &QAbstractItemModel::modelReset, this, &InventoryFilterModel::refreshMatches);
+        connect(model, &QAbstractItemModel::layoutChanged,
+                this, &InventoryFilterModel::refreshMatches);
+    }
+    QSortFilterProxyModel::setSourceModel(model);
+    computeMatches();
+}
+
+void InventoryFilterModel::computeMatches()
+{
+    const InventoryStore *store = inventory();
+    haveMatches = store && !search.isEmpty();
+    if (!haveMatches) {
+        matches.clear();
+        return;
+    }
+    store->filter(search, &matches);
+    matchesRevision = store->revision();
+}
+
+void InventoryFilterModel::refreshMatches()
+{
+    // Only stale bitmaps are rebuilt; re-sorting alone changes nothing.
+    const InventoryStore *store = inventory();
+    if (haveMatches && store && matchesRevision != store->revision()) {
+        computeMatches();
+    }
+}
+
+const InventoryModel *InventoryFilterModel::source() const
+{
+    return qobject_cast<const InventoryModel *>(sourceModel());
+}
+
+const InventoryStore *InventoryFilterModel::inventory() const
+{
+    const InventoryModel *model = source();
+    return model ? model->inventory() : nullptr;
+}
+
+int InventoryFilterModel::storeRow(const QModelIndex &proxyIndex) const
+{
+    const int row = mapToSource(proxyIndex).row();
+    const InventoryModel *model = source();
+    return model && row >= 0 ? model->storeRow(row) : row;
+}
+
+void InventoryFilterModel::sort(int column, Qt::SortOrder order)
+{
+    // The source model sorts with cached orders; the base class would
+    // re-sort every row on each call.
+    if (sourceModel()) {
+        sourceModel()->sort(column, order);
+    }
+}
+
+bool InventoryFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent);
+    const InventoryModel *model = source();
+    const InventoryStore *store = inventory();
+    if (!store) {
+        return true;
+    }
+    const int row = model->storeRow(sourceRow);
+    if (search.isEmpty()) {
+        return true;
+    }
+    if (haveMatches && matchesRevision == store->revision()) {
+        return row < matches.size() && matches.testBit(row);
+    }
+    // Rows inserted or edited since the bitmap was built are checked one by one.
+    return store->matches(row, search);
+}
@@ -0,0 +1,122 @@
+#include "inventoryhistory.h"
+
+namespace {
+qint64 textCost(const QString &text)
+{
+    return text.isEmpty() ? 0 : 2 * text.size() + 24;
+}
+}
+
+InventoryHistory::InventoryHistory(qint64 limitBytes)
+    : limitBytes(limitBytes)
+    , usedBytes(0)
+{
+}
+
+void InventoryHistory::clear()
+{
+    undoSteps.clear();
+    redoSteps.clear();
+    usedBytes = 0;
+}
+
+void InventoryHistory::setLimit(qint64 limitBytes)
+{
+    this->limitBytes = limitBytes;
+    trim();
+}
+
+qint64 InventoryHistory::limit() const
+{
+    return limitBytes;
+}
+
+qint64 InventoryHistory::memoryUsed() const
+{
+    return usedBytes;
+}
+
+void InventoryHistory::record(const HistoryStep &undo)
+{
+    for (const HistoryStep &step : redoSteps) {
+        usedBytes -= cost(step);
+    }
+    redoSteps.clear();
+    pushUndo(undo);
+}
+
+bool InventoryHistory::canUndo() const
+{
+    return !undoSteps.isEmpty();
+}
+
+bool InventoryHistory::canRedo() const
+{
+    return !redoSteps.isEmpty();
+}
+
+QString InventoryHistory::undoLabel() const
+{
+    return undoSteps.isEmpty() ? QString() : undoSteps.last().label;
+}
+
+QString InventoryHistory::redoLabel() const
+{
+    return redoSteps.isEmpty() ? QString() : redoSteps.last().label;
+}
+
+HistoryStep InventoryHistory::takeUndo()
+{
+    HistoryStep step = undoSteps.takeLast();
+    usedBytes -= cost(step);
+    return step;
+}
+
+HistoryStep InventoryHistory::takeRedo()
+{
+    HistoryStep step = redoSteps.takeLast();
+    usedBytes -= cost(step);
+    return step;
+}
+
+void InventoryHistory::pushUndo(const HistoryStep &step)
+{
+    undoSteps.push_back(step);
+    usedBytes += cost(step);
+    trim();
+}
+
+void InventoryHistory::pushRedo(const HistoryStep &step)
+{
+    redoSteps.push_back(step);
+    usedBytes += cost(step);
+    trim();
+}
+
+qint64 InventoryHistory::cost(const HistoryStep &step)
+{
+    qint64 bytes = sizeof(HistoryStep) + textCost(step.label);
+    bytes += step.changes.size() * static_cast<qint64>(sizeof(FieldDelta));
+    for (const FieldDelta &delta : step.changes) {
+        bytes += textCost(delta.values.id) + textCost(delta.values.name);
+    }
+    bytes += step.products.size() * static_cast<qint64>(sizeof(Product));
+    for (const Product &product : step.products) {
+        bytes += textCost(product.id) + textCost(product.name);
+    }
+    for (auto it = step.reorderLevels.constBegin(); it != step.reorderLevels.constEnd(); ++it) {
+        bytes += textCost(it.key()) + 16;
+    }
+    return bytes;
+}
+
+void InventoryHistory::trim()
+{
+    // Oldest undo steps go first, then the far end of the redo stack.
+    while (usedBytes > limitBytes && !undoSteps.isEmpty()) {
+        usedBytes -= cost(undoSteps.takeFirst());
+    }
+    while (usedBytes > limitBytes && !redoSteps.isEmpty()) {
+        usedBytes -= cost(redoSteps.takeFirst());
+    }
+}
@@ -0,0 +1,165 @@
+#include "inventoryimport.h"
+
+#include "inventorystore.h"
+#include "parallel.h"
+#include "trace.h"
+#include <QFile>
+#include <QList>
+#include <QSaveFile>
+#include <QTextStream>
+#include <cstring>
+
+namespace {
+// Bytes per parse thread; small files are parsed on the calling thread.
+const long long kBytesPerThread = 256 * 1024;
+
+// Everything one chunk of the file produced. Line numbers are relative to
+// the chunk until the chunks are merged.
+struct ChunkResult {
+    QVector<Product> products;
+    QVector<ImportRejection> rejected;
+    int lines = 0;
+};
+
+void parseLine(const char *begin, const char *end, bool firstLine, ChunkResult *out)
+{
+    if (end > begin && end[-1] == '\r') {
+        --end;
+    }
+    // Spreadsheet exports often start with a UTF-8 byte order mark.
+    if (firstLine && end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) {
+        begin += 3;
+    }
+    const QByteArray line = QByteArray::fromRawData(begin, static_cast<int>(end - begin));
+    if (line.trimmed().isEmpty()) {
+        return;
+    }
+
+    const QList<QByteArray> fields = line.split(',');
+    if (firstLine && fields.first().trimmed().toLower() == "id") {
+        return;
+    }
+
+    QString reason;
+    Product product;
+    if (fields.size() != 4) {
+        reason = QString("Expected 4 fields (id,name,price,quantity), found %1.")
+                     .arg(fields.size());
+    } else if (InventoryStore::parseProduct(QString::fromUtf8(fields.at(0)),
+                                            QString::fromUtf8(fields.at(1)),
+                                            QString::fromUtf8(fields.at(2)),
+                                            QString::fromUtf8(fields.at(3)),
+                                            &product, &reason)) {
+        out->products.push_back(product);
+        return;
+    }
+
+    ImportRejection rejection;
+    rejection.line = out->lines;
+    rejection.reason = reason;
+    rejection.text = QString::fromUtf8(line);
+    out->rejected.push_back(rejection);
+}
+
+// Parse every line that starts inside [begin, end) of data.
+void parseChunk(const char *data, long long size, long long begin, long long end,
+                ChunkResult *out)
+{
+    long long pos = begin;
+    while (pos > 0 && pos < size && data[pos - 1] != '\n') {
+        ++pos;
+    }
+    while (pos < end && pos < size) {
+        const void *newline = std::memchr(data + pos, '\n', static_cast<size_t>(size - pos));
+        const long long lineEnd = newline
+            ? static_cast<const char *>(newline) - data
+            : size;
+        ++out->lines;
+        parseLine(data + pos, data + lineEnd, pos == 0, out);
+        pos = lineEnd + 1;
+    }
+}
+}
+
+namespace InventoryImport {
+
+bool parseFile(const QString &path, ImportResult *out, QString *errorMessage)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage) {
+            *errorMessage = "Could not open import file.";
+        }
+        return false;
+    }
+
+    // Parse straight from the page cache when the file can be mapped.
+    const qint64 size = file.size();
+    if (size > 0) {
+        if (uchar *mapped = file.map(0, size)) {
+            parseData(QByteArray::fromRawData(reinterpret_cast<const char *>(mapped),
+                                              static_cast<int>(size)), out);
+            file.unmap(mapped);
+            return true;
+        }
+    }
+    parseData(file.readAll(), out);
+    return true;
+}
+
+void parseData(const QByteArray &data, ImportResult *out)
+{
+    Trace::Span span("InventoryImport::parseData");
+    const char *bytes = data.constData();
+    const long long size = data.size();
+    QVector<ChunkResult> chunks(Parallel::threadCount(size, kBytesPerThread));
+    ChunkResult *results = chunks.data();
+    Parallel::forChunks(size, kBytesPerThread, [&](long long begin, long long end, int chunk) {
+        parseChunk(bytes, size, begin, end, &results[chunk]);
+    });
+
+    // Merge in file order, turning chunk-relative line numbers into file ones.
+    *out = ImportResult();
+    for (const ChunkResult &chunk : chunks) {
+        out->products += chunk.products;
+        for (ImportRejection rejection : chunk.rejected) {
+            rejection.line += out->lines;
+            out->rejected.push_back(rejection);
+        }
+        out->lines += chunk.lines;
+    }
+}
+
+bool writeRejections(const QVector<ImportRejection> &rejected, const QString &path,
+                     QString *errorMessage)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (errorMessage) {
+            *errorMessage = "Could not create rejection report.";
+        }
+        return false;
+    }
+
+    // The rejected text may contain commas and quotes, so it is quoted.
+    QTextStream out(&file);
+    out << "line,reason,text\n";
+    for (const ImportRejection &rejection : rejected) {
+        QString text = rejection.text;
+        text.replace("\"", "\"\"");
+        QString reason = rejection.reason;
+        reason.replace("\"", "\"\"");
+        out << rejection.line << ",\"" << reason << "\",\"" << text << "\"\n";
+    }
+    out.flush();
+
+    if (!file.commit()) {
+        if (errorMessage) {
+            *errorMessage = "Could not finalize rejection report.";
+        }
+        return false;
+    }
+    return true;
+}
+
+}
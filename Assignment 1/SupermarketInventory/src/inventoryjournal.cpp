@@ -0,0 +1,368 @@
+#include "inventoryjournal.h"
+
+#include "appdata.h"
+#include <QDateTime>
+#include <QList>
+#include <QSaveFile>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Appends reach the OS immediately; the fsync for a burst of edits is
+// issued this long after the first one.
+const int kSyncDelayMs = 50;
+// Token of a journal that has never folded in a pending segment.
+const QByteArray kNoToken = "-";
+
+// Main header: "J1,<csv size>,<csv mtime>,<last folded pending token>".
+QByteArray headerLine(const QByteArray &size, const QByteArray &modified,
+                      const QByteArray &token)
+{
+    return "J1," + size + "," + modified + "," + token + "\n";
+}
+
+QByteArray stampLine(const QString &csvPath, const QByteArray &token)
+{
+    qint64 size = 0;
+    qint64 modified = 0;
+    AppData::fileStamp(csvPath, &size, &modified);
+    return headerLine(QByteArray::number(size), QByteArray::number(modified), token);
+}
+
+QByteArray productFields(const Product &product)
+{
+    return product.id.toUtf8() + "," + product.name.toUtf8() + "," +
+           product.price.toLatin1() + "," +
+           QByteArray::number(product.quantity);
+}
+
+// Parse "id,name,price,quantity" starting at fields[first].
+bool parseProduct(const QList<QByteArray> &fields, int first, Product *out)
+{
+    if (fields.size() < first + 4) {
+        return false;
+    }
+    bool qtyOk = false;
+    out->id = QString::fromUtf8(fields.at(first));
+    out->name = QString::fromUtf8(fields.at(first + 1));
+    // Older journals hold 17-digit doubles; those round to the nearest cent.
+    const bool priceOk = Money::parse(fields.at(first + 2), &out->price);
+    out->quantity = fields.at(first + 3).toInt(&qtyOk);
+    return priceOk && qtyOk && !out->id.isEmpty();
+}
+
+// Entry lines: "A,<product>", "U,<old id>,<product>", "D,<id>".
+bool parseEntry(const QByteArray &line, JournalEntry *out)
+{
+    const QList<QByteArray> fields = line.trimmed().split(',');
+    const QByteArray op = fields.at(0);
+    if (op == "A" && parseProduct(fields, 1, &out->product)) {
+        out->op = JournalEntry::Add;
+        out->key = out->product.id;
+        return true;
+    }
+    if (op == "U" && fields.size() >= 2 && parseProduct(fields, 2, &out->product)) {
+        out->op = JournalEntry::Update;
+        out->key = QString::fromUtf8(fields.at(1));
+        return true;
+    }
+    if (op == "D" && fields.size() >= 2) {
+        out->op = JournalEntry::Delete;
+        out->key = QString::fromUtf8(fields.at(1));
+        return !out->key.isEmpty();
+    }
+    return false;
+}
+
+// Complete, parseable lines of one journal file.
+struct Segment {
+    bool exists = false;
+    bool clean = true;
+    QList<QByteArray> header;
+    QByteArray body;
+    QVector<JournalEntry> entries;
+};
+
+Segment readSegment(const QString &path)
+{
+    Segment segment;
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly)) {
+        return segment;
+    }
+    segment.exists = true;
+
+    const QByteArray first = in.readLine();
+    if (!first.endsWith('\n')) {
+        segment.clean = false;
+        return segment;
+    }
+    segment.header = first.trimmed().split(',');
+
+    while (!in.atEnd()) {
+        const QByteArray line = in.readLine();
+        if (!line.endsWith('\n')) {
+            // Torn write from a crash; drop it.
+            segment.clean = false;
+            break;
+        }
+        JournalEntry entry;
+        if (!parseEntry(line, &entry)) {
+            segment.clean = false;
+            continue;
+        }
+        segment.body += line;
+        segment.entries.push_back(entry);
+    }
+    return segment;
+}
+
+bool isStampFor(const QList<QByteArray> &header, const QString &csvPath)
+{
+    qint64 size = 0;
+    qint64 modified = 0;
+    AppData::fileStamp(csvPath, &size, &modified);
+    return header.size() >= 4 && header.at(0) == "J1" &&
+           header.at(1) == QByteArray::number(size) &&
+           header.at(2) == QByteArray::number(modified);
+}
+
+// Token of a pending segment header ("J1,pending,<token>"), or empty.
+QByteArray pendingTokenOf(const Segment &segment)
+{
+    if (!segment.exists || segment.header.size() < 3 ||
+        segment.header.at(0) != "J1" || segment.header.at(1) != "pending") {
+        return QByteArray();
+    }
+    return segment.header.at(2);
+}
+
+bool syncHandle(int handle)
+{
+#ifdef Q_OS_WIN
+    return _commit(handle) == 0;
+#else
+    return ::fsync(handle) == 0;
+#endif
+}
+
+}
+
+InventoryJournal::InventoryJournal(const QString &path, QObject *parent)
+    : QObject(parent)
+    , mainPath(path)
+    , pendingPath(path + ".pending")
+    , entries(0)
+{
+    syncTimer.setSingleShot(true);
+    syncTimer.setInterval(kSyncDelayMs);
+    connect(&syncTimer, &QTimer::timeout, this, &InventoryJournal::sync);
+}
+
+InventoryJournal::~InventoryJournal()
+{
+    sync();
+}
+
+bool InventoryJournal::open(const QString &csvPath, QVector<JournalEntry> *out,
+                            QString *errorMessage)
+{
+    sync();
+    file.close();
+
+    const Segment main = readSegment(mainPath);
+    const Segment pending = readSegment(pendingPath);
+
+    // A journal for an older CSV means the CSV already holds its edits.
+    const bool mainValid = main.exists && isStampFor(main.header, csvPath);
+    const QByteArray mainToken = mainValid ? main.header.at(3) : kNoToken;
+    // A pending segment is left over when a save was interrupted. Skip it if
+    // the main journal already folded it in.
+    const QByteArray token = pendingTokenOf(pending);
+    const bool foldPending = !token.isEmpty() && token != mainToken;
+
+    QVector<JournalEntry> replayed;
+    QByteArray body;
+    if (mainValid) {
+        replayed = main.entries;
+        body = main.body;
+    }
+    if (foldPending) {
+        replayed += pending.entries;
+        body += pending.body;
+    }
+    entries = replayed.size();
+    if (out) {
+        *out = replayed;
+    }
+
+    if (mainValid && main.clean && !pending.exists) {
+        return openForAppend(mainPath, errorMessage);
+    }
+
+    // Otherwise write a clean journal for this CSV and drop the segment.
+    if (!rewrite(stampLine(csvPath, foldPending ? token : mainToken), body, errorMessage)) {
+        return false;
+    }
+    QFile::remove(pendingPath);
+    return true;
+}
+
+bool InventoryJournal::beginCheckpoint(QString *errorMessage)
+{
+    sync();
+    file.close();
+
+    pendingToken = QByteArray::number(QDateTime::currentMSecsSinceEpoch());
+    file.setFileName(pendingPath);
+    const QByteArray header = "J1,pending," + pendingToken + "\n";
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        file.write(header) != header.size()) {
+        if (errorMessage) {
+            *errorMessage = "Could not start inventory journal segment.";
+        }
+        file.close();
+        openForAppend(mainPath, nullptr);
+        return false;
+    }
+    sync();
+    entries = 0;
+    return true;
+}
+
+bool InventoryJournal::finishCheckpoint(const QString &csvPath, bool saved,
+                                        QString *errorMessage)
+{
+    sync();
+    file.close();
+
+    const Segment pending = readSegment(pendingPath);
+    QByteArray header;
+    QByteArray body;
+    if (saved) {
+        // The new CSV holds everything before the checkpoint.
+        header = stampLine(csvPath, pendingToken);
+        body = pending.body;
+        entries = pending.entries.size();
+    } else {
+        // The old CSV is still current: keep its entries and add the new ones.
+        const Segment main = readSegment(mainPath);
+        const QByteArray size = main.header.size() >= 3 ? main.header.at(1) : "-2";
+        const QByteArray modified = main.header.size() >= 3 ? main.header.at(2) : "-2";
+        header = headerLine(size, modified, pendingToken);
+        body = main.body + pending.body;
+        entries = main.entries.size() + pending.entries.size();
+    }
+
+    if (!rewrite(header, body, errorMessage)) {
+        return false;
+    }
+    QFile::remove(pendingPath);
+    return true;
+}
+
+bool InventoryJournal::logAdd(const Product &product)
+{
+    return append("A," + productFields(product) + "\n");
+}
+
+bool InventoryJournal::logUpdate(const QString &oldId, const Product &product)
+{
+    return append("U," + oldId.toUtf8() + "," + productFields(product) + "\n");
+}
+
+bool InventoryJournal::logDelete(const QString &id)
+{
+    return append("D," + id.toUtf8() + "\n");
+}
+
+bool InventoryJournal::logUpserts(const QVector<Product> &products)
+{
+    // Updates keyed by their own ID replay as inserts when the row is missing.
+    QByteArray lines;
+    for (const Product &product : products) {
+        lines += "U," + product.id.toUtf8() + "," + productFields(product) + "\n";
+    }
+    return append(lines, products.size());
+}
+
+bool InventoryJournal::logDeletes(const QStringList &ids)
+{
+    QByteArray lines;
+    for (const QString &id : ids) {
+        lines += "D," + id.toUtf8() + "\n";
+    }
+    return append(lines, ids.size());
+}
+
+int InventoryJournal::entryCount() const
+{
+    return entries;
+}
+
+void InventoryJournal::sync()
+{
+    syncTimer.stop();
+    if (!file.isOpen()) {
+        return;
+    }
+    file.flush();
+    syncHandle(file.handle());
+}
+
+bool InventoryJournal::append(const QByteArray &lines, int count)
+{
+    if (!file.isOpen()) {
+        return false;
+    }
+    if (file.write(lines) != lines.size() || !file.flush()) {
+        return false;
+    }
+    entries += count;
+    if (!syncTimer.isActive()) {
+        syncTimer.start();
+    }
+    return true;
+}
+
+bool InventoryJournal::rewrite(const QByteArray &header, const QByteArray &body,
+                               QString *errorMessage)
+{
+    // Replace the main journal atomically, then keep appending to it.
+    QString dirError;
+    if (!AppData::ensureDataDir(&dirError)) {
+        if (errorMessage) {
+            *errorMessage = dirError;
+        }
+        return false;
+    }
+
+    QSaveFile out(mainPath);
+    if (!out.open(QIODevice::WriteOnly) ||
+        out.write(header) != header.size() ||
+        out.write(body) != body.size() ||
+        !out.commit()) {
+        if (errorMessage) {
+            *errorMessage = "Could not write inventory journal.";
+        }
+        return false;
+    }
+    return openForAppend(mainPath, errorMessage);
+}
+
+bool InventoryJournal::openForAppend(const QString &path, QString *errorMessage)
+{
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        if (errorMessage) {
+            *errorMessage = "Could not open inventory journal.";
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,105 @@
+#include "inventoryloader.h"
+
+#include "trace.h"
+#include <QFile>
+#include <QStringList>
+
+namespace {
+// The first batch is small so rows appear right away; later ones are larger
+// to keep the number of GUI-thread model updates down.
+const int kFirstBatchSize = 256;
+const int kBatchSize = 16384;
+}
+
+bool parseProductLine(const QString &line, Product *out)
+{
+    const QString trimmed = line.trimmed();
+    if (trimmed.isEmpty()) {
+        return false;
+    }
+
+    const QStringList data = trimmed.split(",");
+    if (data.size() < 4) {
+        return false;
+    }
+
+    const QString header = data[0].trimmed().toLower();
+    if (header == "id") {
+        return false;
+    }
+
+    const QString id = data[0].trimmed();
+    const QString name = data[1].trimmed();
+    if (id.isEmpty() || name.isEmpty()) {
+        return false;
+    }
+
+    Money price;
+    bool qtyOk = false;
+    const bool priceOk = Money::parse(data[2], &price);
+    const int qty = data[3].trimmed().toInt(&qtyOk);
+    if (!priceOk || !qtyOk) {
+        return false;
+    }
+
+    out->id = id;
+    out->name = name;
+    out->price = price;
+    out->quantity = qty;
+    return true;
+}
+
+InventoryLoader::InventoryLoader(const QString &path, QObject *parent)
+    : QObject(parent)
+    , path(path)
+{
+}
+
+void InventoryLoader::cancel()
+{
+    cancelled.storeRelaxed(1);
+}
+
+void InventoryLoader::run()
+{
+    Trace::Span span("InventoryLoader::run");
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        emit finished(false, "Could not open inventory file.");
+        return;
+    }
+
+    const qint64 total = file.size();
+    QVector<Product> batch;
+    int batchLimit = kFirstBatchSize;
+    batch.reserve(batchLimit);
+
+    // Read raw lines; decoding per line avoids QTextStream's extra buffering.
+    while (!file.atEnd()) {
+        // A stopped load is incomplete, so it must not pass for a good one.
+        if (cancelled.loadRelaxed()) {
+            emit finished(false, "Load cancelled");
+            return;
+        }
+
+        Product product;
+        if (!parseProductLine(QString::fromUtf8(file.readLine()), &product)) {
+            continue;
+        }
+        batch.push_back(product);
+
+        if (batch.size() >= batchLimit) {
+            emit batchReady(batch);
+            emit progress(file.pos(), total);
+            batch.clear();
+            batchLimit = kBatchSize;
+            batch.reserve(batchLimit);
+        }
+    }
+
+    if (!batch.isEmpty()) {
+        emit batchReady(batch);
+    }
+    emit progress(total, total);
+    emit finished(true, QString());
+}
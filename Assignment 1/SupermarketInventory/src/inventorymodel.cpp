@@ -0,0 +1,401 @@
+#include "inventorymodel.h"
+
+#include "inventorystore.h"
+#include <QBrush>
+#include <QColor>
+#include <QHash>
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+// Visual rules for the table.
+const QColor kLowStockColor(180, 60, 60);
+const QStringList kHeaders = {"ID", "Name", "Price", "Quantity"};
+
+// Model row of each low-stock store row in an order (-1 when not shown),
+// hashed so it stays O(k). Whole-catalog orders use the model's table.
+class RowPositions
+{
+public:
+    explicit RowPositions(const QVector<int> &order)
+    {
+        hash.reserve(order.size());
+        for (int i = 0; i < order.size(); ++i) {
+            hash.insert(order.at(i), i);
+        }
+    }
+
+    int at(int row) const
+    {
+        return hash.value(row, -1);
+    }
+
+private:
+    QHash<int, int> hash;
+};
+}
+
+InventoryModel::InventoryModel(InventoryStore *store, QObject *parent)
+    : QAbstractTableModel(parent)
+    , source(store)
+{
+    connect(store, &InventoryStore::rowsAboutToBeInserted, this, &InventoryModel::beginStoreInsert);
+    connect(store, &InventoryStore::rowsInserted, this, &InventoryModel::endStoreInsert);
+    connect(store, &InventoryStore::rowsAboutToBeRemoved, this, &InventoryModel::beginStoreRemove);
+    connect(store, &InventoryStore::rowsRemoved, this, &InventoryModel::endStoreRemove);
+    connect(store, &InventoryStore::rowChanged, this, &InventoryModel::storeRowChanged);
+    connect(store, &InventoryStore::rowsChanged, this, &InventoryModel::storeRowsChanged);
+    connect(store, &InventoryStore::aboutToReset, this, [this]() {
+        beginResetModel();
+    });
+    connect(store, &InventoryStore::resetDone, this, [this]() {
+        if (!inFileOrder()) {
+            order = rowsFor(keys);
+        }
+        indexOrder();
+        endResetModel();
+    });
+}
+
+int InventoryModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return inFileOrder() ? source->size() : order.size();
+}
+
+int InventoryModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+int InventoryModel::storeRow(int row) const
+{
+    return inFileOrder() ? row : order.at(row);
+}
+
+bool InventoryModel::inFileOrder() const
+{
+    return keys.isEmpty() && !lowOnly;
+}
+
+QVector<int> InventoryModel::rowsFor(const QVector<SortKey> &sortKeys) const
+{
+    if (!lowOnly) {
+        return sortKeys.isEmpty() ? QVector<int>() : source->sortedRows(sortKeys);
+    }
+    QVector<int> rows = source->lowStockRows();
+    if (!sortKeys.isEmpty()) {
+        ProductSorter::sortRows(source->products(), sortKeys, &rows);
+    }
+    return rows;
+}
+
+void InventoryModel::setLowStockOnly(bool enabled)
+{
+    if (enabled == lowOnly) {
+        return;
+    }
+    beginResetModel();
+    lowOnly = enabled;
+    order = rowsFor(keys);
+    indexOrder();
+    endResetModel();
+}
+
+bool InventoryModel::lowStockOnly() const
+{
+    return lowOnly;
+}
+
+void InventoryModel::sort(int column, Qt::SortOrder direction)
+{
+    QVector<SortKey> next;
+    if (column >= 0 && column < ColumnCount) {
+        SortKey key;
+        key.column = static_cast<SortKey::Column>(column);
+        key.descending = direction == Qt::DescendingOrder;
+        next.push_back(key);
+        for (const SortKey &earlier : keys) {
+            if (earlier.column != key.column) {
+                next.push_back(earlier);
+            }
+        }
+    }
+    setOrder(next, rowsFor(next));
+}
+
+void InventoryModel::setOrder(const QVector<SortKey> &nextKeys, const QVector<int> &nextOrder)
+{
+    emit layoutAboutToBeChanged();
+    const QModelIndexList before = persistentIndexList();
+    QVector<int> rows;
+    rows.reserve(before.size());
+    for (const QModelIndex &index : before) {
+        rows.push_back(storeRow(index.row()));
+    }
+
+    keys = nextKeys;
+    order = nextOrder;
+    indexOrder();
+
+    // Move persistent indexes (selection, proxy mappings) with their rows;
+    // rows no longer shown lose theirs.
+    QModelIndexList after;
+    after.reserve(before.size());
+    if (inFileOrder()) {
+        for (int i = 0; i < before.size(); ++i) {
+            after.push_back(index(rows.at(i), before.at(i).column()));
+        }
+    } else if (lowOnly) {
+        const RowPositions position(order);
+        for (int i = 0; i < before.size(); ++i) {
+            const int at = position.at(rows.at(i));
+            after.push_back(at < 0 ? QModelIndex() : index(at, before.at(i).column()));
+        }
+    } else {
+        for (int i = 0; i < before.size(); ++i) {
+            after.push_back(index(positions.at(rows.at(i)), before.at(i).column()));
+        }
+    }
+    changePersistentIndexList(before, after);
+    emit layoutChanged();
+}
+
+void InventoryModel::beginStoreInsert(int first, int last)
+{
+    if (inFileOrder()) {
+        beginInsertRows(QModelIndex(), first, last);
+        return;
+    }
+    if (lowOnly) {
+        // Store rows shift, so the few low-stock rows are simply re-read.
+        beginResetModel();
+        return;
+    }
+    // Sorted positions are only known once the rows exist.
+    pendingFirst = first;
+    pendingLast = last;
+}
+
+void InventoryModel::endStoreInsert()
+{
+    if (inFileOrder()) {
+        endInsertRows();
+        return;
+    }
+    if (lowOnly) {
+        order = rowsFor(keys);
+        endResetModel();
+        return;
+    }
+    if (pendingFirst != pendingLast) {
+        beginResetModel();
+        order = source->sortedRows(keys);
+        indexOrder();
+        endResetModel();
+        return;
+    }
+    const int at = source->sortedPosition(keys, pendingFirst);
+    beginInsertRows(QModelIndex(), at, at);
+    order = source->sortedRows(keys);
+    indexOrder();
+    endInsertRows();
+}
+
+void InventoryModel::beginStoreRemove(int first, int last)
+{
+    if (inFileOrder()) {
+        beginRemoveRows(QModelIndex(), first, last);
+        return;
+    }
+    pendingReset = lowOnly || first != last;
+    if (pendingReset) {
+        beginResetModel();
+        return;
+    }
+    const int at = positions.at(first);
+    beginRemoveRows(QModelIndex(), at, at);
+}
+
+void InventoryModel::endStoreRemove()
+{
+    if (inFileOrder()) {
+        endRemoveRows();
+        return;
+    }
+    order = rowsFor(keys);
+    indexOrder();
+    if (pendingReset) {
+        endResetModel();
+    } else {
+        endRemoveRows();
+    }
+}
+
+void InventoryModel::storeRowChanged(int row)
+{
+    if (lowOnly) {
+        syncLowStock();
+        const int shown = order.indexOf(row);
+        if (shown >= 0) {
+            emit dataChanged(index(shown, 0), index(shown, ColumnCount - 1));
+        }
+        return;
+    }
+    int at = row;
+    if (!keys.isEmpty()) {
+        at = positions.at(row);
+        const int to = source->sortedPosition(keys, row);
+        if (to != at) {
+            const QVector<int> &next = source->sortedRows(keys);
+            if (beginMoveRows(QModelIndex(), at, at, QModelIndex(), to > at ? to + 1 : to)) {
+                order = next;
+                endMoveRows();
+            } else {
+                order = next;
+            }
+            // Only rows between the old and new place changed position.
+            for (int i = std::min(at, to); i <= std::max(at, to); ++i) {
+                positions[order.at(i)] = i;
+            }
+            at = to;
+        }
+    }
+    emit dataChanged(index(at, 0), index(at, ColumnCount - 1));
+}
+
+void InventoryModel::storeRowsChanged(const QVector<int> &rows)
+{
+    if (lowOnly) {
+        syncLowStock();
+    } else if (!keys.isEmpty()) {
+        // The order only changed if one of the rows moved; those that did
+        // are re-laid out in one go rather than one move each.
+        const bool moved = std::any_of(rows.begin(), rows.end(), [this](int row) {
+            return source->sortedPosition(keys, row) != positions.at(row);
+        });
+        if (moved) {
+            setOrder(keys, source->sortedRows(keys));
+        }
+    }
+    QVector<int> changed;
+    if (inFileOrder()) {
+        changed = rows;
+    } else if (lowOnly) {
+        const RowPositions position(order);
+        for (int row : rows) {
+            const int at = position.at(row);
+            if (at >= 0) {
+                changed.push_back(at);
+            }
+        }
+        std::sort(changed.begin(), changed.end());
+    } else {
+        for (int row : rows) {
+            changed.push_back(positions.at(row));
+        }
+        std::sort(changed.begin(), changed.end());
+    }
+
+    // One dataChanged per run of adjacent rows.
+    for (int first = 0; first < changed.size();) {
+        int last = first;
+        while (last + 1 < changed.size() && changed.at(last + 1) == changed.at(last) + 1) {
+            ++last;
+        }
+        emit dataChanged(index(changed.at(first), 0), index(changed.at(last), ColumnCount - 1));
+        first = last + 1;
+    }
+}
+
+void InventoryModel::indexOrder()
+{
+    if (keys.isEmpty() || lowOnly) {
+        positions.clear();
+        return;
+    }
+    positions.resize(order.size());
+    for (int i = 0; i < order.size(); ++i) {
+        positions[order.at(i)] = i;
+    }
+}
+
+void InventoryModel::syncLowStock()
+{
+    // Rows that left the index go, new ones are appended, then one
+    // re-layout puts them in order: O(k) in the low-stock count.
+    const QVector<int> next = rowsFor(keys);
+    const RowPositions wanted(next);
+    for (int i = order.size() - 1; i >= 0; --i) {
+        if (wanted.at(order.at(i)) < 0) {
+            beginRemoveRows(QModelIndex(), i, i);
+            order.remove(i);
+            endRemoveRows();
+        }
+    }
+    const RowPositions shown(order);
+    QVector<int> added;
+    for (int row : next) {
+        if (shown.at(row) < 0) {
+            added.push_back(row);
+        }
+    }
+    if (!added.isEmpty()) {
+        beginInsertRows(QModelIndex(), order.size(), order.size() + added.size() - 1);
+        order += added;
+        endInsertRows();
+    }
+    if (order != next) {
+        setOrder(keys, next);
+    }
+}
+
+QVariant InventoryModel::data(const QModelIndex &index, int role) const
+{
+    const ProductStore &products = source->products();
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+
+    const int row = storeRow(index.row());
+    if (role == Qt::DisplayRole) {
+        // Format cells only when the view asks for them.
+        switch (index.column()) {
+        case ColId:
+            return products.id(row);
+        case ColName:
+            return products.name(row);
+        case ColPrice:
+            return products.price(row).toString();
+        case ColQty:
+            return products.quantity(row);
+        default:
+            return QVariant();
+        }
+    }
+
+    if (role == Qt::BackgroundRole && source->isLowStock(row)) {
+        // Highlight rows at or below their reorder level in red.
+        return QBrush(kLowStockColor);
+    }
+    if (role == Qt::ToolTipRole) {
+        return QString("Reorder at %1").arg(source->reorderLevel(row));
+    }
+    return QVariant();
+}
+
+QVariant InventoryModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole &&
+        section >= 0 && section < kHeaders.size()) {
+        return kHeaders.at(section);
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+InventoryStore *InventoryModel::inventory() const
+{
+    return source;
+}
@@ -0,0 +1,120 @@
+#include "inventorysaver.h"
+
+#include "appdata.h"
+#include "inventorysnapshot.h"
+#include "trace.h"
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+
+InventorySaver::InventorySaver(QObject *parent)
+    : QObject(parent)
+    , worker(nullptr)
+    , jobs(0)
+    , ok(false)
+    , elapsedMs(0)
+{
+}
+
+InventorySaver::~InventorySaver()
+{
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+bool InventorySaver::writeFiles(const ProductStore &products, QString *errorMessage)
+{
+    Trace::Span span("InventorySaver::writeFiles");
+    // Ensure AppData directory exists.
+    if (!AppData::ensureDataDir(errorMessage)) {
+        return false;
+    }
+
+    // Write CSV to the primary inventory file.
+    QSaveFile file(AppData::inventoryFilePath());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (errorMessage) {
+            *errorMessage = "Could not write inventory file.";
+        }
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "id,name,price,quantity\n";
+    for (int i = 0; i < products.size(); ++i) {
+        const QString id = products.idRef(i);
+        const QString name = products.nameRef(i);
+        if (id.isEmpty() || name.isEmpty()) {
+            continue;
+        }
+        out << id << "," << name << ","
+            << products.price(i).toLatin1() << ","
+            << products.quantity(i) << "\n";
+    }
+    out.flush();
+
+    if (!file.commit()) {
+        if (errorMessage) {
+            *errorMessage = "Could not finalize inventory file.";
+        }
+        return false;
+    }
+
+    // Refresh the snapshot so it matches the CSV just written. A failure
+    // here only costs the next start a CSV parse.
+    InventorySnapshot::write(products, AppData::inventorySnapshotPath(),
+                             AppData::inventoryFilePath(), nullptr);
+    return true;
+}
+
+bool InventorySaver::isBusy() const
+{
+    return worker != nullptr;
+}
+
+bool InventorySaver::start(const ProductStore &products)
+{
+    if (worker) {
+        return false;
+    }
+
+    worker = QThread::create([this, products]() {
+        QElapsedTimer timer;
+        timer.start();
+        QString message;
+        ok = writeFiles(products, &message);
+        error = message;
+        elapsedMs = timer.elapsed();
+    });
+    // Ignore a late signal from a job waitForFinished already collected.
+    const quint64 job = ++jobs;
+    connect(worker, &QThread::finished, this, [this, job]() {
+        if (job == jobs) {
+            collect();
+        }
+    });
+    worker->start();
+    return true;
+}
+
+void InventorySaver::waitForFinished()
+{
+    if (worker) {
+        worker->wait();
+        collect();
+    }
+}
+
+void InventorySaver::collect()
+{
+    if (!worker) {
+        return;
+    }
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+    emit finished(ok, elapsedMs, error);
+}
@@ -0,0 +1,258 @@
+#include "inventorysnapshot.h"
+
+#include "appdata.h"
+#include "productstore.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QVector>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+const char kMagic[8] = {'S', 'M', 'I', 'N', 'V', 'S', 'N', 'P'};
+// Version 2 stores prices as integer cents (version 1 had doubles).
+const quint32 kVersion = 2;
+
+// Fixed 64-byte file header.
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 rowCount;
+    quint64 textLength;
+    qint64 csvSize;
+    qint64 csvModified;
+    quint64 checksum;
+    quint8 reserved[16];
+};
+static_assert(sizeof(Header) == 64, "snapshot header must stay 64 bytes");
+
+quint64 padded(quint64 bytes)
+{
+    return (bytes + 7) & ~quint64(7);
+}
+
+// Word-at-a-time FNV-style checksum; each section is fed zero-padded to 8 bytes.
+class Checksum
+{
+public:
+    void add(const char *data, quint64 bytes)
+    {
+        quint64 word = 0;
+        quint64 i = 0;
+        for (; i + 8 <= bytes; i += 8) {
+            std::memcpy(&word, data + i, 8);
+            mix(word);
+        }
+        if (i < bytes) {
+            word = 0;
+            std::memcpy(&word, data + i, bytes - i);
+            mix(word);
+        }
+    }
+
+    quint64 value() const
+    {
+        return state;
+    }
+
+private:
+    void mix(quint64 word)
+    {
+        state = (state ^ word) * 0x100000001B3ULL;
+        state ^= state >> 29;
+    }
+
+    quint64 state = 0xCBF29CE484222325ULL;
+};
+
+// Write one section followed by zero padding up to the next 8-byte boundary.
+bool writeSection(QSaveFile &file, Checksum &sum, const void *data, quint64 bytes)
+{
+    const char *raw = static_cast<const char *>(data);
+    sum.add(raw, bytes);
+    if (bytes > 0 && file.write(raw, static_cast<qint64>(bytes)) != static_cast<qint64>(bytes)) {
+        return false;
+    }
+    const quint64 padding = padded(bytes) - bytes;
+    if (padding > 0) {
+        const char zeros[8] = {0};
+        return file.write(zeros, static_cast<qint64>(padding)) == static_cast<qint64>(padding);
+    }
+    return true;
+}
+
+}
+
+namespace InventorySnapshot {
+
+bool write(const ProductStore &products, const QString &snapshotPath,
+           const QString &csvPath, QString *errorMessage)
+{
+    // Flatten the store into contiguous columns with a garbage-free heap;
+    // each distinct name is written once and shared by its rows.
+    const int rows = products.size();
+    QHash<quint32, quint32> nameOffsets;
+    QVector<qint64> prices(rows);
+    QVector<qint32> quantities(rows);
+    QVector<quint32> idSlices(rows * 2);
+    QVector<quint32> nameSlices(rows * 2);
+    QString text;
+    for (int row = 0; row < rows; ++row) {
+        const QString id = products.idRef(row);
+        const QString name = products.nameRef(row);
+        prices[row] = products.price(row).cents();
+        quantities[row] = products.quantity(row);
+        idSlices[row * 2] = static_cast<quint32>(text.size());
+        idSlices[row * 2 + 1] = static_cast<quint32>(id.size());
+        text.append(id);
+        const auto known = nameOffsets.constFind(products.nameHandle(row));
+        if (known != nameOffsets.constEnd()) {
+            nameSlices[row * 2] = known.value();
+        } else {
+            nameSlices[row * 2] = static_cast<quint32>(text.size());
+            nameOffsets.insert(products.nameHandle(row), nameSlices[row * 2]);
+            text.append(name);
+        }
+        nameSlices[row * 2 + 1] = static_cast<quint32>(name.size());
+    }
+
+    QSaveFile file(snapshotPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorMessage) {
+            *errorMessage = "Could not write inventory snapshot.";
+        }
+        return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.rowCount = static_cast<quint32>(rows);
+    header.textLength = static_cast<quint64>(text.size());
+    AppData::fileStamp(csvPath, &header.csvSize, &header.csvModified);
+
+    // Header first as a placeholder; rewritten once the checksum is known.
+    Checksum sum;
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+    ok = ok && writeSection(file, sum, prices.constData(), sizeof(qint64) * quint64(rows));
+    ok = ok && writeSection(file, sum, quantities.constData(), sizeof(qint32) * quint64(rows));
+    ok = ok && writeSection(file, sum, idSlices.constData(), sizeof(quint32) * quint64(rows) * 2);
+    ok = ok && writeSection(file, sum, nameSlices.constData(), sizeof(quint32) * quint64(rows) * 2);
+    ok = ok && writeSection(file, sum, text.constData(), sizeof(QChar) * quint64(text.size()));
+
+    header.checksum = sum.value();
+    ok = ok && file.seek(0);
+    ok = ok && file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+
+    if (!ok || !file.commit()) {
+        if (errorMessage) {
+            *errorMessage = "Could not finalize inventory snapshot.";
+        }
+        return false;
+    }
+    return true;
+}
+
+bool read(const QString &snapshotPath, const QString &csvPath,
+          ProductStore *out, QString *errorMessage)
+{
+    if (!out || !QFileInfo::exists(snapshotPath)) {
+        return false;
+    }
+
+    QFile file(snapshotPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage) {
+            *errorMessage = "Could not open inventory snapshot.";
+        }
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize < static_cast<qint64>(sizeof(Header))) {
+        if (errorMessage) {
+            *errorMessage = "Inventory snapshot is truncated.";
+        }
+        return false;
+    }
+
+    Header header;
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion) {
+        if (errorMessage) {
+            *errorMessage = "Inventory snapshot has an unknown format.";
+        }
+        return false;
+    }
+
+    // Stale when the CSV was edited or replaced after the snapshot was taken.
+    qint64 csvSize = 0;
+    qint64 csvModified = 0;
+    AppData::fileStamp(csvPath, &csvSize, &csvModified);
+    if (header.csvSize != csvSize || header.csvModified != csvModified) {
+        return false;
+    }
+
+    const quint64 rows = header.rowCount;
+    const quint64 priceBytes = padded(sizeof(qint64) * rows);
+    const quint64 qtyBytes = padded(sizeof(qint32) * rows);
+    const quint64 sliceBytes = sizeof(quint32) * rows * 2;
+    const quint64 textBytes = sizeof(QChar) * header.textLength;
+    const quint64 expected = sizeof(Header) + priceBytes + qtyBytes + sliceBytes * 2 + padded(textBytes);
+    if (rows > static_cast<quint64>(INT_MAX) || header.textLength > static_cast<quint64>(INT_MAX) ||
+        expected != static_cast<quint64>(fileSize)) {
+        if (errorMessage) {
+            *errorMessage = "Inventory snapshot is truncated.";
+        }
+        return false;
+    }
+
+    // Map the file and read the columns in place.
+    uchar *base = file.map(0, fileSize);
+    if (!base) {
+        if (errorMessage) {
+            *errorMessage = "Could not map inventory snapshot.";
+        }
+        return false;
+    }
+
+    const char *prices = reinterpret_cast<const char *>(base) + sizeof(Header);
+    const char *quantities = prices + priceBytes;
+    const char *idSlices = quantities + qtyBytes;
+    const char *nameSlices = idSlices + sliceBytes;
+    const char *text = nameSlices + sliceBytes;
+
+    Checksum sum;
+    sum.add(prices, sizeof(qint64) * rows);
+    sum.add(quantities, sizeof(qint32) * rows);
+    sum.add(idSlices, sliceBytes);
+    sum.add(nameSlices, sliceBytes);
+    sum.add(text, textBytes);
+
+    bool ok = sum.value() == header.checksum;
+    if (ok) {
+        const QString heap(reinterpret_cast<const QChar *>(text), static_cast<int>(header.textLength));
+        ProductStore loaded;
+        ok = loaded.assign(reinterpret_cast<const qint64 *>(prices),
+                           reinterpret_cast<const qint32 *>(quantities),
+                           reinterpret_cast<const quint32 *>(idSlices),
+                           reinterpret_cast<const quint32 *>(nameSlices),
+                           static_cast<int>(rows), heap);
+        if (ok) {
+            *out = loaded;
+        }
+    }
+    file.unmap(base);
+
+    if (!ok && errorMessage) {
+        *errorMessage = "Inventory snapshot is corrupt.";
+    }
+    return ok;
+}
+
+}
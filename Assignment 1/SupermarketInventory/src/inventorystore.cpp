@@ -0,0 +1,1376 @@
+#include "inventorystore.h"
+
+#include "appdata.h"
+#include "inventoryjournal.h"
+#include "inventoryloader.h"
+#include "inventorysaver.h"
+#include "inventorysnapshot.h"
+#include "storagebackend.h"
+#include "trace.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <limits>
+
+namespace {
+// Fold the journal into a fresh CSV/snapshot after this many edits.
+const int kJournalCompactEntries = 5000;
+// Autosave this long after the first unsaved edit.
+const int kAutosaveDelayMs = 5000;
+// Reorder level of products without one in reorder.csv.
+const int kDefaultReorderLevel = 10;
+
+// Needles made only of these characters can match the price or quantity
+// columns, which the trigram index does not cover.
+bool couldMatchNumbers(const QString &needle)
+{
+    for (const QChar c : needle) {
+        if (!c.isDigit() && c != '.' && c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+}
+
+InventoryStore::InventoryStore(QObject *parent)
+    : QObject(parent)
+    , movements(AppData::stockHistoryPath(), AppData::stockHistoryLogPath())
+    , reorderLevelsChanged(false)
+    , changes(0)
+    , writable(true)
+    , loaderThread(nullptr)
+    , loader(nullptr)
+    , loading(false)
+    , replaying(false)
+    , historyFailing(false)
+    , journalFailing(false)
+    , backend(nullptr)
+    , journal(new InventoryJournal(AppData::inventoryJournalPath(), this))
+    , saver(new InventorySaver(this))
+    , autosaveTimer(new QTimer(this))
+    , savedRevision(0)
+    , checkpointRevision(0)
+{
+    qRegisterMetaType<QVector<Product>>("QVector<Product>");
+
+    autosaveTimer->setSingleShot(true);
+    autosaveTimer->setInterval(kAutosaveDelayMs);
+    connect(autosaveTimer, &QTimer::timeout, this, &InventoryStore::autosave);
+    connect(saver, &InventorySaver::finished, this, &InventoryStore::completeSave);
+}
+
+InventoryStore::~InventoryStore()
+{
+    // The window listening may already be half destroyed; the last writes
+    // below go unreported.
+    blockSignals(true);
+    stopLoader();
+    saver->waitForFinished();
+    flushMovements();
+    if (writable) {
+        flushReorderLevels();
+    }
+}
+
+bool InventoryStore::parseProduct(const QString &id, const QString &name, const QString &price,
+                                  const QString &quantity, Product *out, QString *errorMessage)
+{
+    const QString rawId = id.trimmed();
+    const QString rawName = name.trimmed();
+    const QString rawPrice = price.trimmed();
+    const QString rawQty = quantity.trimmed();
+
+    // Basic required-field checks.
+    if (rawId.isEmpty() || rawName.isEmpty() || rawPrice.isEmpty() || rawQty.isEmpty()) {
+        setError(errorMessage, "All fields are required.");
+        return false;
+    }
+
+    bool qtyOk = false;
+    Product product;
+    product.id = rawId;
+    product.name = rawName;
+    product.quantity = rawQty.toInt(&qtyOk);
+    if (!Money::parse(rawPrice, &product.price)) {
+        product.price = Money::fromCents(-1);
+    }
+    if (!qtyOk) {
+        product.quantity = -1;
+    }
+    if (!validate(product, errorMessage)) {
+        return false;
+    }
+    *out = product;
+    return true;
+}
+
+bool InventoryStore::validate(const Product &product, QString *errorMessage)
+{
+    if (product.id.isEmpty() || product.name.isEmpty()) {
+        setError(errorMessage, "All fields are required.");
+        return false;
+    }
+
+    // CSV safety checks (no commas/newlines in text fields).
+    if (product.id.contains(",") || product.name.contains(",") ||
+        product.id.contains("\n") || product.name.contains("\n")) {
+        setError(errorMessage, "Commas and newlines are not allowed in ID or name.");
+        return false;
+    }
+
+    // Numeric validation.
+    if (product.price.cents() < 0) {
+        setError(errorMessage, "Price must be a valid non-negative number.");
+        return false;
+    }
+    if (product.quantity < 0) {
+        setError(errorMessage, "Quantity must be a valid non-negative number.");
+        return false;
+    }
+    return true;
+}
+
+const ProductStore &InventoryStore::products() const
+{
+    return catalog;
+}
+
+int InventoryStore::size() const
+{
+    return catalog.size();
+}
+
+int InventoryStore::find(const QString &id) const
+{
+    return catalog.findId(id);
+}
+
+void InventoryStore::filter(const QString &needle, QBitArray *rows) const
+{
+    Trace::Span span("InventoryStore::filter");
+    // The index only covers IDs and names, so numeric needles always scan.
+    QVector<int> hits;
+    if (!couldMatchNumbers(needle) && trigramIndex.lookup(needle, catalog, &hits)) {
+        *rows = QBitArray(catalog.size());
+        for (int row : hits) {
+            rows->setBit(row);
+        }
+        return;
+    }
+    scanText.scan(needle, catalog, rows);
+}
+
+bool InventoryStore::matches(int row, const QString &needle) const
+{
+    // Match against the raw heap text; only numbers need formatting.
+    if (catalog.idRef(row).contains(needle, Qt::CaseInsensitive) ||
+        catalog.nameRef(row).contains(needle, Qt::CaseInsensitive)) {
+        return true;
+    }
+    if (catalog.price(row).toString().contains(needle, Qt::CaseInsensitive)) {
+        return true;
+    }
+    return QString::number(catalog.quantity(row)).contains(needle, Qt::CaseInsensitive);
+}
+
+quint64 InventoryStore::revision() const
+{
+    return changes;
+}
+
+bool InventoryStore::isModified() const
+{
+    return !backend && changes != savedRevision;
+}
+
+bool InventoryStore::isLoading() const
+{
+    return loading;
+}
+
+void InventoryStore::setWritable(bool enabled)
+{
+    writable = enabled;
+}
+
+bool InventoryStore::isWritable() const
+{
+    return writable;
+}
+
+void InventoryStore::setBackend(StorageBackend *storage)
+{
+    backend = storage;
+}
+
+StorageBackend *InventoryStore::storageBackend() const
+{
+    return backend;
+}
+
+InventoryTotals InventoryStore::totals() const
+{
+    InventoryTotals out = running;
+    out.lowStock = lowStock.size();
+    return out;
+}
+
+InventoryTotals InventoryStore::totals(const QVector<int> &rows) const
+{
+    InventoryTotals out;
+    for (int row : rows) {
+        ++out.products;
+        out.units += catalog.quantity(row);
+        out.valueCents += priceCents(row) * catalog.quantity(row);
+        if (isLowStock(row)) {
+            ++out.lowStock;
+        }
+    }
+    return out;
+}
+
+const QVector<int> &InventoryStore::sortedRows(const QVector<SortKey> &keys) const
+{
+    return sorter.rows(catalog, keys);
+}
+
+int InventoryStore::sortedPosition(const QVector<SortKey> &keys, int row) const
+{
+    return sorter.position(catalog, keys, row);
+}
+
+qint64 InventoryStore::priceCents(int row) const
+{
+    return catalog.price(row).cents();
+}
+
+void InventoryStore::countRow(int row, int sign)
+{
+    // Add (sign 1) or take away (sign -1) one row's share of the totals.
+    running.products += sign;
+    running.units += sign * static_cast<qint64>(catalog.quantity(row));
+    running.valueCents += sign * priceCents(row) * catalog.quantity(row);
+}
+
+int InventoryStore::reorderLevel(int row) const
+{
+    return reorderLevels.value(catalog.idRef(row), kDefaultReorderLevel);
+}
+
+bool InventoryStore::isLowStock(int row) const
+{
+    return catalog.quantity(row) <= reorderLevel(row);
+}
+
+QVector<int> InventoryStore::lowStockRows() const
+{
+    // Walk the index rather than the catalog; each ID lookup is O(1).
+    const QStringList ids = lowStock.ids();
+    QVector<int> rows;
+    rows.reserve(ids.size());
+    for (const QString &id : ids) {
+        rows.push_back(catalog.findId(id));
+    }
+    return rows;
+}
+
+int InventoryStore::lowStockCount() const
+{
+    return lowStock.size();
+}
+
+bool InventoryStore::setReorderLevel(int row, int level, QString *errorMessage)
+{
+    if (!checkWrite(errorMessage)) {
+        return false;
+    }
+    if (row < 0 || row >= catalog.size()) {
+        setError(errorMessage, "Select a product to change.");
+        return false;
+    }
+    if (level < 0) {
+        setError(errorMessage, "Reorder level must be a non-negative number.");
+        return false;
+    }
+
+    const QString id = catalog.id(row);
+    if (level == kDefaultReorderLevel) {
+        reorderLevels.remove(id);
+    } else {
+        reorderLevels.insert(id, level);
+    }
+    reorderLevelsChanged = true;
+    indexStock(row);
+    // Only the highlight changes; the CSV and search text stay the same.
+    emit rowChanged(row);
+    // reorder.csv is written with the next autosave, once per burst.
+    if (!autosaveTimer->isActive()) {
+        autosaveTimer->start();
+    }
+    return true;
+}
+
+void InventoryStore::indexStock(int row)
+{
+    lowStock.update(catalog.id(row), catalog.quantity(row), reorderLevel(row));
+}
+
+void InventoryStore::loadReorderLevels()
+{
+    // A missing or damaged file just means default levels.
+    reorderLevels.clear();
+    reorderLevelsChanged = false;
+    QFile file(AppData::reorderLevelsPath());
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QStringList fields = in.readLine().split(',');
+        if (fields.size() != 2) {
+            continue;
+        }
+        bool ok = false;
+        const int level = fields.at(1).trimmed().toInt(&ok);
+        if (ok && level >= 0) {
+            reorderLevels.insert(fields.at(0).trimmed(), level);
+        }
+    }
+}
+
+bool InventoryStore::saveReorderLevels(QString *errorMessage)
+{
+    QString error;
+    if (!AppData::ensureDataDir(&error)) {
+        setError(errorMessage, error);
+        return false;
+    }
+    QSaveFile file(AppData::reorderLevelsPath());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        setError(errorMessage, "Could not save reorder levels.");
+        return false;
+    }
+    QTextStream out(&file);
+    out << "id,level\n";
+    for (auto it = reorderLevels.constBegin(); it != reorderLevels.constEnd(); ++it) {
+        out << it.key() << ',' << it.value() << '\n';
+    }
+    out.flush();
+    if (!file.commit()) {
+        setError(errorMessage, "Could not save reorder levels.");
+        return false;
+    }
+    reorderLevelsChanged = false;
+    return true;
+}
+
+void InventoryStore::flushReorderLevels()
+{
+    QString error;
+    if (reorderLevelsChanged && !saveReorderLevels(&error)) {
+        emit warning(error);
+    }
+}
+
+bool InventoryStore::checkWrite(QString *errorMessage) const
+{
+    if (!writable) {
+        setError(errorMessage, "The inventory is read-only.");
+        return false;
+    }
+    if (loading) {
+        setError(errorMessage, "The inventory is still loading.");
+        return false;
+    }
+    return true;
+}
+
+bool InventoryStore::add(const Product &product, QString *errorMessage)
+{
+    if (!checkWrite(errorMessage) || !validate(product, errorMessage)) {
+        return false;
+    }
+    // Prevent duplicate IDs.
+    if (catalog.findId(product.id) != -1) {
+        setError(errorMessage, "Product ID already exists.");
+        return false;
+    }
+
+    HistoryStep undo;
+    undo.label = "Add " + product.id;
+    undo.first = appendRow(product);
+    undo.removeCount = 1;
+    recordStep(undo);
+    storeAdd(product);
+    markDirty(product.id);
+    return true;
+}
+
+bool InventoryStore::update(int row, const Product &product, QString *errorMessage)
+{
+    if (!checkWrite(errorMessage) || !validate(product, errorMessage)) {
+        return false;
+    }
+    if (row < 0 || row >= catalog.size()) {
+        setError(errorMessage, "Select a product to update.");
+        return false;
+    }
+    const int existing = catalog.findId(product.id);
+    if (existing != -1 && existing != row) {
+        setError(errorMessage, "Product ID already exists.");
+        return false;
+    }
+
+    const Product old = catalog.product(row);
+    HistoryStep undo;
+    undo.label = "Update " + old.id;
+    if (diffRow(row, old, product, &undo)) {
+        recordStep(undo);
+    }
+    updateRow(row, product);
+    storeUpdate(old.id, product);
+    markDirty(product.id);
+    return true;
+}
+
+bool InventoryStore::remove(int row, QString *errorMessage)
+{
+    if (!checkWrite(errorMessage)) {
+        return false;
+    }
+    if (row < 0 || row >= catalog.size()) {
+        setError(errorMessage, "Select a product to delete.");
+        return false;
+    }
+
+    HistoryStep undo;
+    undo.products.push_back(catalog.product(row));
+    undo.label = "Delete " + undo.products.first().id;
+    undo.first = row;
+    keepReorderLevel(row, &undo);
+    removeRow(row);
+    recordStep(undo);
+    storeDeletes(QStringList() << undo.products.first().id);
+    markDirty(undo.products.first().id);
+    return true;
+}
+
+bool InventoryStore::upsert(const QVector<Product> &batch, int *inserted, int *updated,
+                            QString *errorMessage)
+{
+    Trace::Span span("InventoryStore::upsert");
+    if (!checkWrite(errorMessage)) {
+        return false;
+    }
+    for (const Product &product : batch) {
+        if (!validate(product, errorMessage)) {
+            return false;
+        }
+    }
+
+    // New rows are all appended, so undo just cuts the tail; updated rows
+    // keep only the fields that changed.
+    int added = 0;
+    int changed = 0;
+    HistoryStep undo;
+    undo.label = QString("Import of %1 products").arg(batch.size());
+    undo.first = catalog.size();
+    emit aboutToReset();
+    for (const Product &product : batch) {
+        const int row = catalog.findId(product.id);
+        if (row == -1) {
+            insertProduct(catalog.size(), product);
+            ++added;
+        } else {
+            diffRow(row, catalog.product(row), product, &undo);
+            storeProduct(row, product);
+            ++changed;
+        }
+    }
+    undo.removeCount = added;
+    sorter.clear();
+    ++changes;
+    emit resetDone();
+
+    if (!batch.isEmpty()) {
+        recordStep(undo);
+        storeBatch(batch, QStringList());
+        for (const Product &product : batch) {
+            markDirty(product.id);
+        }
+    }
+    if (inserted) {
+        *inserted = added;
+    }
+    if (updated) {
+        *updated = changed;
+    }
+    return true;
+}
+
+bool InventoryStore::applyStockDeltas(const QVector<SaleEvent> &sales,
+                                      StockDeltaResult *result, QString *errorMessage)
+{
+    Trace::Span span("InventoryStore::applyStockDeltas");
+    if (!checkWrite(errorMessage)) {
+        return false;
+    }
+
+    // Run each product's sales in order, so stock stops at zero where it
+    // would have at the till and the history gets what each sale did; the
+    // rows are then written once with their final quantities.
+    QHash<int, qint64> quantities;
+    QSet<QString> unknownIds;
+    QSet<int> clampedRows;
+    for (const SaleEvent &sale : sales) {
+        const int row = catalog.findId(sale.productId);
+        if (row == -1) {
+            unknownIds.insert(sale.productId);
+            continue;
+        }
+        auto pending = quantities.find(row);
+        if (pending == quantities.end()) {
+            pending = quantities.insert(row, catalog.quantity(row));
+        }
+        const qint64 wanted = pending.value() + sale.delta;
+        if (wanted < 0) {
+            clampedRows.insert(row);
+        }
+        const qint64 quantity = qBound<qint64>(0, wanted, std::numeric_limits<int>::max());
+        recordMovement(sale.productId, static_cast<int>(quantity - pending.value()),
+                       StockMovement::Sale, sale.timestamp);
+        pending.value() = quantity;
+    }
+
+    StockDeltaResult counts;
+    counts.unknown = unknownIds.size();
+    counts.clamped = clampedRows.size();
+    QVector<int> rows;
+    rows.reserve(quantities.size());
+    for (auto it = quantities.constBegin(); it != quantities.constEnd(); ++it) {
+        const int quantity = static_cast<int>(it.value());
+        if (quantity != catalog.quantity(it.key())) {
+            storeQuantity(it.key(), quantity);
+            rows.push_back(it.key());
+        }
+    }
+    counts.applied = rows.size();
+
+    if (!rows.isEmpty()) {
+        std::sort(rows.begin(), rows.end());
+        sorter.rowsChanged(catalog, rows, SortKey::Quantity);
+        ++changes;
+        emit rowsChanged(rows);
+
+        QVector<Product> changed;
+        changed.reserve(rows.size());
+        for (int row : rows) {
+            changed.push_back(catalog.product(row));
+            markDirty(changed.last().id);
+        }
+        storeBatch(changed, QStringList());
+    }
+    if (result) {
+        *result = counts;
+    }
+    return true;
+}
+
+bool InventoryStore::canUndo() const
+{
+    return history.canUndo();
+}
+
+bool InventoryStore::canRedo() const
+{
+    return history.canRedo();
+}
+
+QString InventoryStore::undoText() const
+{
+    return history.undoLabel();
+}
+
+QString InventoryStore::redoText() const
+{
+    return history.redoLabel();
+}
+
+bool InventoryStore::undo(QString *errorMessage)
+{
+    if (!checkWrite(errorMessage)) {
+        return false;
+    }
+    if (!history.canUndo()) {
+        setError(errorMessage, "Nothing to undo.");
+        return false;
+    }
+    history.pushRedo(applyStep(history.takeUndo()));
+    emit historyChanged();
+    return true;
+}
+
+bool InventoryStore::redo(QString *errorMessage)
+{
+    if (!checkWrite(errorMessage)) {
+        return false;
+    }
+    if (!history.canRedo()) {
+        setError(errorMessage, "Nothing to redo.");
+        return false;
+    }
+    history.pushUndo(applyStep(history.takeRedo()));
+    emit historyChanged();
+    return true;
+}
+
+void InventoryStore::setHistoryLimit(qint64 bytes)
+{
+    history.setLimit(bytes);
+    emit historyChanged();
+}
+
+void InventoryStore::keepReorderLevel(int row, HistoryStep *step) const
+{
+    // Only levels that differ from the default need keeping.
+    const auto it = reorderLevels.constFind(catalog.idRef(row));
+    if (it != reorderLevels.constEnd()) {
+        step->reorderLevels.insert(it.key(), it.value());
+    }
+}
+
+void InventoryStore::recordStep(const HistoryStep &undo)
+{
+    history.record(undo);
+    emit historyChanged();
+}
+
+bool InventoryStore::diffRow(int row, const Product &before, const Product &after,
+                             HistoryStep *undo)
+{
+    // Keep only the old values of fields the edit changes.
+    FieldDelta delta;
+    delta.row = row;
+    if (before.id != after.id) {
+        delta.fields |= FieldDelta::Id;
+        delta.values.id = before.id;
+    }
+    if (before.name != after.name) {
+        delta.fields |= FieldDelta::Name;
+        delta.values.name = before.name;
+    }
+    if (before.price != after.price) {
+        delta.fields |= FieldDelta::Price;
+        delta.values.price = before.price;
+    }
+    if (before.quantity != after.quantity) {
+        delta.fields |= FieldDelta::Quantity;
+        delta.values.quantity = before.quantity - after.quantity;
+    }
+    if (delta.fields == 0) {
+        return false;
+    }
+    undo->changes.push_back(delta);
+    return true;
+}
+
+HistoryStep InventoryStore::applyStep(const HistoryStep &step)
+{
+    // Single-row steps use the row signals; anything larger is one reset.
+    const int touched = step.changes.size() + step.removeCount + step.products.size();
+    const bool batch = touched > 1;
+    if (batch) {
+        emit aboutToReset();
+    }
+
+    HistoryStep inverse;
+    inverse.label = step.label;
+    inverse.first = step.first;
+    inverse.removeCount = step.products.size();
+    QVector<Product> upserted;
+    QStringList deleted;
+
+    for (int i = step.changes.size() - 1; i >= 0; --i) {
+        const FieldDelta &delta = step.changes.at(i);
+        const Product before = catalog.product(delta.row);
+        Product after = before;
+        FieldDelta reverse;
+        reverse.row = delta.row;
+        reverse.fields = delta.fields;
+        if (delta.fields & FieldDelta::Id) {
+            after.id = delta.values.id;
+            reverse.values.id = before.id;
+        }
+        if (delta.fields & FieldDelta::Name) {
+            after.name = delta.values.name;
+            reverse.values.name = before.name;
+        }
+        if (delta.fields & FieldDelta::Price) {
+            after.price = delta.values.price;
+            reverse.values.price = before.price;
+        }
+        if (delta.fields & FieldDelta::Quantity) {
+            // Relative, and stopped at zero like a sale; the inverse takes
+            // back exactly what was applied.
+            const qint64 quantity = qint64(before.quantity) + delta.values.quantity;
+            after.quantity = static_cast<int>(
+                qBound<qint64>(0, quantity, std::numeric_limits<int>::max()));
+            reverse.values.quantity = before.quantity - after.quantity;
+        }
+        inverse.changes.push_back(reverse);
+
+        if (batch) {
+            storeProduct(delta.row, after);
+        } else {
+            updateRow(delta.row, after);
+        }
+        if (before.id != after.id) {
+            storeUpdate(before.id, after);
+            markDirty(before.id);
+        } else {
+            upserted.push_back(after);
+        }
+        markDirty(after.id);
+    }
+
+    if (step.removeCount > 0) {
+        const int end = step.first + step.removeCount;
+        for (int row = step.first; row < end; ++row) {
+            inverse.products.push_back(catalog.product(row));
+            deleted.push_back(inverse.products.last().id);
+            keepReorderLevel(row, &inverse);
+        }
+        if (!batch) {
+            removeRow(step.first);
+        } else {
+            if (end == catalog.size()) {
+                truncateRows(step.first);
+            } else {
+                for (int row = end - 1; row >= step.first; --row) {
+                    dropProduct(row);
+                }
+            }
+            // Hand back the text of the dropped rows straight away.
+            catalog.compact();
+        }
+    }
+
+    // Levels first, so the restored rows are flagged against them.
+    for (auto it = step.reorderLevels.constBegin(); it != step.reorderLevels.constEnd(); ++it) {
+        reorderLevels.insert(it.key(), it.value());
+        reorderLevelsChanged = true;
+    }
+    for (int i = 0; i < step.products.size(); ++i) {
+        const Product &product = step.products.at(i);
+        if (batch) {
+            insertProduct(step.first + i, product);
+        } else {
+            emit rowsAboutToBeInserted(step.first, step.first);
+            insertProduct(step.first, product);
+            sorter.rowInserted(catalog, step.first);
+            ++changes;
+            emit rowsInserted();
+        }
+        upserted.push_back(product);
+    }
+
+    if (batch) {
+        sorter.clear();
+        ++changes;
+        emit resetDone();
+    }
+
+    storeBatch(upserted, deleted);
+    for (const QString &id : deleted) {
+        markDirty(id);
+    }
+    for (const Product &product : step.products) {
+        markDirty(product.id);
+    }
+    return inverse;
+}
+
+int InventoryStore::appendRow(const Product &product)
+{
+    const int row = catalog.size();
+    emit rowsAboutToBeInserted(row, row);
+    insertProduct(row, product);
+    sorter.rowInserted(catalog, row);
+    ++changes;
+    emit rowsInserted();
+    return row;
+}
+
+void InventoryStore::updateRow(int row, const Product &product)
+{
+    storeProduct(row, product);
+    sorter.rowChanged(catalog, row);
+    ++changes;
+    emit rowChanged(row);
+}
+
+void InventoryStore::removeRow(int row)
+{
+    emit rowsAboutToBeRemoved(row, row);
+    dropProduct(row);
+    sorter.rowRemoved(row);
+    ++changes;
+    emit rowsRemoved();
+}
+
+void InventoryStore::insertProduct(int row, const Product &product)
+{
+    // Row writes below keep every index in step but send no signals.
+    catalog.insert(row, product);
+    trigramIndex.insertRow(row, product.id, product.name);
+    scanText.insertRow(catalog, row);
+    indexStock(row);
+    countRow(row, 1);
+    recordMovement(product.id, product.quantity, StockMovement::Added);
+}
+
+void InventoryStore::storeProduct(int row, const Product &product)
+{
+    const QString oldId = catalog.id(row);
+    const QString oldName = catalog.name(row);
+    // A renamed product starts a new history.
+    if (oldId == product.id) {
+        recordMovement(oldId, product.quantity - catalog.quantity(row), StockMovement::Edit);
+    } else {
+        recordMovement(oldId, -catalog.quantity(row), StockMovement::Removed);
+        recordMovement(product.id, product.quantity, StockMovement::Added);
+    }
+    countRow(row, -1);
+    catalog.update(row, product);
+    trigramIndex.updateRow(row, oldId, oldName, product.id, product.name);
+    scanText.updateRow(catalog, row);
+    if (oldId != product.id) {
+        // A renamed product keeps its reorder level.
+        lowStock.remove(oldId);
+        if (reorderLevels.contains(oldId)) {
+            reorderLevels.insert(product.id, reorderLevels.take(oldId));
+            reorderLevelsChanged = true;
+        }
+    }
+    indexStock(row);
+    countRow(row, 1);
+}
+
+void InventoryStore::storeQuantity(int row, int quantity)
+{
+    // Names and IDs are untouched, so only the numbers and flags follow.
+    countRow(row, -1);
+    catalog.setQuantity(row, quantity);
+    scanText.updateQuantity(catalog, row);
+    indexStock(row);
+    countRow(row, 1);
+}
+
+void InventoryStore::dropProduct(int row)
+{
+    const QString id = catalog.id(row);
+    recordMovement(id, -catalog.quantity(row), StockMovement::Removed);
+    countRow(row, -1);
+    lowStock.remove(id);
+    if (reorderLevels.remove(id) > 0) {
+        reorderLevelsChanged = true;
+    }
+    trigramIndex.removeRow(row, catalog.idRef(row), catalog.nameRef(row));
+    catalog.remove(row);
+    scanText.removeRow(row);
+}
+
+void InventoryStore::truncateRows(int rows)
+{
+    // Drop the tail without shifting anything, e.g. to undo an import.
+    for (int row = catalog.size() - 1; row >= rows; --row) {
+        const QString id = catalog.id(row);
+        recordMovement(id, -catalog.quantity(row), StockMovement::Removed);
+        countRow(row, -1);
+        lowStock.remove(id);
+        if (reorderLevels.remove(id) > 0) {
+            reorderLevelsChanged = true;
+        }
+        trigramIndex.removeRow(row, catalog.idRef(row), catalog.nameRef(row));
+    }
+    catalog.truncate(rows);
+    scanText.truncate(rows);
+}
+
+void InventoryStore::recordMovement(const QString &id, int delta, StockMovement::Reason reason)
+{
+    recordMovement(id, delta, reason, QDateTime::currentMSecsSinceEpoch());
+}
+
+void InventoryStore::recordMovement(const QString &id, int delta, StockMovement::Reason reason,
+                                    qint64 timestamp)
+{
+    // Rows arriving from the CSV and replayed journal entries are not new
+    // movements; read-only stores leave the history to the process that
+    // owns it.
+    if (loading || replaying || !writable || delta == 0) {
+        return;
+    }
+    movements.record(id, delta, reason, timestamp);
+}
+
+void InventoryStore::flushMovements()
+{
+    if (!writable || !movements.isOpen()) {
+        return;
+    }
+    // A failing disk fails every flush; say so once until one succeeds.
+    QString error;
+    const bool ok = movements.flush(&error);
+    if (!ok && !historyFailing) {
+        emit warning(error);
+    }
+    historyFailing = !ok;
+}
+
+const StockHistory &InventoryStore::stockHistory() const
+{
+    return movements;
+}
+
+void InventoryStore::resetRows(const ProductStore &replacement)
+{
+    emit aboutToReset();
+    catalog = replacement;
+    trigramIndex.rebuild(catalog);
+    scanText.invalidate();
+    lowStock.clear();
+    running = InventoryTotals();
+    for (int row = 0; row < catalog.size(); ++row) {
+        indexStock(row);
+        countRow(row, 1);
+    }
+    sorter.clear();
+    ++changes;
+    emit resetDone();
+}
+
+void InventoryStore::appendBatch(const QVector<Product> &batch)
+{
+    // Work out which rows are new first so views get a single insert.
+    // Duplicates inside the file are dropped, first row wins.
+    QVector<int> accepted;
+    accepted.reserve(batch.size());
+    QSet<QString> seen;
+    for (int i = 0; i < batch.size(); ++i) {
+        const QString &id = batch.at(i).id;
+        if (catalog.findId(id) != -1 || seen.contains(id)) {
+            continue;
+        }
+        seen.insert(id);
+        accepted.push_back(i);
+    }
+    if (accepted.isEmpty()) {
+        return;
+    }
+
+    const int first = catalog.size();
+    emit rowsAboutToBeInserted(first, first + accepted.size() - 1);
+    for (int i : accepted) {
+        insertProduct(catalog.size(), batch.at(i));
+    }
+    sorter.rowsAppended(catalog, first);
+    ++changes;
+    emit rowsInserted();
+}
+
+bool InventoryStore::load(bool background, QString *errorMessage)
+{
+    Trace::Span span("InventoryStore::load");
+    if (loading) {
+        setError(errorMessage, "The inventory is already loading.");
+        return false;
+    }
+
+    // Row numbers in the history only make sense for the rows being replaced.
+    history.clear();
+    emit historyChanged();
+
+    // Levels first, so rows are flagged as they arrive.
+    loadReorderLevels();
+
+    // Missing history only costs the charts, so the load goes on.
+    QString historyError;
+    if (!movements.isOpen() && AppData::ensureDataDir(&historyError)) {
+        movements.open(writable, &historyError);
+    }
+    if (!movements.isOpen()) {
+        emit warning(historyError);
+    }
+
+    // A backend already holds every edit, so there is nothing to replay.
+    if (backend) {
+        ProductStore stored;
+        QString error;
+        const bool ok = backend->loadProducts(&stored, &error);
+        resetRows(stored);
+        if (!ok) {
+            writable = false;
+            setError(errorMessage, "Could not load inventory: " + error);
+            return false;
+        }
+        savedRevision = changes;
+        return true;
+    }
+
+    const QString csvPath = AppData::inventoryFilePath();
+    if (!QFileInfo::exists(csvPath)) {
+        resetRows(ProductStore());
+        return replayJournal(errorMessage);
+    }
+
+    // A snapshot that matches the CSV skips parsing entirely.
+    ProductStore snapshot;
+    if (InventorySnapshot::read(AppData::inventorySnapshotPath(), csvPath, &snapshot, nullptr)) {
+        resetRows(snapshot);
+        return replayJournal(errorMessage);
+    }
+
+    resetRows(ProductStore());
+    loading = true;
+    loader = new InventoryLoader(csvPath);
+
+    if (!background) {
+        // Same thread, so every signal is delivered before run() returns.
+        bool ok = false;
+        QString loadError;
+        connect(loader, &InventoryLoader::batchReady, this, &InventoryStore::appendBatch);
+        connect(loader, &InventoryLoader::progress, this, &InventoryStore::loadProgress);
+        connect(loader, &InventoryLoader::finished, this,
+                [&ok, &loadError](bool done, const QString &message) {
+            ok = done;
+            loadError = message;
+        });
+        loader->run();
+        delete loader;
+        loader = nullptr;
+        loading = false;
+        return completeLoad(ok, loadError, errorMessage);
+    }
+
+    loaderThread = new QThread(this);
+    loader->moveToThread(loaderThread);
+    connect(loaderThread, &QThread::started, loader, &InventoryLoader::run);
+    connect(loader, &InventoryLoader::batchReady, this, &InventoryStore::appendBatch);
+    connect(loader, &InventoryLoader::progress, this, &InventoryStore::loadProgress);
+    // Quit from the worker itself so the thread is done before finishLoading runs.
+    connect(loader, &InventoryLoader::finished,
+            loaderThread, &QThread::quit, Qt::DirectConnection);
+    connect(loader, &InventoryLoader::finished, this, &InventoryStore::finishLoading);
+    loaderThread->start();
+    return true;
+}
+
+void InventoryStore::cancelLoad()
+{
+    if (loader) {
+        loader->cancel();
+    }
+}
+
+void InventoryStore::stopLoader()
+{
+    // Cancel a running background load and free the worker.
+    if (!loaderThread) {
+        return;
+    }
+    loader->cancel();
+    loaderThread->quit();
+    loaderThread->wait();
+    delete loader;
+    loader = nullptr;
+    delete loaderThread;
+    loaderThread = nullptr;
+}
+
+void InventoryStore::finishLoading(bool ok, const QString &errorMessage)
+{
+    stopLoader();
+    loading = false;
+    QString error;
+    ok = completeLoad(ok, errorMessage, &error);
+    emit loadFinished(ok, error);
+}
+
+bool InventoryStore::completeLoad(bool ok, const QString &loadError, QString *errorMessage)
+{
+    // A failed or cancelled load holds only part of the CSV: nothing is
+    // cached, replayed or saved from it.
+    if (!ok) {
+        writable = false;
+        setError(errorMessage, loadError);
+        return false;
+    }
+    // Cache what was parsed so the next start can skip the CSV.
+    if (AppData::ensureDataDir()) {
+        InventorySnapshot::write(catalog, AppData::inventorySnapshotPath(),
+                                 AppData::inventoryFilePath(), nullptr);
+    }
+    return replayJournal(errorMessage);
+}
+
+bool InventoryStore::replayJournal(QString *errorMessage)
+{
+    // Re-apply edits made after the CSV was last written (e.g. before a crash).
+    // Without them the catalog is behind the files, so it must not be saved.
+    QVector<JournalEntry> entries;
+    if (!journal->open(AppData::inventoryFilePath(), &entries, errorMessage)) {
+        writable = false;
+        return false;
+    }
+    // Everything loaded so far matches the files on disk.
+    savedRevision = changes;
+    replaying = true;
+    for (const JournalEntry &entry : entries) {
+        applyJournalEntry(entry);
+    }
+    replaying = false;
+    return true;
+}
+
+void InventoryStore::applyJournalEntry(const JournalEntry &entry)
+{
+    // Entries are applied as upserts so replaying onto a newer CSV is harmless.
+    int row = catalog.findId(entry.key);
+    markDirty(entry.key);
+    switch (entry.op) {
+    case JournalEntry::Add:
+    case JournalEntry::Update:
+        if (row == -1) {
+            row = catalog.findId(entry.product.id);
+        }
+        if (row == -1) {
+            appendRow(entry.product);
+        } else {
+            updateRow(row, entry.product);
+        }
+        break;
+    case JournalEntry::Delete:
+        if (row != -1) {
+            removeRow(row);
+        }
+        break;
+    }
+}
+
+void InventoryStore::storeAdd(const Product &product)
+{
+    if (!backend) {
+        journalEdit(journal->logAdd(product));
+        return;
+    }
+    QString error;
+    storeResult(backend->addProduct(product, &error), error);
+}
+
+void InventoryStore::storeUpdate(const QString &oldId, const Product &product)
+{
+    if (!backend) {
+        journalEdit(journal->logUpdate(oldId, product));
+        return;
+    }
+    QString error;
+    storeResult(backend->updateProduct(oldId, product, &error), error);
+}
+
+void InventoryStore::storeDeletes(const QStringList &ids)
+{
+    if (!backend) {
+        journalEdit(ids.size() == 1 ? journal->logDelete(ids.first())
+                                    : journal->logDeletes(ids));
+        return;
+    }
+    QString error;
+    storeResult(ids.size() == 1 ? backend->removeProduct(ids.first(), &error)
+                                : backend->applyBatch(QVector<Product>(), ids, &error),
+                error);
+}
+
+void InventoryStore::storeBatch(const QVector<Product> &upserts, const QStringList &deletes)
+{
+    if (upserts.isEmpty() && deletes.isEmpty()) {
+        return;
+    }
+    if (!backend) {
+        if (!deletes.isEmpty()) {
+            journalEdit(journal->logDeletes(deletes));
+        }
+        if (!upserts.isEmpty()) {
+            journalEdit(journal->logUpserts(upserts));
+        }
+        return;
+    }
+    QString error;
+    storeResult(backend->applyBatch(upserts, deletes, &error), error);
+}
+
+void InventoryStore::storeResult(bool written, const QString &errorMessage)
+{
+    // Movements are written with the edit that made them.
+    flushMovements();
+    // The backend has no later save to fall back on, so a failure is final.
+    if (!written) {
+        emit warning("Could not store the change: " + errorMessage);
+    }
+    // Levels of renamed or deleted products follow right away too.
+    flushReorderLevels();
+}
+
+void InventoryStore::reportStored()
+{
+    // With a backend the edits are already on disk; report the burst the
+    // way a save would.
+    const int changed = dirtyIds.size();
+    savedRevision = changes;
+    dirtyIds.clear();
+    flushReorderLevels();
+    emit saveFinished(true, 0, changed, QString());
+}
+
+void InventoryStore::journalEdit(bool written)
+{
+    // Movements go out with the journal entry, so a crash loses neither.
+    flushMovements();
+    // Report the first failed append (not every one after it) and compact
+    // once the journal grows large.
+    const bool failed = !written && !journalFailing;
+    journalFailing = !written;
+    if (failed) {
+        emit warning("Could not record the change; it will be saved on close.");
+    }
+    if (!written) {
+        return;
+    }
+    if (journal->entryCount() >= kJournalCompactEntries) {
+        autosave();
+    }
+}
+
+void InventoryStore::markDirty(const QString &id)
+{
+    // The first edit of a burst arms the timer; later ones ride along.
+    dirtyIds.insert(id);
+    if (!autosaveTimer->isActive()) {
+        autosaveTimer->start();
+    }
+}
+
+bool InventoryStore::save(QString *errorMessage)
+{
+    Trace::Span span("InventoryStore::save");
+    // Never persist a half-loaded table; read-only stores never save.
+    if (!writable || loading) {
+        return true;
+    }
+
+    // Let a running autosave land first; then only write if something changed.
+    saver->waitForFinished();
+    autosaveTimer->stop();
+    if (changes == savedRevision) {
+        flushReorderLevels();
+        return true;
+    }
+    if (backend) {
+        reportStored();
+        return true;
+    }
+
+    QString error;
+    if (!beginSave(&error)) {
+        setError(errorMessage, error);
+        emit saveFinished(false, 0, 0, error);
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = InventorySaver::writeFiles(catalog, &error);
+    completeSave(ok, timer.elapsed(), error);
+    if (!ok) {
+        setError(errorMessage, error);
+    }
+    return ok;
+}
+
+void InventoryStore::autosave()
+{
+    if (!writable || loading || saver->isBusy()) {
+        return;
+    }
+    // Level changes alone do not touch the CSV.
+    if (changes == savedRevision) {
+        flushReorderLevels();
+        return;
+    }
+    if (backend) {
+        reportStored();
+        return;
+    }
+
+    QString error;
+    if (!beginSave(&error)) {
+        emit saveFinished(false, 0, 0, "Autosave failed: " + error);
+        return;
+    }
+    saver->start(catalog);
+}
+
+bool InventoryStore::beginSave(QString *errorMessage)
+{
+    // Edits from here on go to the journal's pending segment.
+    if (!journal->beginCheckpoint(errorMessage)) {
+        return false;
+    }
+    checkpointRevision = changes;
+    savingIds = dirtyIds;
+    dirtyIds.clear();
+    return true;
+}
+
+void InventoryStore::completeSave(bool ok, qint64 elapsedMs, const QString &errorMessage)
+{
+    QString journalError;
+    if (!journal->finishCheckpoint(AppData::inventoryFilePath(), ok, &journalError)) {
+        emit warning(journalError);
+    }
+
+    const int changed = savingIds.size();
+    if (!ok) {
+        // Keep the edits marked dirty; the journal still holds them.
+        dirtyIds.unite(savingIds);
+        savingIds.clear();
+        emit saveFinished(false, elapsedMs, changed, errorMessage.isEmpty()
+                                                         ? "Could not save inventory."
+                                                         : errorMessage);
+        return;
+    }
+
+    savedRevision = checkpointRevision;
+    savingIds.clear();
+    // Levels (set, or of renamed and deleted products) follow the CSV.
+    flushReorderLevels();
+    emit saveFinished(true, elapsedMs, changed, QString());
+
+    // Edits made during the save get their own round.
+    if (changes != savedRevision && !autosaveTimer->isActive()) {
+        autosaveTimer->start();
+    }
+}
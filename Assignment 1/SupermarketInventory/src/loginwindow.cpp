@@ -2,12 +2,15 @@
 #include "ui_loginwindow.h"
 #include "userstore.h"
 #include <QMessageBox>
+#include <QSharedPointer>
+#include <QThread>
 #include "mainwindow.h"
 #include "signupwindow.h"
 //constructor
 LoginWindow::LoginWindow(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::LoginWindow)
+    , verifying(false)
 {
     // Basic UI wiring for login.
     ui->setupUi(this);
@@ -34,6 +37,10 @@ LoginWindow::~LoginWindow()
 
 void LoginWindow::handleLogin()
 {
+    if (verifying) {
+        return;
+    }
+
     // Read user input.
     const QString u = ui->usernameInput->text().trimmed();
     const QString p = ui->passwordInput->text();
@@ -44,27 +51,56 @@ void LoginWindow::handleLogin()
         return;
     }
 
-    // Load users from whichever file exists.
-    QVector<UserStore::UserRecord> records;
-    QString pathUsed;
+    // Users come from the shared directory; users.csv is only re-read when it changed.
     QString loadError;
-    if (!UserStore::loadUsersIfExists(&records, &loadError, &pathUsed)) {
+    if (!UserStore::refresh(&loadError)) {
         QMessageBox::warning(this, "Error", loadError.isEmpty()
                                                ? "Could not open users file."
                                                : loadError);
         return;
     }
 
-    if (pathUsed.isEmpty()) {
+    if (!UserStore::hasUsers()) {
         QMessageBox::warning(this, "No Users",
                              "No users found. Please sign up first.");
         return;
     }
 
-    // Verify credentials.
-    bool isAdmin = false;
-    const bool found = UserStore::verifyUser(records, u, p, &isAdmin); //checks if the username and password match
+    // Hashing is slow by design, so verify on a worker and keep the dialog live.
+    struct Result {
+        bool found = false;
+        bool isAdmin = false;
+    };
+    QSharedPointer<Result> result(new Result);
+    QThread *worker = QThread::create([u, p, result]() {
+        result->found = UserStore::verifyUser(u, p, &result->isAdmin); //checks if the username and password match
+    });
+    connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &QThread::finished, this, [this, result]() {
+        setBusy(false);
+        finishLogin(result->found, result->isAdmin);
+    });
+    setBusy(true);
+    worker->start();
+}
+
+void LoginWindow::setBusy(bool busy)
+{
+    // Lock the form while a check is running.
+    verifying = busy;
+    ui->loginBtn->setEnabled(!busy);
+    ui->signupBtn->setEnabled(!busy);
+    ui->usernameInput->setReadOnly(busy);
+    ui->passwordInput->setReadOnly(busy);
+    if (busy) {
+        setCursor(Qt::BusyCursor);
+    } else {
+        unsetCursor();
+    }
+}
 
+void LoginWindow::finishLogin(bool found, bool isAdmin)
+{
     if (found) {
         MainWindow *mw = new MainWindow(isAdmin);
         mw->setAttribute(Qt::WA_DeleteOnClose);
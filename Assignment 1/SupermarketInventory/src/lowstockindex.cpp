@@ -0,0 +1,54 @@
+#include "lowstockindex.h"
+
+void LowStockIndex::clear()
+{
+    ordered.clear();
+    margins.clear();
+}
+
+void LowStockIndex::update(const QString &id, int quantity, int level)
+{
+    const qint64 margin = static_cast<qint64>(quantity) - level;
+    const auto existing = margins.constFind(id);
+    if (existing != margins.constEnd()) {
+        if (margin <= 0 && existing.value() == margin) {
+            return;
+        }
+        ordered.erase(std::make_pair(existing.value(), id));
+        margins.erase(existing);
+    }
+    if (margin <= 0) {
+        ordered.insert(std::make_pair(margin, id));
+        margins.insert(id, margin);
+    }
+}
+
+void LowStockIndex::remove(const QString &id)
+{
+    const auto existing = margins.constFind(id);
+    if (existing == margins.constEnd()) {
+        return;
+    }
+    ordered.erase(std::make_pair(existing.value(), id));
+    margins.erase(existing);
+}
+
+bool LowStockIndex::contains(const QString &id) const
+{
+    return margins.contains(id);
+}
+
+int LowStockIndex::size() const
+{
+    return margins.size();
+}
+
+QStringList LowStockIndex::ids() const
+{
+    QStringList out;
+    out.reserve(margins.size());
+    for (const auto &entry : ordered) {
+        out.push_back(entry.second);
+    }
+    return out;
+}
@@ -1,6 +1,17 @@
+#include "appdata.h"
 #include "loginwindow.h"
+#include "sqlitebackend.h"
+#include "trace.h"
+#include "userstore.h"
 #include <QApplication>
 #include <QCoreApplication>
+#include <QFileInfo>
+#include <QMessageBox>
+
+namespace {
+// Target time for one password hash on this machine.
+const int kPasswordBudgetMs = 150;
+}
 
 // Application entry point.
 int main(int argc, char *argv[])
@@ -11,10 +22,35 @@ int main(int argc, char *argv[])
     QCoreApplication::setOrganizationName("SupermarketInventory");
     QCoreApplication::setApplicationName("SupermarketInventory");
 
+    // SUPERMARKET_TRACE=1 records hot-path spans from startup (Tools menu
+    // otherwise); whatever is still recording is written out on exit.
+    Trace::setEnabled(qEnvironmentVariableIntValue("SUPERMARKET_TRACE") > 0);
+
+    // Pick the password work factor for this machine (a few ms).
+    UserStore::calibrateWorkFactor(kPasswordBudgetMs);
+
+    // Keep data in SQLite once asked to (--sqlite) or once the database
+    // exists; the first open imports the CSV files. Otherwise stay on CSV.
+    SqliteBackend database(AppData::databasePath());
+    if (a.arguments().contains("--sqlite") || QFileInfo::exists(AppData::databasePath())) {
+        QString error;
+        if (database.open(&error)) {
+            StorageBackend::setCurrent(&database);
+        } else {
+            QMessageBox::warning(nullptr, "Database",
+                                 error + "\nUsing the CSV files instead.");
+        }
+    }
+
     // Show the login window.
     LoginWindow w;
     w.show();
 
     // Start the Qt event loop.
-    return a.exec();
+    const int result = a.exec();
+    if (Trace::isEnabled() && AppData::ensureDataDir()) {
+        Trace::writeJson(Trace::defaultPath(), nullptr);
+    }
+    StorageBackend::setCurrent(nullptr);
+    return result;
 }
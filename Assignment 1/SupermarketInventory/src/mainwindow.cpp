@@ -1,34 +1,47 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 #include "appdata.h"
+#include "inventoryexporter.h"
+#include "inventorymodel.h"
+#include "inventoryfiltermodel.h"
+#include "inventoryimport.h"
+#include "inventorystore.h"
+#include "salesingest.h"
+#include "sharedcatalog.h"
+#include "storagebackend.h"
+#include "trace.h"
 #include <QFile>
-#include <QTextStream>
 #include <QApplication>
 #include <QMessageBox>
 #include <QHeaderView>
-#include <QSaveFile>
 #include <QFileDialog>
-#include <QFileInfo>
+#include <QCheckBox>
 #include <QDoubleValidator>
 #include <QIntValidator>
 #include <QAbstractItemView>
-#include <QBrush>
-#include <QColor>
-#include <QLocale>
+#include <QItemSelectionModel>
+#include <QAction>
+#include <QKeySequence>
+#include <QLabel>
+#include <QMenu>
+#include <QMenuBar>
 #include <QStandardPaths>
 #include <QDir>
 #include <QMouseEvent>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QStatusBar>
+#include <QTimer>
 #include <QEvent>
-#include <QStringList>
 #include <QtGlobal>
+#include <algorithm>
 #include "loginwindow.h"
 
 namespace {
-// Table layout and visual rules.
-enum Column { ColId = 0, ColName, ColPrice, ColQty, ColumnCount };
-const int kLowStockThreshold = 10;
-const QColor kLowStockColor(180, 60, 60);
-const QStringList kHeaders = {"ID", "Name", "Price", "Quantity"};
+// How long save reports stay in the status bar.
+const int kStatusTimeoutMs = 5000;
+// How often the till sales figures in the status bar are refreshed.
+const int kSalesStatusIntervalMs = 1000;
 }
 
 
@@ -44,8 +57,33 @@ MainWindow::MainWindow(bool isAdmin, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , admin(isAdmin)
+    , inventory(new InventoryStore(this))
+    , inventoryModel(new InventoryModel(inventory, this))
+    , filterModel(new InventoryFilterModel(this))
+    , loadProgress(nullptr)
+    , exporter(nullptr)
+    , exportProgress(nullptr)
+    , cancelExportBtn(nullptr)
+    , dashboardTimer(nullptr)
+    , catalogPublisher(nullptr)
+    , salesIngest(nullptr)
+    , salesStatus(nullptr)
+    , salesSeen(0)
 {
+    // Edits need an admin and the data folder to this process; another
+    // admin window or a batch job already writing it leaves this one
+    // read-only.
+    QString lockError;
+    inventory->setWritable(admin && AppData::lockDataDir(&lockError));
+    inventory->setBackend(StorageBackend::current());
+    if (inventory->isWritable()) {
+        catalogPublisher = new SharedCatalogPublisher;
+    }
     initUi();
+    if (admin && !inventory->isWritable()) {
+        QMessageBox::information(this, "Read-Only",
+                                 lockError + "\nChanges are disabled until it closes.");
+    }
     loadFromFile();
 }
 
@@ -56,7 +94,8 @@ MainWindow::MainWindow(bool isAdmin, QWidget *parent)
 
 MainWindow::~MainWindow()
 {
-    // Clean up the UI.
+    // The store (a child) stops its own load; just clean up the UI.
+    delete catalogPublisher;
     delete ui;
 }
 
@@ -69,6 +108,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 
 bool MainWindow::eventFilter(QObject *object, QEvent *event)
 {
+    Trace::Span span("MainWindow::eventFilter");
     Q_UNUSED(object);
     // When clicking outside the table, clear selection and input fields.
     if (event->type() == QEvent::MouseButtonPress) {
@@ -82,14 +122,14 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
         if (shouldIgnoreClear(clicked)) {
             return QMainWindow::eventFilter(object, event);
         }
-        const QPoint viewportPos = ui->tableWidget->viewport()->mapFromGlobal(globalPos);
-        const bool inViewport = ui->tableWidget->viewport()->rect().contains(viewportPos);
+        const QPoint viewportPos = ui->tableView->viewport()->mapFromGlobal(globalPos);
+        const bool inViewport = ui->tableView->viewport()->rect().contains(viewportPos);
 
         if (!inViewport) {
-            ui->tableWidget->clearSelection();
+            ui->tableView->clearSelection();
             clearInputs();
-        } else if (!ui->tableWidget->indexAt(viewportPos).isValid()) {
-            ui->tableWidget->clearSelection();
+        } else if (!ui->tableView->indexAt(viewportPos).isValid()) {
+            ui->tableView->clearSelection();
             clearInputs();
         }
     }
@@ -102,17 +142,19 @@ void MainWindow::initUi()
     // Build the main UI from the .ui file.
     ui->setupUi(this);
 
-    // ---- Table setup ----
-    ui->tableWidget->setRowCount(0);
-    ui->tableWidget->setColumnCount(ColumnCount);
-    ui->tableWidget->setHorizontalHeaderLabels(kHeaders);
-    ui->tableWidget->horizontalHeader()
+    // ---- Table setup (model -> filter -> view) ----
+    filterModel->setSourceModel(inventoryModel);
+    ui->tableView->setModel(filterModel);
+    ui->tableView->horizontalHeader()
         ->setSectionResizeMode(QHeaderView::Stretch);
-    ui->tableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-    ui->tableWidget->setSelectionMode(QAbstractItemView::SingleSelection);
-    ui->tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    ui->tableWidget->setAlternatingRowColors(true);
-    ui->tableWidget->verticalHeader()->setVisible(false);
+    ui->tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->tableView->setSelectionMode(QAbstractItemView::SingleSelection);
+    ui->tableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ui->tableView->setAlternatingRowColors(true);
+    ui->tableView->verticalHeader()->setVisible(false);
+    // Fixed row heights let the view skip measuring rows it never shows.
+    ui->tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    ui->tableView->setSortingEnabled(true);
     qApp->installEventFilter(this);
 
     // ---- Input validators ----
@@ -120,6 +162,7 @@ void MainWindow::initUi()
     priceValidator->setNotation(QDoubleValidator::StandardNotation);
     ui->priceInput->setValidator(priceValidator);
     ui->qtyInput->setValidator(new QIntValidator(0, 1000000, ui->qtyInput));
+    ui->reorderInput->setValidator(new QIntValidator(0, 1000000, ui->reorderInput));
     ui->idInput->setMaxLength(32);
     ui->nameInput->setMaxLength(64);
     ui->searchInput->setClearButtonEnabled(true);
@@ -137,28 +180,113 @@ void MainWindow::initUi()
     connect(ui->deleteBtn, &QPushButton::clicked,
             this, &MainWindow::deleteProduct);
 
-    connect(ui->tableWidget, &QTableWidget::itemSelectionChanged,
+    connect(ui->importBtn, &QPushButton::clicked,
+            this, &MainWindow::importProducts);
+
+    ui->undoBtn->setShortcut(QKeySequence::Undo);
+    ui->redoBtn->setShortcut(QKeySequence::Redo);
+    connect(ui->undoBtn, &QPushButton::clicked,
+            this, &MainWindow::undoEdit);
+    connect(ui->redoBtn, &QPushButton::clicked,
+            this, &MainWindow::redoEdit);
+    connect(inventory, &InventoryStore::historyChanged,
+            this, &MainWindow::updateHistoryButtons);
+
+    connect(ui->tableView->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &MainWindow::populateInputsFromSelection);
 
     connect(qApp, &QApplication::aboutToQuit,
             this, &MainWindow::saveToFile);
 
+    connect(inventory, &InventoryStore::loadProgress,
+            this, &MainWindow::updateLoadProgress);
+    connect(inventory, &InventoryStore::loadFinished,
+            this, &MainWindow::finishLoading);
+    connect(inventory, &InventoryStore::saveFinished,
+            this, &MainWindow::reportSave);
+    connect(inventory, &InventoryStore::warning,
+            this, &MainWindow::showWarning);
+
+    connect(ui->lowStockOnly, &QCheckBox::toggled,
+            this, &MainWindow::showLowStockOnly);
+
+    // ---- Dashboard (refreshed once per burst of edits) ----
+    dashboardTimer = new QTimer(this);
+    dashboardTimer->setSingleShot(true);
+    dashboardTimer->setInterval(0);
+    connect(dashboardTimer, &QTimer::timeout, this, &MainWindow::updateDashboard);
+    connect(inventory, &InventoryStore::rowsInserted, dashboardTimer, qOverload<>(&QTimer::start));
+    connect(inventory, &InventoryStore::rowsRemoved, dashboardTimer, qOverload<>(&QTimer::start));
+    connect(inventory, &InventoryStore::rowChanged, dashboardTimer, qOverload<>(&QTimer::start));
+    connect(inventory, &InventoryStore::resetDone, dashboardTimer, qOverload<>(&QTimer::start));
+    connect(inventory, &InventoryStore::rowsChanged, dashboardTimer, qOverload<>(&QTimer::start));
+    updateDashboard();
     connect(ui->exportBtn, &QPushButton::clicked,
             this, &MainWindow::exportReport);
     connect(ui->logoutBtn, &QPushButton::clicked,
             this, &MainWindow::logout);
 
-    // ---- Role-based UI lock ----
-    if (!admin) {
-        ui->addBtn->setEnabled(false);
-        ui->updateBtn->setEnabled(false);
-        ui->deleteBtn->setEnabled(false);
-        ui->idInput->setReadOnly(true);
-        ui->nameInput->setReadOnly(true);
-        ui->priceInput->setReadOnly(true);
-        ui->qtyInput->setReadOnly(true);
+    // ---- Load progress (shown only while the file streams in) ----
+    loadProgress = new QProgressBar(this);
+    loadProgress->setRange(0, 1000);
+    loadProgress->setMaximumWidth(200);
+    loadProgress->setFormat("Loading %p%");
+    loadProgress->hide();
+    ui->statusbar->addPermanentWidget(loadProgress);
+
+    // ---- Export progress (shown only while an export runs) ----
+    exporter = new InventoryExporter(this);
+    connect(exporter, &InventoryExporter::progress,
+            this, &MainWindow::updateExportProgress);
+    connect(exporter, &InventoryExporter::finished,
+            this, &MainWindow::finishExport);
+
+    exportProgress = new QProgressBar(this);
+    exportProgress->setRange(0, 1000);
+    exportProgress->setMaximumWidth(200);
+    exportProgress->setFormat("Exporting %p%");
+    exportProgress->hide();
+    ui->statusbar->addPermanentWidget(exportProgress);
+
+    cancelExportBtn = new QPushButton("Cancel", this);
+    cancelExportBtn->hide();
+    connect(cancelExportBtn, &QPushButton::clicked,
+            exporter, &InventoryExporter::cancel);
+    ui->statusbar->addPermanentWidget(cancelExportBtn);
+
+    // ---- Till sales (writable admins only; figures shown once tills report) ----
+    if (inventory->isWritable()) {
+        salesIngest = new SalesIngest(inventory, this);
+        salesStatus = new QLabel(this);
+        salesStatus->hide();
+        ui->statusbar->addPermanentWidget(salesStatus);
+        QString error;
+        if (!salesIngest->listen(SalesIngest::serverName(), &error)) {
+            statusBar()->showMessage(error, kStatusTimeoutMs);
+        }
+        // The selected product's stock follows sales unless it is being edited.
+        connect(inventory, &InventoryStore::rowsChanged, this, [this](const QVector<int> &rows) {
+            const int row = currentSourceRow();
+            if (row >= 0 && !ui->qtyInput->isModified() &&
+                std::binary_search(rows.begin(), rows.end(), row)) {
+                ui->qtyInput->setText(QString::number(inventory->products().quantity(row)));
+            }
+        });
+        auto *salesTimer = new QTimer(this);
+        salesTimer->setInterval(kSalesStatusIntervalMs);
+        connect(salesTimer, &QTimer::timeout, this, &MainWindow::updateSalesStatus);
+        salesTimer->start();
     }
 
+    // ---- Tracing (also started by SUPERMARKET_TRACE=1) ----
+    QAction *traceAction = ui->menubar->addMenu("Tools")->addAction("Record Trace");
+    traceAction->setCheckable(true);
+    traceAction->setChecked(Trace::isEnabled());
+    connect(traceAction, &QAction::toggled, this, &MainWindow::setTracing);
+
+    // ---- Role-based UI lock (also off while another process writes) ----
+    setWritesEnabled(inventory->isWritable());
+
     // ---- Simple dark theme ----
     this->setStyleSheet(
         "QMainWindow{background:#121212;}"
@@ -166,71 +294,51 @@ void MainWindow::initUi()
         "QPushButton{background:#1f1f1f;color:white;"
         "padding:8px;border-radius:8px;}"
         "QPushButton:hover{background:#333;}"
-        "QTableWidget{background:#1a1a1a;color:white;}"
+        "QTableView{background:#1a1a1a;color:white;}"
+        "QLabel{color:white;}"
         );
 }
 
-bool MainWindow::getInputValues(QString *id, QString *name, double *price, int *qty,
-                                QString *errorMessage) const
+bool MainWindow::readInputs(Product *product, QString *errorMessage) const
 {
-    // Pull raw text from inputs.
-    const QString rawId = ui->idInput->text().trimmed();
-    const QString rawName = ui->nameInput->text().trimmed();
-    const QString rawPrice = ui->priceInput->text().trimmed();
-    const QString rawQty = ui->qtyInput->text().trimmed();
-
-    // Basic required-field checks.
-    if (rawId.isEmpty() || rawName.isEmpty() || rawPrice.isEmpty() || rawQty.isEmpty()) {
-        if (errorMessage) {
-            *errorMessage = "All fields are required.";
-        }
-        return false;
-    }
-
-    // CSV safety checks (no commas/newlines in text fields).
-    if (rawId.contains(",") || rawName.contains(",") ||
-        rawId.contains("\n") || rawName.contains("\n")) {
-        if (errorMessage) {
-            *errorMessage = "Commas and newlines are not allowed in ID or name.";
-        }
-        return false;
-    }
-
-    bool priceOk = false;
-    bool qtyOk = false;
-    const double parsedPrice = QLocale::c().toDouble(rawPrice, &priceOk);
-    const int parsedQty = rawQty.toInt(&qtyOk);
+    // Validation lives in the store; the window only supplies the text.
+    return InventoryStore::parseProduct(ui->idInput->text(), ui->nameInput->text(),
+                                        ui->priceInput->text(), ui->qtyInput->text(),
+                                        product, errorMessage);
+}
 
-    // Numeric validation.
-    if (!priceOk || parsedPrice < 0.0) {
-        if (errorMessage) {
-            *errorMessage = "Price must be a valid non-negative number.";
-        }
-        return false;
+bool MainWindow::readReorderLevel(int *level, QString *errorMessage) const
+{
+    // Blank leaves the level as it is (the default for new products).
+    const QString text = ui->reorderInput->text().trimmed();
+    *level = -1;
+    if (text.isEmpty()) {
+        return true;
     }
-
-    if (!qtyOk || parsedQty < 0) {
-        if (errorMessage) {
-            *errorMessage = "Quantity must be a valid non-negative number.";
-        }
+    bool ok = false;
+    *level = text.toInt(&ok);
+    if (!ok || *level < 0) {
+        *errorMessage = "Reorder level must be a non-negative number.";
         return false;
     }
-
-    if (id) {
-        *id = rawId;
-    }
-    if (name) {
-        *name = rawName;
-    }
-    if (price) {
-        *price = parsedPrice;
-    }
-    if (qty) {
-        *qty = parsedQty;
-    }
     return true;
 }
 
+void MainWindow::setWritesEnabled(bool enabled)
+{
+    // Lock editing for normal users and while a load is in progress.
+    ui->addBtn->setEnabled(enabled);
+    ui->updateBtn->setEnabled(enabled);
+    ui->deleteBtn->setEnabled(enabled);
+    ui->importBtn->setEnabled(enabled);
+    updateHistoryButtons();
+    ui->idInput->setReadOnly(!enabled);
+    ui->nameInput->setReadOnly(!enabled);
+    ui->priceInput->setReadOnly(!enabled);
+    ui->qtyInput->setReadOnly(!enabled);
+    ui->reorderInput->setReadOnly(!enabled);
+}
+
 bool MainWindow::ensureAdmin(const QString &action)
 {
     // Guard all write operations for admins only.
@@ -243,86 +351,14 @@ bool MainWindow::ensureAdmin(const QString &action)
     return false;
 }
 
-QTableWidgetItem *MainWindow::ensureItem(int row, int column)
-{
-    // Ensure a cell exists so we can safely write text into it.
-    QTableWidgetItem *item = ui->tableWidget->item(row, column);
-    if (!item) {
-        item = new QTableWidgetItem();
-        ui->tableWidget->setItem(row, column, item);
-    }
-    return item;
-}
-
-void MainWindow::setRowValues(int row, const QString &id, const QString &name,
-                              const QString &priceText, int qty)
+int MainWindow::currentSourceRow() const
 {
-    // Write a full row in one place.
-    ensureItem(row, ColId)->setText(id);
-    ensureItem(row, ColName)->setText(name);
-    ensureItem(row, ColPrice)->setText(priceText);
-    ensureItem(row, ColQty)->setText(QString::number(qty));
-    applyStockStyle(row, qty);
-}
-
-bool MainWindow::rowToText(int row, QString *id, QString *name,
-                           QString *price, QString *qty) const
-{
-    // Read a full row; return false if any cell is missing.
-    QTableWidgetItem *idItem = ui->tableWidget->item(row, ColId);
-    QTableWidgetItem *nameItem = ui->tableWidget->item(row, ColName);
-    QTableWidgetItem *priceItem = ui->tableWidget->item(row, ColPrice);
-    QTableWidgetItem *qtyItem = ui->tableWidget->item(row, ColQty);
-
-    if (!idItem || !nameItem || !priceItem || !qtyItem) {
-        return false;
-    }
-
-    if (id) {
-        *id = idItem->text();
-    }
-    if (name) {
-        *name = nameItem->text();
-    }
-    if (price) {
-        *price = priceItem->text();
-    }
-    if (qty) {
-        *qty = qtyItem->text();
-    }
-    return true;
-}
-
-int MainWindow::findRowById(const QString &id, int excludeRow) const
-{
-    // Find a row by product ID (optionally skipping a row).
-    for (int i = 0; i < ui->tableWidget->rowCount(); ++i) {
-        if (i == excludeRow) {
-            continue;
-        }
-        QTableWidgetItem *item = ui->tableWidget->item(i, ColId);
-        if (item && item->text().trimmed() == id) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-void MainWindow::applyStockStyle(int row, int qty)
-{
-    // Highlight low stock rows in red.
-    const bool low = qty <= kLowStockThreshold;
-    for (int col = 0; col < ColumnCount; ++col) {
-        QTableWidgetItem *item = ui->tableWidget->item(row, col);
-        if (!item) {
-            continue;
-        }
-        if (low) {
-            item->setBackground(kLowStockColor);
-        } else {
-            item->setBackground(QBrush());
-        }
+    // Map the selected view row back to its product row.
+    const QModelIndexList selected = ui->tableView->selectionModel()->selectedRows();
+    if (selected.isEmpty()) {
+        return -1;
     }
+    return filterModel->storeRow(selected.first());
 }
 
 void MainWindow::clearInputs()
@@ -332,26 +368,24 @@ void MainWindow::clearInputs()
     ui->nameInput->clear();
     ui->priceInput->clear();
     ui->qtyInput->clear();
+    ui->reorderInput->clear();
 }
 
 void MainWindow::populateInputsFromSelection()
 {
     // When a row is selected, mirror its values into the inputs.
-    const int row = ui->tableWidget->currentRow();
+    const int row = currentSourceRow();
     if (row < 0) {
         clearInputs();
         return;
     }
 
-    QTableWidgetItem *idItem = ui->tableWidget->item(row, ColId);
-    QTableWidgetItem *nameItem = ui->tableWidget->item(row, ColName);
-    QTableWidgetItem *priceItem = ui->tableWidget->item(row, ColPrice);
-    QTableWidgetItem *qtyItem = ui->tableWidget->item(row, ColQty);
-
-    if (idItem) ui->idInput->setText(idItem->text());
-    if (nameItem) ui->nameInput->setText(nameItem->text());
-    if (priceItem) ui->priceInput->setText(priceItem->text());
-    if (qtyItem) ui->qtyInput->setText(qtyItem->text());
+    const ProductStore &store = inventory->products();
+    ui->idInput->setText(store.id(row));
+    ui->nameInput->setText(store.name(row));
+    ui->priceInput->setText(store.price(row).toString());
+    ui->qtyInput->setText(QString::number(store.quantity(row)));
+    ui->reorderInput->setText(QString::number(inventory->reorderLevel(row)));
 }
 
 bool MainWindow::shouldIgnoreClear(QWidget *clicked) const
@@ -360,12 +394,17 @@ bool MainWindow::shouldIgnoreClear(QWidget *clicked) const
     return clicked == ui->addBtn ||
            clicked == ui->updateBtn ||
            clicked == ui->deleteBtn ||
+           clicked == ui->importBtn ||
+           clicked == ui->undoBtn ||
+           clicked == ui->redoBtn ||
            clicked == ui->exportBtn ||
            clicked == ui->logoutBtn ||
            clicked == ui->idInput ||
            clicked == ui->nameInput ||
            clicked == ui->priceInput ||
-           clicked == ui->qtyInput;
+           clicked == ui->qtyInput ||
+           clicked == ui->reorderInput ||
+           clicked == ui->lowStockOnly;
 }
 
 void MainWindow::addProduct()
@@ -376,34 +415,22 @@ void MainWindow::addProduct()
     }
 
     QString error;
-    QString id;
-    QString name;
-    double price = 0.0;
-    int qty = 0;
-    if (!getInputValues(&id, &name, &price, &qty, &error)) {
+    Product product;
+    int level = -1;
+    if (!readInputs(&product, &error) || !readReorderLevel(&level, &error) ||
+        !inventory->add(product, &error)) {
         QMessageBox::warning(this, "Error", error);
         return;
     }
-
-    // Prevent duplicate IDs.
-    if (findRowById(id) != -1) {
-        QMessageBox::warning(this, "Error", "Product ID already exists.");
-        return;
+    if (level >= 0 && !inventory->setReorderLevel(inventory->find(product.id), level, &error)) {
+        QMessageBox::warning(this, "Error", error);
     }
 
-    const int row = ui->tableWidget->rowCount();
-    ui->tableWidget->insertRow(row);
-
-    const QString priceText = QLocale::c().toString(price, 'f', 2);
-    setRowValues(row, id, name, priceText, qty);
-
     clearInputs();
     searchProduct();
     ui->idInput->setFocus();
 }
 
-
-
 void MainWindow::updateProduct()
 {
     // Update the currently selected row.
@@ -411,29 +438,24 @@ void MainWindow::updateProduct()
         return;
     }
 
-    const int row = ui->tableWidget->currentRow();
+    const int row = currentSourceRow();
     if (row < 0) {
         QMessageBox::warning(this, "Error", "Select a product to update.");
         return;
     }
 
     QString error;
-    QString id;
-    QString name;
-    double price = 0.0;
-    int qty = 0;
-    if (!getInputValues(&id, &name, &price, &qty, &error)) {
+    Product product;
+    int level = -1;
+    if (!readInputs(&product, &error) || !readReorderLevel(&level, &error) ||
+        !inventory->update(row, product, &error)) {
         QMessageBox::warning(this, "Error", error);
         return;
     }
-
-    if (findRowById(id, row) != -1) {
-        QMessageBox::warning(this, "Error", "Product ID already exists.");
-        return;
+    if (level >= 0 && level != inventory->reorderLevel(row) &&
+        !inventory->setReorderLevel(row, level, &error)) {
+        QMessageBox::warning(this, "Error", error);
     }
-
-    const QString priceText = QLocale::c().toString(price, 'f', 2);
-    setRowValues(row, id, name, priceText, qty);
     searchProduct();
 }
 
@@ -444,7 +466,7 @@ void MainWindow::deleteProduct()
         return;
     }
 
-    const int row = ui->tableWidget->currentRow();
+    const int row = currentSourceRow();
     if (row < 0) {
         QMessageBox::warning(this, "Error", "Select a product to delete.");
         return;
@@ -457,207 +479,403 @@ void MainWindow::deleteProduct()
         return;
     }
 
-    ui->tableWidget->removeRow(row);
+    QString error;
+    if (!inventory->remove(row, &error)) {
+        QMessageBox::warning(this, "Error", error);
+        return;
+    }
     searchProduct();
 }
 
-
-void MainWindow::loadFromFile()
+void MainWindow::undoEdit()
 {
-    // Load inventory from AppData.
-    const QString pathToOpen = AppData::inventoryFilePath();
-
-    if (!QFileInfo::exists(pathToOpen)) {
+    if (!ensureAdmin("undo changes to")) {
         return;
     }
-
-    QFile file(pathToOpen);
-    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "Error", "Could not open inventory file.");
+    const QString label = inventory->undoText();
+    QString error;
+    if (!inventory->undo(&error)) {
+        QMessageBox::warning(this, "Error", error);
         return;
     }
+    clearInputs();
+    statusBar()->showMessage("Undid " + label, kStatusTimeoutMs);
+}
 
-    QTextStream in(&file);
-    ui->tableWidget->setSortingEnabled(false);
-    ui->tableWidget->setRowCount(0);
-
-    // Parse CSV rows.
-    while(!in.atEnd()) {
-        const QString line = in.readLine().trimmed();
-        if (line.isEmpty()) {
-            continue;
-        }
-
-        const QStringList data = line.split(",");
-        if (data.size() < 4) {
-            continue;
-        }
+void MainWindow::redoEdit()
+{
+    if (!ensureAdmin("redo changes to")) {
+        return;
+    }
+    const QString label = inventory->redoText();
+    QString error;
+    if (!inventory->redo(&error)) {
+        QMessageBox::warning(this, "Error", error);
+        return;
+    }
+    clearInputs();
+    statusBar()->showMessage("Redid " + label, kStatusTimeoutMs);
+}
 
-        const QString header = data[0].trimmed().toLower();
-        if (header == "id") {
-            continue;
-        }
+void MainWindow::updateHistoryButtons()
+{
+    // Follows the other write buttons (admins only, not while loading).
+    const bool enabled = ui->addBtn->isEnabled();
+    ui->undoBtn->setEnabled(enabled && inventory->canUndo());
+    ui->redoBtn->setEnabled(enabled && inventory->canRedo());
+    ui->undoBtn->setToolTip(inventory->canUndo() ? "Undo " + inventory->undoText() : QString());
+    ui->redoBtn->setToolTip(inventory->canRedo() ? "Redo " + inventory->redoText() : QString());
+}
 
-        const QString id = data[0].trimmed();
-        const QString name = data[1].trimmed();
-        const QString priceText = data[2].trimmed();
-        const QString qtyText = data[3].trimmed();
+void MainWindow::importProducts()
+{
+    Trace::Span span("MainWindow::importProducts");
+    // Bulk upsert from a supplier CSV: new IDs are added, known IDs updated.
+    if (!ensureAdmin("import")) {
+        return;
+    }
 
-        if (id.isEmpty() || name.isEmpty()) {
-            continue;
-        }
+    const QString path = QFileDialog::getOpenFileName(
+        this,
+        "Import Supplier File",
+        QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
+        "CSV Files (*.csv);;All Files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
 
-        if (findRowById(id) != -1) {
-            continue;
-        }
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    ImportResult result;
+    QString error;
+    int inserted = 0;
+    int updated = 0;
+    const bool ok = InventoryImport::parseFile(path, &result, &error) &&
+                    inventory->upsert(result.products, &inserted, &updated, &error);
+    QApplication::restoreOverrideCursor();
+    if (!ok) {
+        QMessageBox::warning(this, "Import Failed", error);
+        return;
+    }
 
-        bool priceOk = false;
-        bool qtyOk = false;
-        const double price = QLocale::c().toDouble(priceText, &priceOk);
-        const int qty = qtyText.toInt(&qtyOk);
-        if (!priceOk || !qtyOk) {
-            continue;
-        }
+    const QString summary = QString("Added %1 and updated %2 products from %3 lines.")
+                                .arg(inserted)
+                                .arg(updated)
+                                .arg(result.lines);
+    if (result.rejected.isEmpty()) {
+        QMessageBox::information(this, "Import Complete", summary);
+        return;
+    }
 
-        const int row = ui->tableWidget->rowCount();
-        ui->tableWidget->insertRow(row);
-        setRowValues(row, id, name,
-                     QLocale::c().toString(price, 'f', 2),
-                     qty);
+    // Offer the per-line rejection report instead of dropping bad rows silently.
+    const ImportRejection &first = result.rejected.first();
+    const auto reply = QMessageBox::question(
+        this,
+        "Import Complete",
+        QString("%1\n\n%2 lines were rejected (first: line %3, %4)\n\n"
+                "Save a rejection report?")
+            .arg(summary)
+            .arg(result.rejected.size())
+            .arg(first.line)
+            .arg(first.reason));
+    if (reply != QMessageBox::Yes) {
+        return;
     }
 
-    ui->tableWidget->setSortingEnabled(true);
-    file.close();
+    const QString reportPath = QFileDialog::getSaveFileName(
+        this,
+        "Save Rejection Report",
+        path + ".rejected.csv",
+        "CSV Files (*.csv)");
+    if (!reportPath.isEmpty() &&
+        !InventoryImport::writeRejections(result.rejected, reportPath, &error)) {
+        QMessageBox::warning(this, "Error", error);
+    }
 }
 
-void MainWindow::saveToFile()
+void MainWindow::loadFromFile()
 {
-    // Only admins can persist inventory.
-    if(!admin) return;
-
-    // Ensure AppData directory exists.
-    QString dirError;
-    if (!AppData::ensureDataDir(&dirError)) {
+    Trace::Span span("MainWindow::loadFromFile");
+    // Load inventory from AppData on a worker thread; rows stream in.
+    QString error;
+    if (!inventory->load(true, &error)) {
+        setWritesEnabled(inventory->isWritable());
+        QMessageBox::warning(this, "Error", error);
         return;
     }
-
-    // Write CSV to the primary inventory file.
-    QSaveFile file(AppData::inventoryFilePath());
-    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    if (!inventory->isLoading()) {
+        publishCatalog();
         return;
     }
 
-    QTextStream out(&file);
-    out << "id,name,price,quantity\n";
+    setWritesEnabled(false);
+    loadProgress->setValue(0);
+    loadProgress->show();
+}
 
-    for(int i = 0; i < ui->tableWidget->rowCount(); i++)
-    {
-        QString id;
-        QString name;
-        QString price;
-        QString qty;
-        if (!rowToText(i, &id, &name, &price, &qty)) {
-            continue;
-        }
+void MainWindow::updateLoadProgress(qint64 bytesRead, qint64 bytesTotal)
+{
+    if (bytesTotal <= 0) {
+        return;
+    }
+    loadProgress->setValue(static_cast<int>(bytesRead * 1000 / bytesTotal));
+}
 
-        id = id.trimmed();
-        name = name.trimmed();
-        price = price.trimmed();
-        qty = qty.trimmed();
+void MainWindow::finishLoading(bool ok, const QString &errorMessage)
+{
+    loadProgress->hide();
+    // A failed load leaves the store read-only; the buttons follow it.
+    setWritesEnabled(inventory->isWritable());
+    if (!ok) {
+        QMessageBox::warning(this, "Error", errorMessage);
+        return;
+    }
+    publishCatalog();
+}
 
-        if (id.isEmpty() || name.isEmpty()) {
-            continue;
-        }
+void MainWindow::publishCatalog()
+{
+    Trace::Span span("MainWindow::publishCatalog");
+    // Admins share each saved state with till processes on this machine.
+    if (!catalogPublisher) {
+        return;
+    }
+    // The copy is cheap; building the shared segment runs on a worker. A
+    // failure shows up when the next state is published.
+    const QString error = catalogPublisher->lastError();
+    if (!error.isEmpty()) {
+        statusBar()->showMessage("Warning: " + error, kStatusTimeoutMs);
+    }
+    catalogPublisher->publishInBackground(inventory->products());
+}
 
-        out << id << "," << name << ","
-            << price << "," << qty << "\n";
+void MainWindow::saveToFile()
+{
+    Trace::Span span("MainWindow::saveToFile");
+    // Final saves (close/logout) run inline so they finish before we exit;
+    // only a failure here asks the user to look.
+    QString error;
+    if (!inventory->save(&error)) {
+        QMessageBox::warning(this, "Save Failed", error);
     }
+}
 
-    file.commit();
+void MainWindow::reportSave(bool ok, qint64 elapsedMs, int changed, const QString &errorMessage)
+{
+    // Store signals can arrive mid-edit or mid-batch, so they never open a
+    // dialog (its event loop would run more store work underneath).
+    if (!ok) {
+        statusBar()->showMessage("Save failed: " + errorMessage);
+        return;
+    }
+    statusBar()->showMessage(QString("Saved %1 products (%2 changed) in %3 ms")
+                                 .arg(inventory->size())
+                                 .arg(changed)
+                                 .arg(elapsedMs),
+                             kStatusTimeoutMs);
+    publishCatalog();
 }
 
+void MainWindow::showWarning(const QString &message)
+{
+    // Stays up until the next message; the store sends each problem once.
+    statusBar()->showMessage("Warning: " + message);
+}
 
 void MainWindow::searchProduct()
 {
-    // Filter rows based on search text.
-    const QString text = ui->searchInput->text().trimmed().toLower();
-    const bool hasFilter = !text.isEmpty();
-
-    for(int i = 0; i < ui->tableWidget->rowCount(); i++)
-    {
-        bool match = !hasFilter;
-
-        if (hasFilter) {
-            for(int j = 0; j < ColumnCount; j++)
-            {
-                QTableWidgetItem *item = ui->tableWidget->item(i,j);
-                if(item && item->text().toLower().contains(text)) {
-                    match = true;
-                    break;
-                }
-            }
+    Trace::Span span("MainWindow::searchProduct");
+    // Filter rows based on search text (the proxy only re-runs on change).
+    filterModel->setSearchText(ui->searchInput->text());
+    dashboardTimer->start();
+}
+void MainWindow::updateDashboard()
+{
+    Trace::Span span("MainWindow::updateDashboard");
+    // Whole catalog: O(1) running totals. A filtered view only sums the rows
+    // it shows (the low-stock view straight from its index).
+    InventoryTotals shown;
+    const bool filtered =
+        !filterModel->searchText().isEmpty() || inventoryModel->lowStockOnly();
+    if (!filtered) {
+        shown = inventory->totals();
+    } else if (filterModel->searchText().isEmpty()) {
+        shown = inventory->totals(inventory->lowStockRows());
+    } else {
+        QVector<int> rows;
+        rows.reserve(filterModel->rowCount());
+        for (int row = 0; row < filterModel->rowCount(); ++row) {
+            rows.push_back(filterModel->storeRow(filterModel->index(row, 0)));
         }
+        shown = inventory->totals(rows);
+    }
 
-        ui->tableWidget->setRowHidden(i, !match);
+    ui->productsLabel->setText(filtered
+        ? QString("Products: %1 of %2").arg(shown.products).arg(inventory->size())
+        : QString("Products: %1").arg(shown.products));
+    ui->unitsLabel->setText(QString("Units: %1").arg(shown.units));
+    ui->valueLabel->setText("Stock value: " + Money::fromCents(shown.valueCents).toString());
+    ui->lowStockLabel->setText(QString("Low stock: %1").arg(shown.lowStock));
+}
+
+void MainWindow::showLowStockOnly(bool enabled)
+{
+    inventoryModel->setLowStockOnly(enabled);
+    dashboardTimer->start();
+    if (enabled) {
+        statusBar()->showMessage(QString("%1 products at or below their reorder level")
+                                     .arg(inventory->lowStockCount()),
+                                 kStatusTimeoutMs);
     }
 }
+
 void MainWindow::exportReport()
 {
-    // Export a human-readable report to a user-selected file.
-    if (ui->tableWidget->rowCount() == 0) {
+    Trace::Span span("MainWindow::exportReport");
+    // Export the catalog (or the rows currently shown) on a worker thread.
+    if (exporter->isBusy()) {
+        return;
+    }
+    const ProductStore &store = inventory->products();
+    if (store.isEmpty()) {
         QMessageBox::information(this, "No Data", "There are no products to export.");
         return;
     }
 
+    // A filtered view can be exported as shown, in the table's sort order.
+    QVector<int> rows;
+    if (filterModel->rowCount() < store.size()) {
+        const auto choice = QMessageBox::question(
+            this, "Export",
+            QString("Export only the %1 products shown?\n"
+                    "Choose No to export all %2 products.")
+                .arg(filterModel->rowCount())
+                .arg(store.size()),
+            QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+        if (choice == QMessageBox::Cancel) {
+            return;
+        }
+        if (choice == QMessageBox::Yes) {
+            if (filterModel->rowCount() == 0) {
+                QMessageBox::information(this, "No Data", "There are no products to export.");
+                return;
+            }
+            // The low-stock view only holds its k rows, so this is O(k) too.
+            rows.reserve(filterModel->rowCount());
+            for (int row = 0; row < filterModel->rowCount(); ++row) {
+                rows.push_back(filterModel->storeRow(filterModel->index(row, 0)));
+            }
+        }
+    }
+
     const QString defaultDir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
     const QString defaultPath = defaultDir.isEmpty()
-        ? QString("inventory_report.txt")
-        : defaultDir + QDir::separator() + "inventory_report.txt";
-
+        ? QString("inventory_export.csv")
+        : defaultDir + QDir::separator() + "inventory_export.csv";
+
+    const QString csvFilter = "CSV (*.csv)";
+    const QString jsonFilter = "JSON Lines (*.jsonl)";
+    const QString binaryFilter = "Binary (*.bin)";
+    const QString reportFilter = "Text Report (*.txt)";
+    QString selectedFilter = csvFilter;
     const QString path = QFileDialog::getSaveFileName(
         this,
-        "Export Report",
+        "Export",
         defaultPath,
-        "Text Files (*.txt)");
+        QStringList{csvFilter, jsonFilter, binaryFilter, reportFilter}.join(";;"),
+        &selectedFilter);
 
     if (path.isEmpty()) {
         return;
     }
 
-    QSaveFile file(path);
-    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
-    {
-        QMessageBox::warning(this,
-                             "Error",
-                             "Could not create report file!");
-        return;
+    InventoryExporter::Format format = InventoryExporter::Csv;
+    if (selectedFilter == jsonFilter) {
+        format = InventoryExporter::JsonLines;
+    } else if (selectedFilter == binaryFilter) {
+        format = InventoryExporter::Binary;
+    } else if (selectedFilter == reportFilter) {
+        format = InventoryExporter::Report;
     }
 
-    QTextStream out(&file);
+    exportProgress->setValue(0);
+    exportProgress->show();
+    cancelExportBtn->show();
+    ui->exportBtn->setEnabled(false);
+    exporter->start(store, rows, format, path);
+}
 
-    out << "SUPERMARKET INVENTORY REPORT\n\n";
+void MainWindow::updateExportProgress(qint64 done, qint64 total)
+{
+    if (total <= 0) {
+        return;
+    }
+    exportProgress->setValue(static_cast<int>(done * 1000 / total));
+}
 
-    for(int i=0;i<ui->tableWidget->rowCount();i++)
-    {
-        QString id;
-        QString name;
-        QString price;
-        QString qty;
-        if (!rowToText(i, &id, &name, &price, &qty)) {
-            continue;
-        }
+void MainWindow::finishExport(bool ok, bool cancelled, qint64 rows, const QString &errorMessage)
+{
+    exportProgress->hide();
+    cancelExportBtn->hide();
+    ui->exportBtn->setEnabled(true);
+    if (cancelled) {
+        statusBar()->showMessage("Export cancelled", kStatusTimeoutMs);
+        return;
+    }
+    if (!ok) {
+        QMessageBox::warning(this, "Export Failed", errorMessage);
+        return;
+    }
+    statusBar()->showMessage(QString("Exported %1 products").arg(rows), kStatusTimeoutMs);
+}
 
-        out << "ID: " << id << "\n";
-        out << "Name: " << name << "\n";
-        out << "Price: " << price << "\n";
-        out << "Qty: " << qty << "\n\n";
+void MainWindow::updateSalesStatus()
+{
+    // Sales applied per second, queue fill, and how often tills had to wait.
+    const SalesMetrics metrics = salesIngest->metrics();
+    if (metrics.received == 0 && metrics.refused == 0) {
+        return;
     }
+    const quint64 perSecond = (metrics.applied - salesSeen) * 1000 / kSalesStatusIntervalMs;
+    salesSeen = metrics.applied;
+    salesStatus->setText(QString("Sales %1/s, queue %2%, waits %3")
+                             .arg(perSecond)
+                             .arg(metrics.depth * 100 / metrics.capacity)
+                             .arg(metrics.stalls + metrics.refused));
+    salesStatus->setToolTip(QString("Received %1, applied %2 as %3 row updates\n"
+                                    "Unknown IDs %4, stopped at zero %5, unreadable %6\n"
+                                    "Queue peak %7 of %8, refused %9\n"
+                                    "Last batch %10 us, %11 ms behind the tills")
+                                .arg(metrics.received)
+                                .arg(metrics.applied)
+                                .arg(metrics.rowsWritten)
+                                .arg(metrics.unknownIds)
+                                .arg(metrics.clamped)
+                                .arg(metrics.malformed)
+                                .arg(metrics.maxDepth)
+                                .arg(metrics.capacity)
+                                .arg(metrics.refused)
+                                .arg(metrics.lastBatchUs)
+                                .arg(metrics.lagMs));
+    salesStatus->show();
+}
 
-    file.commit();
+void MainWindow::setTracing(bool enabled)
+{
+    if (enabled) {
+        Trace::setEnabled(true);
+        statusBar()->showMessage("Recording trace", kStatusTimeoutMs);
+        return;
+    }
 
-    QMessageBox::information(this,
-                             "Export Successful",
-                             "Report exported successfully!");
+    // Stopping writes what was recorded so it can be opened in a trace viewer.
+    Trace::setEnabled(false);
+    const QString path = Trace::defaultPath();
+    QString error;
+    if (!AppData::ensureDataDir(&error) || !Trace::writeJson(path, &error)) {
+        QMessageBox::warning(this, "Trace Failed", error);
+        return;
+    }
+    statusBar()->showMessage("Trace written to " + QDir::toNativeSeparators(path));
 }
 
 void MainWindow::logout()
@@ -0,0 +1,115 @@
+#include "money.h"
+
+namespace {
+// Integer digits accepted by parse; keeps every amount well inside qint64.
+const int kMaxWholeDigits = 15;
+
+template <typename Char>
+bool parseDecimal(const Char *text, int size, qint64 *cents)
+{
+    // Callers hand in untrimmed fields, so skip surrounding spaces.
+    int begin = 0;
+    int end = size;
+    while (begin < end && (text[begin] == ' ' || text[begin] == '\t')) {
+        ++begin;
+    }
+    while (end > begin && (text[end - 1] == ' ' || text[end - 1] == '\t' ||
+                           text[end - 1] == '\r' || text[end - 1] == '\n')) {
+        --end;
+    }
+
+    bool negative = false;
+    if (begin < end && (text[begin] == '-' || text[begin] == '+')) {
+        negative = text[begin] == '-';
+        ++begin;
+    }
+
+    qint64 whole = 0;
+    int wholeDigits = 0;
+    while (begin < end && text[begin] >= '0' && text[begin] <= '9') {
+        if (++wholeDigits > kMaxWholeDigits) {
+            return false;
+        }
+        whole = whole * 10 + (text[begin] - '0');
+        ++begin;
+    }
+
+    qint64 fraction = 0;
+    int fractionDigits = 0;
+    bool roundUp = false;
+    if (begin < end && text[begin] == '.') {
+        ++begin;
+        while (begin < end && text[begin] >= '0' && text[begin] <= '9') {
+            if (fractionDigits < 2) {
+                fraction = fraction * 10 + (text[begin] - '0');
+            } else if (fractionDigits == 2) {
+                roundUp = text[begin] >= '5';
+            }
+            ++fractionDigits;
+            ++begin;
+        }
+    }
+    if (begin != end || wholeDigits + fractionDigits == 0) {
+        return false;
+    }
+
+    for (int i = fractionDigits; i < 2; ++i) {
+        fraction *= 10;
+    }
+    const qint64 magnitude = whole * 100 + fraction + (roundUp ? 1 : 0);
+    *cents = negative ? -magnitude : magnitude;
+    return true;
+}
+}
+
+Money Money::fromCents(qint64 cents)
+{
+    Money money;
+    money.value = cents;
+    return money;
+}
+
+bool Money::parse(const QString &text, Money *out)
+{
+    qint64 cents = 0;
+    if (!parseDecimal(reinterpret_cast<const char16_t *>(text.utf16()), text.size(), &cents)) {
+        return false;
+    }
+    *out = fromCents(cents);
+    return true;
+}
+
+bool Money::parse(const QByteArray &text, Money *out)
+{
+    qint64 cents = 0;
+    if (!parseDecimal(text.constData(), text.size(), &cents)) {
+        return false;
+    }
+    *out = fromCents(cents);
+    return true;
+}
+
+qint64 Money::cents() const
+{
+    return value;
+}
+
+QString Money::toString() const
+{
+    return QString::fromLatin1(toLatin1());
+}
+
+QByteArray Money::toLatin1() const
+{
+    // Built by hand: this runs for every row of every save and export.
+    const quint64 magnitude = value < 0 ? 0 - quint64(value) : quint64(value);
+    QByteArray out;
+    if (value < 0) {
+        out += '-';
+    }
+    out += QByteArray::number(magnitude / 100);
+    out += '.';
+    out += char('0' + magnitude % 100 / 10);
+    out += char('0' + magnitude % 10);
+    return out;
+}
@@ -0,0 +1,249 @@
+#include "productsorter.h"
+
+#include "parallel.h"
+#include "productstore.h"
+#include "trace.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+// Orders kept at once (e.g. both directions of two columns).
+const int kCachedOrders = 4;
+// Rows per sort thread; smaller catalogs are sorted on the calling thread.
+const long long kRowsPerSortThread = 32768;
+// Changed rows a cached order takes in place; more and it is re-sorted.
+const int kIncrementalRows = 32;
+
+// Strict weak order of two store rows under a key list.
+class RowLess
+{
+public:
+    RowLess(const ProductStore &store, const QVector<SortKey> &keys)
+        : store(store)
+        , keys(keys)
+    {
+    }
+
+    bool operator()(int a, int b) const
+    {
+        for (const SortKey &key : keys) {
+            const int order = compare(key.column, a, b);
+            if (order != 0) {
+                return key.descending ? order > 0 : order < 0;
+            }
+        }
+        return a < b;
+    }
+
+private:
+    int compare(SortKey::Column column, int a, int b) const
+    {
+        switch (column) {
+        case SortKey::Id:
+            return store.compareIds(a, b);
+        case SortKey::Name:
+            return store.compareNames(a, b);
+        case SortKey::Price: {
+            const qint64 x = store.price(a).cents();
+            const qint64 y = store.price(b).cents();
+            return x < y ? -1 : (y < x ? 1 : 0);
+        }
+        case SortKey::Quantity: {
+            const int x = store.quantity(a);
+            const int y = store.quantity(b);
+            return x < y ? -1 : (y < x ? 1 : 0);
+        }
+        }
+        return 0;
+    }
+
+    const ProductStore &store;
+    const QVector<SortKey> &keys;
+};
+
+// Sort runs of the range on separate threads, then merge neighbouring runs
+// pairwise (each round in parallel) until one run is left.
+void parallelSort(int *rows, long long count, const RowLess &less)
+{
+    const int runs = Parallel::threadCount(count, kRowsPerSortThread);
+    const long long step = (count + runs - 1) / std::max(1, runs);
+    Parallel::forChunks(runs, 1, [&](long long begin, long long end, int) {
+        for (long long run = begin; run < end; ++run) {
+            const long long first = std::min(count, run * step);
+            std::sort(rows + first, rows + std::min(count, first + step), less);
+        }
+    });
+    for (long long width = step; width < count; width *= 2) {
+        const long long pairs = (count + 2 * width - 1) / (2 * width);
+        Parallel::forChunks(pairs, 1, [&](long long begin, long long end, int) {
+            for (long long pair = begin; pair < end; ++pair) {
+                const long long first = pair * 2 * width;
+                const long long middle = std::min(count, first + width);
+                const long long last = std::min(count, first + 2 * width);
+                std::inplace_merge(rows + first, rows + middle, rows + last, less);
+            }
+        });
+    }
+}
+}
+
+const QVector<int> &ProductSorter::rows(const ProductStore &store,
+                                        const QVector<SortKey> &keys) const
+{
+    return entry(store, keys).rows;
+}
+
+int ProductSorter::position(const ProductStore &store, const QVector<SortKey> &keys,
+                            int row) const
+{
+    return entry(store, keys).positions.at(row);
+}
+
+ProductSorter::Entry &ProductSorter::entry(const ProductStore &store,
+                                           const QVector<SortKey> &keys) const
+{
+    for (Entry &entry : entries) {
+        if (entry.keys == keys) {
+            entry.used = ++clock;
+            return entry;
+        }
+    }
+
+    // Build the order and replace the least recently used one.
+    Trace::Span span("ProductSorter::build");
+    Entry built;
+    built.keys = keys;
+    built.used = ++clock;
+    built.rows.resize(store.size());
+    std::iota(built.rows.begin(), built.rows.end(), 0);
+    parallelSort(built.rows.data(), built.rows.size(), RowLess(store, keys));
+    built.positions.resize(store.size());
+    reindex(&built, 0, built.rows.size() - 1);
+    if (entries.size() < kCachedOrders) {
+        entries.push_back(built);
+        return entries.last();
+    }
+    auto oldest = std::min_element(entries.begin(), entries.end(),
+                                   [](const Entry &a, const Entry &b) { return a.used < b.used; });
+    *oldest = built;
+    return *oldest;
+}
+
+void ProductSorter::reindex(Entry *entry, int first, int last)
+{
+    const int *order = entry->rows.constData();
+    int *positions = entry->positions.data();
+    for (int at = first; at <= last; ++at) {
+        positions[order[at]] = at;
+    }
+}
+
+void ProductSorter::sortRows(const ProductStore &store, const QVector<SortKey> &keys,
+                             QVector<int> *rows)
+{
+    std::sort(rows->begin(), rows->end(), RowLess(store, keys));
+}
+
+void ProductSorter::rowInserted(const ProductStore &store, int row)
+{
+    for (Entry &entry : entries) {
+        // Later rows moved down by one, then the new row goes in its place.
+        for (int &value : entry.rows) {
+            if (value >= row) {
+                ++value;
+            }
+        }
+        const int at = std::lower_bound(entry.rows.begin(), entry.rows.end(), row,
+                                        RowLess(store, entry.keys)) - entry.rows.begin();
+        entry.rows.insert(at, row);
+        entry.positions.insert(row, at);
+        reindex(&entry, at, entry.rows.size() - 1);
+    }
+}
+
+void ProductSorter::rowsAppended(const ProductStore &store, int first)
+{
+    // Sort just the new rows and merge them in; existing rows keep their order.
+    for (Entry &entry : entries) {
+        const int existing = entry.rows.size();
+        entry.rows.resize(store.size());
+        std::iota(entry.rows.begin() + existing, entry.rows.end(), first);
+        const RowLess less(store, entry.keys);
+        parallelSort(entry.rows.data() + existing, entry.rows.size() - existing, less);
+        std::inplace_merge(entry.rows.begin(), entry.rows.begin() + existing,
+                           entry.rows.end(), less);
+        entry.positions.resize(store.size());
+        reindex(&entry, 0, entry.rows.size() - 1);
+    }
+}
+
+void ProductSorter::rowChanged(const ProductStore &store, int row)
+{
+    for (Entry &entry : entries) {
+        const RowLess less(store, entry.keys);
+        const int from = entry.positions.at(row);
+        // Most edits leave the row between the same neighbours.
+        const int last = entry.rows.size() - 1;
+        if ((from == 0 || less(entry.rows.at(from - 1), row)) &&
+            (from == last || less(row, entry.rows.at(from + 1)))) {
+            continue;
+        }
+        entry.rows.remove(from);
+        const int to = std::lower_bound(entry.rows.begin(), entry.rows.end(), row, less) -
+                       entry.rows.begin();
+        entry.rows.insert(to, row);
+        // Only rows between the old and new place changed position.
+        reindex(&entry, std::min(from, to), std::max(from, to));
+    }
+}
+
+void ProductSorter::rowsChanged(const ProductStore &store, const QVector<int> &rows,
+                                SortKey::Column column)
+{
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        Entry &entry = entries[i];
+        const bool affected = std::any_of(entry.keys.begin(), entry.keys.end(),
+                                          [column](const SortKey &key) {
+            return key.column == column;
+        });
+        if (!affected) {
+            continue;
+        }
+        if (rows.size() > kIncrementalRows) {
+            entries.remove(i);
+            continue;
+        }
+        // Take every changed row out first, so the binary searches below
+        // run over rows that are still in order.
+        const auto kept = std::remove_if(entry.rows.begin(), entry.rows.end(), [&rows](int row) {
+            return std::binary_search(rows.begin(), rows.end(), row);
+        });
+        entry.rows.erase(kept, entry.rows.end());
+        const RowLess less(store, entry.keys);
+        for (int row : rows) {
+            const auto at = std::lower_bound(entry.rows.begin(), entry.rows.end(), row, less);
+            entry.rows.insert(at - entry.rows.begin(), row);
+        }
+        reindex(&entry, 0, entry.rows.size() - 1);
+    }
+}
+
+void ProductSorter::rowRemoved(int row)
+{
+    for (Entry &entry : entries) {
+        const int from = entry.positions.at(row);
+        entry.rows.remove(from);
+        entry.positions.remove(row);
+        for (int &value : entry.rows) {
+            if (value > row) {
+                --value;
+            }
+        }
+        reindex(&entry, from, entry.rows.size() - 1);
+    }
+}
+
+void ProductSorter::clear()
+{
+    entries.clear();
+}
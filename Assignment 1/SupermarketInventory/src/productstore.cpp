@@ -0,0 +1,226 @@
+#include "productstore.h"
+
+int ProductStore::size() const
+{
+    return ids.size();
+}
+
+bool ProductStore::isEmpty() const
+{
+    return ids.isEmpty();
+}
+
+void ProductStore::clear()
+{
+    ids.clear();
+    names.clear();
+    prices.clear();
+    quantities.clear();
+    idPool.clear();
+    namePool.clear();
+    idRows.clear();
+}
+
+void ProductStore::reserve(int rows)
+{
+    // Pre-size every column so bulk loads do not reallocate per row.
+    ids.reserve(rows);
+    names.reserve(rows);
+    prices.reserve(rows);
+    quantities.reserve(rows);
+    idRows.reserve(rows);
+}
+
+QString ProductStore::id(int row) const
+{
+    const QString ref = idRef(row);
+    return QString(ref.constData(), ref.size());
+}
+
+QString ProductStore::name(int row) const
+{
+    const QString ref = nameRef(row);
+    return QString(ref.constData(), ref.size());
+}
+
+Money ProductStore::price(int row) const
+{
+    return Money::fromCents(prices.at(row));
+}
+
+int ProductStore::quantity(int row) const
+{
+    return quantities.at(row);
+}
+
+Product ProductStore::product(int row) const
+{
+    Product product;
+    product.id = id(row);
+    product.name = name(row);
+    product.price = price(row);
+    product.quantity = quantity(row);
+    return product;
+}
+
+int ProductStore::findId(const QString &id) const
+{
+    const int handle = idPool.find(id);
+    return handle < 0 ? -1 : idRows.at(handle);
+}
+
+int ProductStore::compareIds(int a, int b) const
+{
+    return idPool.compare(ids.at(a), ids.at(b));
+}
+
+int ProductStore::compareNames(int a, int b) const
+{
+    return namePool.compare(names.at(a), names.at(b));
+}
+
+quint32 ProductStore::nameHandle(int row) const
+{
+    return names.at(row);
+}
+
+QString ProductStore::idRef(int row) const
+{
+    return idPool.text(ids.at(row));
+}
+
+QString ProductStore::nameRef(int row) const
+{
+    return namePool.text(names.at(row));
+}
+
+int ProductStore::append(const Product &product)
+{
+    // Add a row to the end of every column.
+    const int row = ids.size();
+    ids.push_back(idPool.intern(product.id));
+    names.push_back(namePool.intern(product.name));
+    prices.push_back(product.price.cents());
+    quantities.push_back(product.quantity);
+    setIdRow(ids.last(), row);
+    return row;
+}
+
+void ProductStore::update(int row, const Product &product)
+{
+    // Intern the new text before releasing the old, so an unchanged string
+    // keeps its handle.
+    const quint32 oldId = ids.at(row);
+    const quint32 oldName = names.at(row);
+    ids[row] = idPool.intern(product.id);
+    names[row] = namePool.intern(product.name);
+    idPool.release(oldId);
+    namePool.release(oldName);
+    prices[row] = product.price.cents();
+    quantities[row] = product.quantity;
+    setIdRow(ids.at(row), row);
+}
+
+void ProductStore::setQuantity(int row, int quantity)
+{
+    quantities[row] = quantity;
+}
+
+void ProductStore::remove(int row)
+{
+    idPool.release(ids.at(row));
+    namePool.release(names.at(row));
+    ids.remove(row);
+    names.remove(row);
+    prices.remove(row);
+    quantities.remove(row);
+
+    // Rows after the removed one moved up by one.
+    for (int &value : idRows) {
+        if (value > row) {
+            --value;
+        }
+    }
+}
+
+void ProductStore::insert(int row, const Product &product)
+{
+    if (row >= ids.size()) {
+        append(product);
+        return;
+    }
+
+    // Rows from here on move down by one.
+    for (int &value : idRows) {
+        if (value >= row) {
+            ++value;
+        }
+    }
+    ids.insert(row, idPool.intern(product.id));
+    names.insert(row, namePool.intern(product.name));
+    prices.insert(row, product.price.cents());
+    quantities.insert(row, product.quantity);
+    setIdRow(ids.at(row), row);
+}
+
+void ProductStore::truncate(int rows)
+{
+    // No earlier row changes number, so the ID rows stay as they are.
+    if (rows >= ids.size()) {
+        return;
+    }
+    for (int row = ids.size() - 1; row >= rows; --row) {
+        idPool.release(ids.at(row));
+        namePool.release(names.at(row));
+    }
+    ids.resize(rows);
+    names.resize(rows);
+    prices.resize(rows);
+    quantities.resize(rows);
+}
+
+void ProductStore::compact()
+{
+    idPool.compact();
+    namePool.compact();
+}
+
+bool ProductStore::assign(const qint64 *priceColumn, const qint32 *quantityColumn,
+                          const quint32 *idSlices, const quint32 *nameSlices,
+                          int rows, const QString &heap)
+{
+    clear();
+    const quint64 heapSize = static_cast<quint64>(heap.size());
+    for (int row = 0; row < rows; ++row) {
+        const quint64 idEnd = quint64(idSlices[row * 2]) + idSlices[row * 2 + 1];
+        const quint64 nameEnd = quint64(nameSlices[row * 2]) + nameSlices[row * 2 + 1];
+        if (idEnd > heapSize || nameEnd > heapSize) {
+            return false;
+        }
+    }
+
+    // Numbers are copied wholesale; text is interned slice by slice.
+    prices = QVector<qint64>(priceColumn, priceColumn + rows);
+    quantities = QVector<int>(quantityColumn, quantityColumn + rows);
+    ids.reserve(rows);
+    names.reserve(rows);
+    idRows.reserve(rows);
+    auto slice = [&heap](const quint32 *slices, int row) {
+        return QString::fromRawData(heap.constData() + slices[row * 2],
+                                    static_cast<int>(slices[row * 2 + 1]));
+    };
+    for (int row = 0; row < rows; ++row) {
+        ids.push_back(idPool.intern(slice(idSlices, row)));
+        names.push_back(namePool.intern(slice(nameSlices, row)));
+        setIdRow(ids.last(), row);
+    }
+    return true;
+}
+
+void ProductStore::setIdRow(quint32 handle, int row)
+{
+    if (handle >= static_cast<quint32>(idRows.size())) {
+        idRows.resize(static_cast<int>(handle) + 1);
+    }
+    idRows[handle] = row;
+}
@@ -0,0 +1,231 @@
+#include "salesingest.h"
+
+#include "inventorystore.h"
+#include "trace.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <limits>
+
+namespace {
+// Events the queue holds before pushes are refused.
+const int kQueueCapacity = 65536;
+// How often queued sales are applied (a few frames; views refresh once).
+const int kDrainIntervalMs = 50;
+// Most events taken per batch, so one batch never stalls the window.
+const int kMaxBatchEvents = 65536;
+// Pause of a till connection waiting for room in the queue.
+const int kStallWaitMs = 1;
+// How long to wait when checking whether another process owns the socket.
+const int kProbeTimeoutMs = 200;
+
+// "id,delta[,timestamp]"; a missing timestamp means now.
+bool parseSale(const QByteArray &line, SaleEvent *event)
+{
+    const QList<QByteArray> fields = line.split(',');
+    if (fields.size() < 2 || fields.size() > 3) {
+        return false;
+    }
+    bool ok = false;
+    event->productId = QString::fromUtf8(fields.at(0).trimmed());
+    event->delta = fields.at(1).trimmed().toInt(&ok);
+    if (!ok || event->productId.isEmpty()) {
+        return false;
+    }
+    event->timestamp = fields.size() == 3 ? fields.at(2).trimmed().toLongLong(&ok)
+                                          : QDateTime::currentMSecsSinceEpoch();
+    return ok && event->timestamp > 0;
+}
+}
+
+SalesIngest::SalesIngest(InventoryStore *store, QObject *parent)
+    : QObject(parent)
+    , store(store)
+    , queue(kQueueCapacity)
+    , drainTimer(new QTimer(this))
+    , listenerThread(nullptr)
+    , server(nullptr)
+{
+    drainTimer->setInterval(kDrainIntervalMs);
+    connect(drainTimer, &QTimer::timeout, this, &SalesIngest::drain);
+    drainTimer->start();
+}
+
+SalesIngest::~SalesIngest()
+{
+    stopListening();
+}
+
+bool SalesIngest::push(const SaleEvent &event)
+{
+    if (enqueue(event)) {
+        return true;
+    }
+    ++refused;
+    return false;
+}
+
+bool SalesIngest::enqueue(const SaleEvent &event)
+{
+    if (!queue.push(event)) {
+        return false;
+    }
+    ++received;
+    const int depth = queue.size();
+    int seen = maxDepth.load(std::memory_order_relaxed);
+    while (depth > seen && !maxDepth.compare_exchange_weak(seen, depth)) {
+    }
+    return true;
+}
+
+bool SalesIngest::listen(const QString &name, QString *errorMessage)
+{
+    stopListening();
+    stopping = false;
+    listenerThread = new QThread(this);
+    server = new QLocalServer;
+    server->moveToThread(listenerThread);
+    connect(listenerThread, &QThread::finished, server, &QObject::deleteLater);
+    listenerThread->start();
+
+    // Sockets are created and read on the listener thread.
+    QString error;
+    bool ok = false;
+    QMetaObject::invokeMethod(server, [this, name, &error]() {
+        // A socket file left by a crash is taken over; a live owner is not.
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(kProbeTimeoutMs)) {
+            error = "Another window is already receiving sales.";
+            return false;
+        }
+        QLocalServer::removeServer(name);
+        connect(server, &QLocalServer::newConnection, server, [this]() { acceptTills(); });
+        if (!server->listen(name)) {
+            error = server->errorString();
+            return false;
+        }
+        return true;
+    }, Qt::BlockingQueuedConnection, &ok);
+
+    if (!ok) {
+        stopListening();
+        if (errorMessage) {
+            *errorMessage = "Could not receive sales: " + error;
+        }
+    }
+    return ok;
+}
+
+void SalesIngest::stopListening()
+{
+    if (!listenerThread) {
+        return;
+    }
+    // Wakes a connection waiting for room; the server goes with the thread.
+    stopping = true;
+    listenerThread->quit();
+    listenerThread->wait();
+    delete listenerThread;
+    listenerThread = nullptr;
+    server = nullptr;
+}
+
+QString SalesIngest::serverName()
+{
+    return "SupermarketInventory-sales";
+}
+
+SalesMetrics SalesIngest::metrics() const
+{
+    SalesMetrics out = totals;
+    out.received = received.load(std::memory_order_relaxed);
+    out.refused = refused.load(std::memory_order_relaxed);
+    out.malformed = malformed.load(std::memory_order_relaxed);
+    out.stalls = stalls.load(std::memory_order_relaxed);
+    out.depth = queue.size();
+    out.maxDepth = maxDepth.load(std::memory_order_relaxed);
+    out.capacity = queue.capacity();
+    return out;
+}
+
+void SalesIngest::acceptTills()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, socket, [this, socket]() { readSales(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void SalesIngest::readSales(QLocalSocket *socket)
+{
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        SaleEvent event;
+        if (!parseSale(line, &event)) {
+            ++malformed;
+            continue;
+        }
+        if (enqueue(event)) {
+            continue;
+        }
+        // Full: stop reading until the store catches up. Unread lines stay
+        // in the socket, so the tills' writes block rather than get lost.
+        ++stalls;
+        while (!enqueue(event)) {
+            if (stopping) {
+                return;
+            }
+            QThread::msleep(kStallWaitMs);
+        }
+    }
+}
+
+void SalesIngest::drain()
+{
+    // Sales wait in the queue while the inventory loads or is read-only.
+    if (store->isLoading() || !store->isWritable()) {
+        return;
+    }
+    Trace::Span span("SalesIngest::drain");
+    QElapsedTimer timer;
+    timer.start();
+
+    // The store turns many sales of the same product into one row write and
+    // keeps each sale's till timestamp for the stock history.
+    // A sale stamped in the future (a till with a wrong clock or unit) is
+    // taken as made now: a product's history never goes back in time, so
+    // it would otherwise push every later movement of that product forward.
+    QVector<SaleEvent> sales;
+    qint64 oldest = std::numeric_limits<qint64>::max();
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    SaleEvent event;
+    while (sales.size() < kMaxBatchEvents && queue.pop(&event)) {
+        event.timestamp = qMin(event.timestamp, now);
+        oldest = qMin(oldest, event.timestamp);
+        sales.push_back(event);
+    }
+    const int events = sales.size();
+    if (events == 0) {
+        return;
+    }
+
+    // Cannot fail: the checks above are the store's own.
+    StockDeltaResult result;
+    store->applyStockDeltas(sales, &result, nullptr);
+    totals.applied += events;
+    totals.rowsWritten += result.applied;
+    totals.unknownIds += result.unknown;
+    totals.clamped += result.clamped;
+    totals.lastBatchUs = timer.nsecsElapsed() / 1000;
+    totals.lagMs = qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - oldest);
+    emit batchApplied();
+}
@@ -0,0 +1,76 @@
+#include "salesqueue.h"
+
+#include <utility>
+
+SalesQueue::SalesQueue(int capacity)
+{
+    quint64 size = 2;
+    while (size < static_cast<quint64>(capacity)) {
+        size *= 2;
+    }
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+    // Slot i is free for the push at position i.
+    for (quint64 i = 0; i < size; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool SalesQueue::push(const SaleEvent &event)
+{
+    quint64 position = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = slots[position & mask];
+        const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        const qint64 lag = static_cast<qint64>(sequence - position);
+        if (lag == 0) {
+            // The slot is free; claim the position, then fill and publish it.
+            if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                slot.event = event;
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            // Still holds an event from one lap ago: full.
+            return false;
+        } else {
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool SalesQueue::pop(SaleEvent *event)
+{
+    quint64 position = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = slots[position & mask];
+        const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        const qint64 lag = static_cast<qint64>(sequence - (position + 1));
+        if (lag == 0) {
+            // Published; claim it, take the event and free the slot for the
+            // push one lap later.
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                *event = std::move(slot.event);
+                slot.event = SaleEvent();
+                slot.sequence.store(position + mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            return false;
+        } else {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+int SalesQueue::capacity() const
+{
+    return static_cast<int>(mask + 1);
+}
+
+int SalesQueue::size() const
+{
+    const quint64 pushed = tail.load(std::memory_order_relaxed);
+    const quint64 popped = head.load(std::memory_order_relaxed);
+    return pushed > popped ? static_cast<int>(pushed - popped) : 0;
+}
@@ -0,0 +1,269 @@
+#include "scanbuffer.h"
+
+#include "parallel.h"
+#include "productstore.h"
+#include "scankernel.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace {
+// Rows per scan thread; smaller catalogs are scanned on the calling thread.
+const long long kRowsPerScanThread = 16384;
+// Rows kept on the side before the buffer is rebuilt instead.
+const int kMaxMovedRows = 4096;
+
+void appendField(QVector<char16_t> *text, const QString &field)
+{
+    const QString folded = field.toCaseFolded();
+    const char16_t *units = reinterpret_cast<const char16_t *>(folded.utf16());
+    for (int i = 0; i < folded.size(); ++i) {
+        text->push_back(units[i]);
+    }
+    // Needles never contain NUL, so matches cannot span two fields.
+    text->push_back(u'\0');
+}
+
+// One row laid out as in the buffer.
+QString foldedRow(const ProductStore &store, int row)
+{
+    const QChar end(u'\0');
+    return store.id(row).toCaseFolded() + end + store.name(row).toCaseFolded() + end +
+           store.price(row).toString().toCaseFolded() + end +
+           QString::number(store.quantity(row)) + end;
+}
+}
+
+void ScanBuffer::invalidate()
+{
+    current = false;
+    text.clear();
+    rowStarts.clear();
+    movedRows.clear();
+    blankUnits = 0;
+}
+
+void ScanBuffer::insertRow(const ProductStore &store, int row)
+{
+    if (!current) {
+        return;
+    }
+    if (row == rowStarts.size() - 1) {
+        appendFolded(store, row);
+        return;
+    }
+    if (movedRows.size() >= kMaxMovedRows) {
+        invalidate();
+        return;
+    }
+    // A row put back in the middle (undoing a delete) gets an empty slot;
+    // equal starts still map every match to the row that holds it.
+    rowStarts.insert(row, rowStarts.at(row));
+    shiftMoved(row, 1);
+    movedRows.insert(row, foldedRow(store, row));
+}
+
+void ScanBuffer::updateRow(const ProductStore &store, int row)
+{
+    if (!current) {
+        return;
+    }
+    const QString folded = foldedRow(store, row);
+    auto moved = movedRows.find(row);
+    if (moved != movedRows.end()) {
+        moved.value() = folded;
+        return;
+    }
+    if (!writeSlot(row, folded)) {
+        moveAside(row, folded);
+    }
+}
+
+void ScanBuffer::updateQuantity(const ProductStore &store, int row)
+{
+    if (!current) {
+        return;
+    }
+    if (movedRows.contains(row)) {
+        movedRows.insert(row, foldedRow(store, row));
+        return;
+    }
+    const QString quantity = QString::number(store.quantity(row));
+
+    // The quantity slot follows the ID, name and price (which hold no NUL)
+    // and runs up to the row's final NUL, padding included.
+    qint64 begin = rowStarts.at(row);
+    for (int field = 0; field < 3; ++field) {
+        while (text.at(begin) != u'\0') {
+            ++begin;
+        }
+        ++begin;
+    }
+    const qint64 end = rowStarts.at(row + 1) - 1;
+    const qint64 width = end - begin;
+    const char16_t *units = reinterpret_cast<const char16_t *>(quantity.utf16());
+    if (quantity.size() <= width) {
+        // Needles never contain NUL, so the padding never matches.
+        char16_t *slot = text.data() + begin;
+        std::fill(std::copy(units, units + quantity.size(), slot), slot + width, u'\0');
+        return;
+    }
+    moveAside(row, foldedRow(store, row));
+}
+
+void ScanBuffer::removeRow(int row)
+{
+    if (!current) {
+        return;
+    }
+    // Blank the slot and let the row before absorb it (a leading one
+    // belongs to no row); a row already on the side has a blank slot.
+    const qint64 begin = rowStarts.at(row);
+    const qint64 end = rowStarts.at(row + 1);
+    if (movedRows.remove(row) == 0) {
+        std::fill(text.data() + begin, text.data() + end, u'\0');
+        blankUnits += end - begin;
+    }
+    rowStarts.remove(row);
+    shiftMoved(row + 1, -1);
+    dropIfSparse();
+}
+
+void ScanBuffer::truncate(int rows)
+{
+    if (!current) {
+        return;
+    }
+    text.resize(static_cast<int>(rowStarts.at(rows)));
+    rowStarts.resize(rows + 1);
+    auto it = movedRows.begin();
+    while (it != movedRows.end()) {
+        if (it.key() >= rows) {
+            it = movedRows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    blankUnits = qMin<qint64>(blankUnits, text.size());
+}
+
+bool ScanBuffer::writeSlot(int row, const QString &folded)
+{
+    const qint64 begin = rowStarts.at(row);
+    const qint64 width = rowStarts.at(row + 1) - begin;
+    if (folded.size() > width) {
+        return false;
+    }
+    // Needles never contain NUL, so the padding never matches.
+    const char16_t *units = reinterpret_cast<const char16_t *>(folded.utf16());
+    char16_t *slot = text.data() + begin;
+    std::fill(std::copy(units, units + folded.size(), slot), slot + width, u'\0');
+    return true;
+}
+
+void ScanBuffer::moveAside(int row, const QString &folded)
+{
+    if (movedRows.size() >= kMaxMovedRows) {
+        invalidate();
+        return;
+    }
+    const qint64 begin = rowStarts.at(row);
+    const qint64 end = rowStarts.at(row + 1);
+    std::fill(text.data() + begin, text.data() + end, u'\0');
+    blankUnits += end - begin;
+    movedRows.insert(row, folded);
+    dropIfSparse();
+}
+
+void ScanBuffer::shiftMoved(int row, int shift)
+{
+    if (movedRows.isEmpty()) {
+        return;
+    }
+    QHash<int, QString> shifted;
+    shifted.reserve(movedRows.size());
+    for (auto it = movedRows.constBegin(); it != movedRows.constEnd(); ++it) {
+        shifted.insert(it.key() >= row ? it.key() + shift : it.key(), it.value());
+    }
+    movedRows.swap(shifted);
+}
+
+void ScanBuffer::dropIfSparse()
+{
+    if (blankUnits * 2 > text.size()) {
+        invalidate();
+    }
+}
+
+void ScanBuffer::scan(const QString &needle, const ProductStore &store, QBitArray *rows) const
+{
+    Trace::Span span("ScanBuffer::scan");
+    if (!current) {
+        rebuild(store);
+    }
+    *rows = QBitArray(store.size());
+    const QString folded = needle.toCaseFolded();
+    if (folded.isEmpty()) {
+        rows->fill(true);
+        return;
+    }
+
+    // Each thread scans a contiguous run of rows and collects its hits; the
+    // bitmap is filled afterwards since neighbouring bits share bytes.
+    const char16_t *units = reinterpret_cast<const char16_t *>(folded.utf16());
+    const int needleSize = folded.size();
+    const char16_t *data = text.constData();
+    const qint64 *starts = rowStarts.constData();
+    const long long count = store.size();
+    QVector<QVector<int>> hits(Parallel::threadCount(count, kRowsPerScanThread));
+    QVector<int> *perChunk = hits.data();
+    Parallel::forChunks(count, kRowsPerScanThread,
+                        [&](long long begin, long long end, int chunk) {
+        QVector<int> &found = perChunk[chunk];
+        qint64 at = starts[begin];
+        const qint64 stop = starts[end];
+        while (at < stop) {
+            const qint64 offset = ScanKernel::find(data + at, stop - at, units, needleSize);
+            if (offset < 0) {
+                break;
+            }
+            // Find the row holding the match, then resume at the next row.
+            const qint64 *next = std::upper_bound(starts + begin, starts + end + 1, at + offset);
+            const int row = static_cast<int>(next - starts) - 1;
+            found.push_back(row);
+            at = *next;
+        }
+    });
+
+    for (const QVector<int> &found : hits) {
+        for (int row : found) {
+            rows->setBit(row);
+        }
+    }
+    for (auto it = movedRows.constBegin(); it != movedRows.constEnd(); ++it) {
+        if (it.value().contains(folded)) {
+            rows->setBit(it.key());
+        }
+    }
+}
+
+void ScanBuffer::rebuild(const ProductStore &store) const
+{
+    Trace::Span span("ScanBuffer::rebuild");
+    text.clear();
+    rowStarts.clear();
+    rowStarts.reserve(store.size() + 1);
+    rowStarts.push_back(0);
+    for (int row = 0; row < store.size(); ++row) {
+        appendFolded(store, row);
+    }
+    current = true;
+}
+
+void ScanBuffer::appendFolded(const ProductStore &store, int row) const
+{
+    appendField(&text, store.id(row));
+    appendField(&text, store.name(row));
+    appendField(&text, store.price(row).toString());
+    appendField(&text, QString::number(store.quantity(row)));
+    rowStarts.push_back(text.size());
+}
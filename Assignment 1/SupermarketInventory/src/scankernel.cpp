@@ -0,0 +1,226 @@
+#include "scankernel.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCAN_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 is part of the x86-64 baseline; AVX2 is compiled per function and
+// only called after a runtime CPU check.
+#if defined(SCAN_KERNEL_X86) && (defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SCAN_KERNEL_SSE2 1
+#endif
+
+#if defined(SCAN_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_KERNEL_AVX2 1
+#define SCAN_KERNEL_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(SCAN_KERNEL_X86) && defined(_MSC_VER)
+#define SCAN_KERNEL_AVX2 1
+#define SCAN_KERNEL_AVX2_TARGET
+#endif
+
+namespace {
+
+using FindFn = qint64 (*)(const char16_t *, qint64, const char16_t *, int);
+
+bool matchesAt(const char16_t *text, const char16_t *needle, int needleSize)
+{
+    return std::memcmp(text, needle, sizeof(char16_t) * needleSize) == 0;
+}
+
+qint64 findScalar(const char16_t *text, qint64 size, const char16_t *needle, int needleSize)
+{
+    const char16_t first = needle[0];
+    for (qint64 i = 0; i + needleSize <= size; ++i) {
+        if (text[i] == first && matchesAt(text + i, needle, needleSize)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if defined(SCAN_KERNEL_SSE2) || defined(SCAN_KERNEL_AVX2)
+int lowestBit(unsigned mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Candidate starts have the needle's first unit at i and its last unit at
+// i + n - 1; both are compared a vector at a time and only positions where
+// both hit are verified. movemask yields two bits per 16-bit lane.
+qint64 verifyMask(unsigned mask, qint64 base, const char16_t *text,
+                  const char16_t *needle, int needleSize)
+{
+    while (mask) {
+        const int bit = lowestBit(mask);
+        const qint64 pos = base + bit / 2;
+        if (matchesAt(text + pos, needle, needleSize)) {
+            return pos;
+        }
+        mask &= ~(3u << bit);
+    }
+    return -1;
+}
+#endif
+
+#ifdef SCAN_KERNEL_SSE2
+qint64 findSse2(const char16_t *text, qint64 size, const char16_t *needle, int needleSize)
+{
+    const qint64 starts = size - needleSize + 1;
+    const __m128i first = _mm_set1_epi16(static_cast<short>(needle[0]));
+    const __m128i last = _mm_set1_epi16(static_cast<short>(needle[needleSize - 1]));
+    qint64 i = 0;
+    for (; i + 8 <= starts; i += 8) {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        const __m128i tail = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(text + i + needleSize - 1));
+        const __m128i hits = _mm_and_si128(_mm_cmpeq_epi16(head, first),
+                                           _mm_cmpeq_epi16(tail, last));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask) {
+            const qint64 pos = verifyMask(mask, i, text, needle, needleSize);
+            if (pos >= 0) {
+                return pos;
+            }
+        }
+    }
+    const qint64 rest = findScalar(text + i, size - i, needle, needleSize);
+    return rest < 0 ? -1 : i + rest;
+}
+#endif
+
+#ifdef SCAN_KERNEL_AVX2
+SCAN_KERNEL_AVX2_TARGET
+qint64 findAvx2(const char16_t *text, qint64 size, const char16_t *needle, int needleSize)
+{
+    const qint64 starts = size - needleSize + 1;
+    const __m256i first = _mm256_set1_epi16(static_cast<short>(needle[0]));
+    const __m256i last = _mm256_set1_epi16(static_cast<short>(needle[needleSize - 1]));
+    qint64 i = 0;
+    for (; i + 16 <= starts; i += 16) {
+        const __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        const __m256i tail = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(text + i + needleSize - 1));
+        const __m256i hits = _mm256_and_si256(_mm256_cmpeq_epi16(head, first),
+                                              _mm256_cmpeq_epi16(tail, last));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask) {
+            const qint64 pos = verifyMask(mask, i, text, needle, needleSize);
+            if (pos >= 0) {
+                return pos;
+            }
+        }
+    }
+    const qint64 rest = findScalar(text + i, size - i, needle, needleSize);
+    return rest < 0 ? -1 : i + rest;
+}
+
+bool cpuHasAvx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4] = {0, 0, 0, 0};
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+
+struct Dispatch {
+    FindFn find;
+    const char *name;
+};
+
+Dispatch pickImplementation()
+{
+#ifdef SCAN_KERNEL_AVX2
+    if (cpuHasAvx2()) {
+        return {findAvx2, "avx2"};
+    }
+#endif
+#ifdef SCAN_KERNEL_SSE2
+    return {findSse2, "sse2"};
+#else
+    return {findScalar, "scalar"};
+#endif
+}
+
+const Dispatch &dispatch()
+{
+    static const Dispatch chosen = pickImplementation();
+    return chosen;
+}
+
+FindFn implementationFn(ScanKernel::Implementation implementation)
+{
+    switch (implementation) {
+    case ScanKernel::Scalar:
+        return findScalar;
+    case ScanKernel::Sse2:
+#ifdef SCAN_KERNEL_SSE2
+        return findSse2;
+#else
+        return nullptr;
+#endif
+    case ScanKernel::Avx2:
+#ifdef SCAN_KERNEL_AVX2
+        return cpuHasAvx2() ? findAvx2 : nullptr;
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+}
+
+namespace ScanKernel {
+
+qint64 find(const char16_t *text, qint64 size, const char16_t *needle, int needleSize)
+{
+    if (needleSize <= 0 || size < needleSize) {
+        return needleSize <= 0 ? 0 : -1;
+    }
+    return dispatch().find(text, size, needle, needleSize);
+}
+
+const char *implementation()
+{
+    return dispatch().name;
+}
+
+bool isAvailable(Implementation implementation)
+{
+    return implementationFn(implementation) != nullptr;
+}
+
+qint64 findWith(Implementation implementation, const char16_t *text, qint64 size,
+                const char16_t *needle, int needleSize)
+{
+    if (needleSize <= 0 || size < needleSize) {
+        return needleSize <= 0 ? 0 : -1;
+    }
+    return implementationFn(implementation)(text, size, needle, needleSize);
+}
+
+}
@@ -0,0 +1,196 @@
+#include "searchindex.h"
+
+#include "productstore.h"
+#include "trace.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Pack three UTF-16 units into one key.
+quint64 trigramKey(const QChar *text)
+{
+    return (quint64(text[0].unicode()) << 32) |
+           (quint64(text[1].unicode()) << 16) |
+           quint64(text[2].unicode());
+}
+
+void appendTrigrams(const QString &folded, QVector<quint64> *keys)
+{
+    for (int i = 0; i + SearchIndex::kMinNeedle <= folded.size(); ++i) {
+        keys->push_back(trigramKey(folded.constData() + i));
+    }
+}
+
+bool containsFolded(const QString &text, const QString &needle)
+{
+    return text.contains(needle, Qt::CaseInsensitive);
+}
+
+}
+
+void SearchIndex::clear()
+{
+    postings.clear();
+    serialOfRow.clear();
+    rowOfSerial.clear();
+    freeSerials.clear();
+}
+
+void SearchIndex::rebuild(const ProductStore &store)
+{
+    Trace::Span span("SearchIndex::rebuild");
+    // Serials restart at zero so the serial -> row table stays compact.
+    clear();
+    serialOfRow.reserve(store.size());
+    rowOfSerial.reserve(store.size());
+    for (int row = 0; row < store.size(); ++row) {
+        insertRow(row, store.idRef(row), store.nameRef(row));
+    }
+}
+
+void SearchIndex::insertRow(int row, const QString &id, const QString &name)
+{
+    // Fresh serials are the largest, so their postings append; a reused one
+    // is inserted in place.
+    quint32 serial;
+    if (!freeSerials.isEmpty()) {
+        serial = freeSerials.takeLast();
+        rowOfSerial[serial] = row;
+    } else {
+        serial = static_cast<quint32>(rowOfSerial.size());
+        rowOfSerial.push_back(row);
+    }
+    serialOfRow.insert(row, serial);
+    for (int r = row + 1; r < serialOfRow.size(); ++r) {
+        rowOfSerial[serialOfRow.at(r)] = r;
+    }
+    addPostings(serial, trigrams(id, name));
+}
+
+void SearchIndex::updateRow(int row, const QString &oldId, const QString &oldName,
+                            const QString &id, const QString &name)
+{
+    const QVector<quint64> before = trigrams(oldId, oldName);
+    const QVector<quint64> after = trigrams(id, name);
+    if (before == after) {
+        return;
+    }
+
+    // Only touch the trigrams that actually changed.
+    QVector<quint64> removed;
+    QVector<quint64> added;
+    std::set_difference(before.begin(), before.end(), after.begin(), after.end(),
+                        std::back_inserter(removed));
+    std::set_difference(after.begin(), after.end(), before.begin(), before.end(),
+                        std::back_inserter(added));
+    const quint32 serial = serialOfRow.at(row);
+    removePostings(serial, removed);
+    addPostings(serial, added);
+}
+
+void SearchIndex::removeRow(int row, const QString &id, const QString &name)
+{
+    const quint32 serial = serialOfRow.at(row);
+    removePostings(serial, trigrams(id, name));
+    rowOfSerial[serial] = -1;
+    freeSerials.push_back(serial);
+    serialOfRow.remove(row);
+    for (int r = row; r < serialOfRow.size(); ++r) {
+        rowOfSerial[serialOfRow.at(r)] = r;
+    }
+}
+
+bool SearchIndex::lookup(const QString &needle, const ProductStore &store,
+                         QVector<int> *rows) const
+{
+    Trace::Span span("SearchIndex::lookup");
+    const QString folded = needle.toCaseFolded();
+    if (folded.size() < kMinNeedle) {
+        return false;
+    }
+    rows->clear();
+
+    QVector<quint64> keys;
+    appendTrigrams(folded, &keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // Intersect from the rarest trigram up; any missing trigram means no hit.
+    QVector<const QVector<quint32> *> lists;
+    for (quint64 key : keys) {
+        const auto it = postings.constFind(key);
+        if (it == postings.constEnd()) {
+            return true;
+        }
+        lists.push_back(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const QVector<quint32> *a, const QVector<quint32> *b) {
+                  return a->size() < b->size();
+              });
+
+    QVector<quint32> candidates = *lists.first();
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+        QVector<quint32> narrowed;
+        std::set_intersection(candidates.begin(), candidates.end(),
+                              lists.at(i)->begin(), lists.at(i)->end(),
+                              std::back_inserter(narrowed));
+        candidates.swap(narrowed);
+    }
+
+    // Trigrams only prove the pieces are present; confirm the substring.
+    for (quint32 serial : candidates) {
+        const int row = rowOfSerial.at(serial);
+        if (row < 0) {
+            continue;
+        }
+        if (containsFolded(store.idRef(row), needle) ||
+            containsFolded(store.nameRef(row), needle)) {
+            rows->push_back(row);
+        }
+    }
+    std::sort(rows->begin(), rows->end());
+    return true;
+}
+
+QVector<quint64> SearchIndex::trigrams(const QString &id, const QString &name)
+{
+    // Distinct, sorted keys for one product.
+    QVector<quint64> keys;
+    appendTrigrams(id.toCaseFolded(), &keys);
+    appendTrigrams(name.toCaseFolded(), &keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+void SearchIndex::addPostings(quint32 serial, const QVector<quint64> &keys)
+{
+    for (quint64 key : keys) {
+        QVector<quint32> &list = postings[key];
+        if (list.isEmpty() || list.last() < serial) {
+            list.push_back(serial);
+        } else {
+            list.insert(std::lower_bound(list.begin(), list.end(), serial), serial);
+        }
+    }
+}
+
+void SearchIndex::removePostings(quint32 serial, const QVector<quint64> &keys)
+{
+    for (quint64 key : keys) {
+        auto it = postings.find(key);
+        if (it == postings.end()) {
+            continue;
+        }
+        QVector<quint32> &list = it.value();
+        const auto pos = std::lower_bound(list.begin(), list.end(), serial);
+        if (pos != list.end() && *pos == serial) {
+            list.erase(pos);
+        }
+        if (list.isEmpty()) {
+            postings.erase(it);
+        }
+    }
+}
@@ -0,0 +1,469 @@
+#include "sharedcatalog.h"
+
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+const char kControlMagic[8] = {'S', 'M', 'I', 'N', 'V', 'C', 'T', 'L'};
+const char kDataMagic[8] = {'S', 'M', 'I', 'N', 'V', 'S', 'H', 'M'};
+// Version 2 stores prices as integer cents (version 1 had doubles).
+const quint32 kVersion = 2;
+// Smallest ID table; it is sized to stay at most half full.
+const quint32 kMinSlots = 16;
+// Generations tried when a segment left over from a crash is in the way.
+const int kCreateAttempts = 8;
+
+// The control segment: which generation is current.
+struct Control {
+    char magic[8];
+    quint32 version;
+    quint32 reserved;
+    quint64 generation;
+    quint64 reserved2;
+};
+static_assert(sizeof(Control) == 32, "control block must stay 32 bytes");
+
+// Fixed 64-byte header of each generation segment, followed by (each
+// section 8-byte aligned):
+//   qint32   slot[slotCount]          (row or -1)
+//   qint64   priceCents[rows]
+//   qint32   quantity[rows]
+//   quint32  idSlice[rows][2]         (offset, length into the text heap)
+//   quint32  nameSlice[rows][2]
+//   char16   text[textLength]
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 rowCount;
+    quint32 slotCount;
+    quint32 reserved;
+    quint64 textLength;
+    quint64 generation;
+    quint8 reserved2[24];
+};
+static_assert(sizeof(Header) == 64, "catalog header must stay 64 bytes");
+
+// Section offsets for a segment of a given shape.
+struct Layout {
+    quint64 slots;
+    quint64 prices;
+    quint64 quantities;
+    quint64 idSlices;
+    quint64 nameSlices;
+    quint64 text;
+    quint64 total;
+};
+
+quint64 padded(quint64 bytes)
+{
+    return (bytes + 7) & ~quint64(7);
+}
+
+Layout layoutFor(quint64 rows, quint64 slotCount, quint64 textLength)
+{
+    Layout layout;
+    layout.slots = sizeof(Header);
+    layout.prices = layout.slots + padded(sizeof(qint32) * slotCount);
+    layout.quantities = layout.prices + sizeof(qint64) * rows;
+    layout.idSlices = layout.quantities + padded(sizeof(qint32) * rows);
+    layout.nameSlices = layout.idSlices + sizeof(quint32) * 2 * rows;
+    layout.text = layout.nameSlices + sizeof(quint32) * 2 * rows;
+    layout.total = layout.text + padded(sizeof(QChar) * textLength);
+    return layout;
+}
+
+// FNV-1a over UTF-16 units; unlike qHash it is the same in every process.
+quint32 hashId(const QChar *units, int length)
+{
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ units[i].unicode()) * 16777619u;
+    }
+    return hash;
+}
+
+QString dataKey(const QString &key, quint64 generation)
+{
+    return key + "." + QString::number(generation);
+}
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+}
+
+namespace SharedCatalog {
+
+QString defaultKey()
+{
+    return "SupermarketInventory.catalog";
+}
+
+}
+
+SharedCatalogPublisher::SharedCatalogPublisher(const QString &key)
+    : key(key)
+    , control(key)
+    , current(nullptr)
+    , published(0)
+    , worker(nullptr)
+    , hasPending(false)
+    , busy(false)
+{
+}
+
+SharedCatalogPublisher::~SharedCatalogPublisher()
+{
+    waitForFinished();
+    delete current;
+}
+
+void SharedCatalogPublisher::publishInBackground(const ProductStore &products)
+{
+    QMutexLocker locker(&pendingLock);
+    pending = products;
+    hasPending = true;
+    if (busy) {
+        // The running worker picks the new copy up when it is done.
+        return;
+    }
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+    busy = true;
+    worker = QThread::create([this]() { publishPending(); });
+    worker->start();
+}
+
+void SharedCatalogPublisher::publishPending()
+{
+    // Runs on the worker until nothing is waiting.
+    for (;;) {
+        ProductStore products;
+        {
+            QMutexLocker locker(&pendingLock);
+            if (!hasPending) {
+                busy = false;
+                return;
+            }
+            products = pending;
+            pending = ProductStore();
+            hasPending = false;
+        }
+        QString message;
+        const bool ok = publish(products, &message);
+        QMutexLocker locker(&pendingLock);
+        error = ok ? QString() : message;
+    }
+}
+
+void SharedCatalogPublisher::waitForFinished()
+{
+    QMutexLocker locker(&pendingLock);
+    QThread *running = worker;
+    worker = nullptr;
+    locker.unlock();
+    if (running) {
+        running->wait();
+        delete running;
+    }
+}
+
+QString SharedCatalogPublisher::lastError() const
+{
+    QMutexLocker locker(&pendingLock);
+    return error;
+}
+
+bool SharedCatalogPublisher::attachControl(QString *errorMessage)
+{
+    if (control.isAttached()) {
+        return true;
+    }
+    if (control.create(sizeof(Control))) {
+        control.lock();
+        auto *block = static_cast<Control *>(control.data());
+        std::memset(block, 0, sizeof(Control));
+        std::memcpy(block->magic, kControlMagic, sizeof(kControlMagic));
+        block->version = kVersion;
+        control.unlock();
+        return true;
+    }
+    // Left by an earlier run; carry on from its generation.
+    if (control.error() == QSharedMemory::AlreadyExists && control.attach()) {
+        const auto *block = static_cast<const Control *>(control.constData());
+        if (std::memcmp(block->magic, kControlMagic, sizeof(kControlMagic)) == 0 &&
+            block->version == kVersion) {
+            return true;
+        }
+        control.detach();
+    }
+    setError(errorMessage, "Could not open the shared catalog: " + control.errorString());
+    return false;
+}
+
+bool SharedCatalogPublisher::publish(const ProductStore &products, QString *errorMessage)
+{
+    if (!attachControl(errorMessage)) {
+        return false;
+    }
+    control.lock();
+    quint64 next = static_cast<const Control *>(control.constData())->generation + 1;
+    control.unlock();
+
+    const quint64 rows = static_cast<quint64>(products.size());
+    quint64 textLength = 0;
+    for (int row = 0; row < products.size(); ++row) {
+        textLength += products.idRef(row).size() + products.nameRef(row).size();
+    }
+    quint64 slotCount = kMinSlots;
+    while (slotCount < rows * 2) {
+        slotCount *= 2;
+    }
+    const Layout layout = layoutFor(rows, slotCount, textLength);
+    if (layout.total > static_cast<quint64>(INT_MAX)) {
+        setError(errorMessage, "The catalog is too large to share.");
+        return false;
+    }
+
+    // A fresh segment per generation; readers never see it half written.
+    auto *segment = new QSharedMemory;
+    bool created = false;
+    for (int attempt = 0; attempt < kCreateAttempts && !created; ++attempt) {
+        segment->setKey(dataKey(key, next));
+        created = segment->create(static_cast<int>(layout.total));
+        if (!created) {
+            ++next;
+        }
+    }
+    if (!created) {
+        setError(errorMessage, "Could not create the shared catalog: " + segment->errorString());
+        delete segment;
+        return false;
+    }
+
+    char *base = static_cast<char *>(segment->data());
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kDataMagic, sizeof(kDataMagic));
+    header.version = kVersion;
+    header.rowCount = static_cast<quint32>(rows);
+    header.slotCount = static_cast<quint32>(slotCount);
+    header.textLength = textLength;
+    header.generation = next;
+    std::memcpy(base, &header, sizeof(header));
+
+    auto *slots = reinterpret_cast<qint32 *>(base + layout.slots);
+    auto *prices = reinterpret_cast<qint64 *>(base + layout.prices);
+    auto *quantities = reinterpret_cast<qint32 *>(base + layout.quantities);
+    auto *idSlices = reinterpret_cast<quint32 *>(base + layout.idSlices);
+    auto *nameSlices = reinterpret_cast<quint32 *>(base + layout.nameSlices);
+    auto *text = reinterpret_cast<QChar *>(base + layout.text);
+    std::fill(slots, slots + slotCount, -1);
+
+    const quint32 mask = static_cast<quint32>(slotCount - 1);
+    quint32 offset = 0;
+    for (int row = 0; row < products.size(); ++row) {
+        const QString id = products.idRef(row);
+        const QString name = products.nameRef(row);
+        prices[row] = products.price(row).cents();
+        quantities[row] = products.quantity(row);
+        idSlices[row * 2] = offset;
+        idSlices[row * 2 + 1] = static_cast<quint32>(id.size());
+        std::memcpy(text + offset, id.constData(), sizeof(QChar) * id.size());
+        offset += static_cast<quint32>(id.size());
+        nameSlices[row * 2] = offset;
+        nameSlices[row * 2 + 1] = static_cast<quint32>(name.size());
+        std::memcpy(text + offset, name.constData(), sizeof(QChar) * name.size());
+        offset += static_cast<quint32>(name.size());
+
+        quint32 slot = hashId(id.constData(), id.size()) & mask;
+        while (slots[slot] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = row;
+    }
+
+    // Flip readers over, then let go of the previous generation; readers
+    // still attached to it keep it alive until they refresh.
+    control.lock();
+    static_cast<Control *>(control.data())->generation = next;
+    control.unlock();
+    delete current;
+    current = segment;
+    published = next;
+    return true;
+}
+
+quint64 SharedCatalogPublisher::generation() const
+{
+    return published;
+}
+
+SharedCatalogReader::SharedCatalogReader(const QString &key)
+    : key(key)
+    , control(key)
+    , data(nullptr)
+    , attached(0)
+    , rows(0)
+    , slotMask(0)
+    , slots(nullptr)
+    , prices(nullptr)
+    , quantities(nullptr)
+    , idSlices(nullptr)
+    , nameSlices(nullptr)
+    , text(nullptr)
+{
+}
+
+SharedCatalogReader::~SharedCatalogReader()
+{
+    delete data;
+}
+
+bool SharedCatalogReader::attach(QString *errorMessage)
+{
+    if (!control.isAttached() && !control.attach(QSharedMemory::ReadOnly)) {
+        setError(errorMessage, "No shared catalog is published on this machine.");
+        return false;
+    }
+    const quint64 generation = publishedGeneration();
+    if (generation == 0 || !attachGeneration(generation)) {
+        setError(errorMessage, "The shared catalog is not available.");
+        return false;
+    }
+    return true;
+}
+
+bool SharedCatalogReader::refresh()
+{
+    if (!control.isAttached()) {
+        return attach(nullptr);
+    }
+    const quint64 generation = publishedGeneration();
+    return generation != attached && attachGeneration(generation);
+}
+
+bool SharedCatalogReader::isAttached() const
+{
+    return data != nullptr;
+}
+
+quint64 SharedCatalogReader::generation() const
+{
+    return attached;
+}
+
+quint64 SharedCatalogReader::publishedGeneration()
+{
+    control.lock();
+    const auto *block = static_cast<const Control *>(control.constData());
+    const quint64 generation =
+        std::memcmp(block->magic, kControlMagic, sizeof(kControlMagic)) == 0 ? block->generation
+                                                                             : 0;
+    control.unlock();
+    return generation;
+}
+
+bool SharedCatalogReader::attachGeneration(quint64 generation)
+{
+    auto *segment = new QSharedMemory(dataKey(key, generation));
+    if (!segment->attach(QSharedMemory::ReadOnly)) {
+        delete segment;
+        return false;
+    }
+
+    // Check the header and that the sections fit before trusting it.
+    const quint64 segmentSize = static_cast<quint64>(segment->size());
+    Header header;
+    bool ok = segmentSize >= sizeof(Header);
+    if (ok) {
+        std::memcpy(&header, segment->constData(), sizeof(header));
+        ok = std::memcmp(header.magic, kDataMagic, sizeof(kDataMagic)) == 0 &&
+             header.version == kVersion && header.generation == generation &&
+             header.slotCount >= kMinSlots && (header.slotCount & (header.slotCount - 1)) == 0 &&
+             header.rowCount <= static_cast<quint32>(INT_MAX) &&
+             layoutFor(header.rowCount, header.slotCount, header.textLength).total <= segmentSize;
+    }
+    if (!ok) {
+        delete segment;
+        return false;
+    }
+
+    delete data;
+    data = segment;
+    attached = generation;
+    mapSections();
+    return true;
+}
+
+void SharedCatalogReader::mapSections()
+{
+    const char *base = static_cast<const char *>(data->constData());
+    Header header;
+    std::memcpy(&header, base, sizeof(header));
+    const Layout layout = layoutFor(header.rowCount, header.slotCount, header.textLength);
+    rows = static_cast<int>(header.rowCount);
+    slotMask = header.slotCount - 1;
+    slots = reinterpret_cast<const qint32 *>(base + layout.slots);
+    prices = reinterpret_cast<const qint64 *>(base + layout.prices);
+    quantities = reinterpret_cast<const qint32 *>(base + layout.quantities);
+    idSlices = reinterpret_cast<const quint32 *>(base + layout.idSlices);
+    nameSlices = reinterpret_cast<const quint32 *>(base + layout.nameSlices);
+    text = reinterpret_cast<const QChar *>(base + layout.text);
+}
+
+int SharedCatalogReader::size() const
+{
+    return data ? rows : 0;
+}
+
+int SharedCatalogReader::find(const QString &id) const
+{
+    // Probe from the ID's home slot until a match or an empty slot.
+    if (!data) {
+        return -1;
+    }
+    for (quint32 slot = hashId(id.constData(), id.size()) & slotMask; ;
+         slot = (slot + 1) & slotMask) {
+        const int row = slots[slot];
+        if (row < 0 || row >= rows) {
+            return -1;
+        }
+        if (idSlices[row * 2 + 1] == static_cast<quint32>(id.size()) &&
+            std::memcmp(text + idSlices[row * 2], id.constData(),
+                        sizeof(QChar) * id.size()) == 0) {
+            return row;
+        }
+    }
+}
+
+QString SharedCatalogReader::id(int row) const
+{
+    return QString::fromRawData(text + idSlices[row * 2], static_cast<int>(idSlices[row * 2 + 1]));
+}
+
+QString SharedCatalogReader::name(int row) const
+{
+    return QString::fromRawData(text + nameSlices[row * 2],
+                                static_cast<int>(nameSlices[row * 2 + 1]));
+}
+
+Money SharedCatalogReader::price(int row) const
+{
+    return Money::fromCents(prices[row]);
+}
+
+int SharedCatalogReader::quantity(int row) const
+{
+    return quantities[row];
+}
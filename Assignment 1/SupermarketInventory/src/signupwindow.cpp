@@ -3,10 +3,13 @@
 #include "userstore.h"
 #include <QMessageBox>
 #include <QLineEdit>
+#include <QSharedPointer>
+#include <QThread>
 
 SignupWindow::SignupWindow(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::SignupWindow)
+    , creating(false)
 {
     // Basic UI wiring for signup.
     ui->setupUi(this);
@@ -27,6 +30,10 @@ SignupWindow::~SignupWindow()
 
 void SignupWindow::handleSignup()
 {
+    if (creating) {
+        return;
+    }
+
     // Read user input.
     const QString u = ui->usernameInput->text().trimmed();
     const QString p = ui->passwordInput->text();
@@ -62,11 +69,9 @@ void SignupWindow::handleSignup()
         return;
     }
 
-    // Load existing users if any.
-    QVector<UserStore::UserRecord> records;
-    QString pathUsed;
+    // Bring the shared user directory up to date.
     QString loadError;
-    if (!UserStore::loadUsersIfExists(&records, &loadError, &pathUsed)) {
+    if (!UserStore::refresh(&loadError)) {
         QMessageBox::warning(this, "Error", loadError.isEmpty()
                                                ? "Could not open users file."
                                                : loadError);
@@ -74,28 +79,60 @@ void SignupWindow::handleSignup()
     }
 
     // Prevent duplicate usernames.
-    if (UserStore::usernameExists(records, u)) {
+    if (UserStore::usernameExists(u)) {
         QMessageBox::warning(this, "Error", "Username already exists.");
         return;
     }
 
     // First user becomes admin if no admin exists yet.
-    const bool hasAdmin = UserStore::anyAdmin(records);
-    const UserStore::UserRecord newUser = UserStore::createUser(u, p, !hasAdmin);
-    records.push_back(newUser);
-
-    // Save new users file.
-    QString writeError;
-    if (!UserStore::saveUsers(records, &writeError)) {
-        QMessageBox::warning(this, "Error", writeError.isEmpty()
+    const bool hasAdmin = UserStore::anyAdmin();
+
+    // Hash and append on a worker so the dialog stays responsive.
+    struct Result {
+        bool ok = false;
+        QString error;
+    };
+    QSharedPointer<Result> result(new Result);
+    QThread *worker = QThread::create([u, p, hasAdmin, result]() {
+        const UserStore::UserRecord newUser = UserStore::createUser(u, p, !hasAdmin);
+        result->ok = UserStore::addUser(newUser, &result->error);
+    });
+    connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &QThread::finished, this, [this, hasAdmin, result]() {
+        setBusy(false);
+        finishSignup(result->ok, !hasAdmin, result->error);
+    });
+    setBusy(true);
+    worker->start();
+}
+
+void SignupWindow::setBusy(bool busy)
+{
+    // Lock the form while the account is being created.
+    creating = busy;
+    ui->signupBtn->setEnabled(!busy);
+    ui->usernameInput->setReadOnly(busy);
+    ui->passwordInput->setReadOnly(busy);
+    ui->confirmPasswordInput->setReadOnly(busy);
+    if (busy) {
+        setCursor(Qt::BusyCursor);
+    } else {
+        unsetCursor();
+    }
+}
+
+void SignupWindow::finishSignup(bool ok, bool isAdmin, const QString &errorMessage)
+{
+    if (!ok) {
+        QMessageBox::warning(this, "Error", errorMessage.isEmpty()
                                                ? "Could not save user."
-                                               : writeError);
+                                               : errorMessage);
         return;
     }
 
     QMessageBox::information(this,
                              "Success",
-                             newUser.isAdmin
+                             isAdmin
                                  ? "Account created! You are now an admin."
                                  : "Account created!");
 
@@ -0,0 +1,429 @@
+#include "sqlitebackend.h"
+
+#include "appdata.h"
+#include "inventorystore.h"
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+namespace {
+// Wait this long for another connection's write lock before failing.
+const int kBusyTimeoutMs = 5000;
+
+const char *const kSchema[] = {
+    "CREATE TABLE IF NOT EXISTS products ("
+    " id TEXT PRIMARY KEY NOT NULL, name TEXT NOT NULL,"
+    " price_cents INTEGER NOT NULL, quantity INTEGER NOT NULL)",
+    "CREATE INDEX IF NOT EXISTS products_name ON products (name)",
+    "CREATE TABLE IF NOT EXISTS users ("
+    " username TEXT PRIMARY KEY NOT NULL, salt BLOB NOT NULL, hash BLOB NOT NULL,"
+    " is_admin INTEGER NOT NULL, iterations INTEGER NOT NULL)",
+    "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY NOT NULL, value INTEGER NOT NULL)",
+    "INSERT OR IGNORE INTO meta (key, value) VALUES ('users_version', 0)",
+};
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+bool run(QSqlQuery &query, QString *errorMessage)
+{
+    if (!query.exec()) {
+        setError(errorMessage, "Database error: " + query.lastError().text());
+        return false;
+    }
+    return true;
+}
+
+bool runText(const QSqlDatabase &db, const QString &sql, QString *errorMessage)
+{
+    QSqlQuery query(db);
+    if (!query.exec(sql)) {
+        setError(errorMessage, "Database error: " + query.lastError().text());
+        return false;
+    }
+    return true;
+}
+
+void bindProduct(QSqlQuery &query, const Product &product)
+{
+    query.bindValue(0, product.id);
+    query.bindValue(1, product.name);
+    query.bindValue(2, product.price.cents());
+    query.bindValue(3, product.quantity);
+}
+
+void bindUser(QSqlQuery &query, const UserStore::UserRecord &record)
+{
+    query.bindValue(0, record.username);
+    query.bindValue(1, record.salt);
+    query.bindValue(2, record.hash);
+    query.bindValue(3, record.isAdmin ? 1 : 0);
+    query.bindValue(4, record.iterations);
+}
+}
+
+// One thread's connection with its prepared statements.
+struct SqliteBackend::Connection {
+    ~Connection();
+
+    QString name;
+    QSqlDatabase db;
+    QSqlQuery selectProducts;
+    QSqlQuery insertProduct;
+    QSqlQuery updateProduct;
+    QSqlQuery deleteProduct;
+    QSqlQuery upsertProduct;
+    QSqlQuery selectUsers;
+    QSqlQuery insertUser;
+    QSqlQuery updateUser;
+    QSqlQuery readUsersVersion;
+    QSqlQuery bumpUsersVersion;
+};
+
+SqliteBackend::Connection::~Connection()
+{
+    // Statements have to go before the connection they were prepared on.
+    selectProducts = QSqlQuery();
+    insertProduct = QSqlQuery();
+    updateProduct = QSqlQuery();
+    deleteProduct = QSqlQuery();
+    upsertProduct = QSqlQuery();
+    selectUsers = QSqlQuery();
+    insertUser = QSqlQuery();
+    updateUser = QSqlQuery();
+    readUsersVersion = QSqlQuery();
+    bumpUsersVersion = QSqlQuery();
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+}
+
+SqliteBackend::SqliteBackend(const QString &path)
+    : path(path)
+    , connectionCount(0)
+    , loadedUsersVersion(-1)
+{
+}
+
+SqliteBackend::~SqliteBackend()
+{
+    // Other threads' connections are closed as those threads exit.
+    connections.setLocalData(nullptr);
+}
+
+bool SqliteBackend::isAvailable()
+{
+    return QSqlDatabase::isDriverAvailable("QSQLITE");
+}
+
+bool SqliteBackend::open(QString *errorMessage)
+{
+    if (!isAvailable()) {
+        setError(errorMessage, "The SQLite driver is not available.");
+        return false;
+    }
+    if (!AppData::ensureDataDir(errorMessage)) {
+        return false;
+    }
+    Connection *db = connection(errorMessage);
+    return db && migrate(db, errorMessage);
+}
+
+SqliteBackend::Connection *SqliteBackend::connection(QString *errorMessage)
+{
+    if (connections.hasLocalData()) {
+        return connections.localData();
+    }
+
+    auto *db = new Connection;
+    db->name = QString("inventory-sqlite-%1").arg(connectionCount.fetchAndAddRelaxed(1));
+    db->db = QSqlDatabase::addDatabase("QSQLITE", db->name);
+    db->db.setDatabaseName(path);
+    db->db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(kBusyTimeoutMs));
+    bool ok = db->db.open();
+    if (!ok) {
+        setError(errorMessage, "Could not open database: " + db->db.lastError().text());
+    }
+    // WAL lets readers run alongside the single writer; FULL syncs each commit.
+    ok = ok && runText(db->db, "PRAGMA journal_mode=WAL", errorMessage);
+    ok = ok && runText(db->db, "PRAGMA synchronous=FULL", errorMessage);
+    for (const char *statement : kSchema) {
+        ok = ok && runText(db->db, statement, errorMessage);
+    }
+
+    struct Statement {
+        QSqlQuery *query;
+        const char *sql;
+    };
+    const Statement statements[] = {
+        {&db->selectProducts,
+         "SELECT id, name, price_cents, quantity FROM products ORDER BY rowid"},
+        {&db->insertProduct,
+         "INSERT INTO products (id, name, price_cents, quantity) VALUES (?, ?, ?, ?)"},
+        {&db->updateProduct,
+         "UPDATE products SET id = ?, name = ?, price_cents = ?, quantity = ? WHERE id = ?"},
+        {&db->deleteProduct, "DELETE FROM products WHERE id = ?"},
+        {&db->upsertProduct,
+         "INSERT INTO products (id, name, price_cents, quantity) VALUES (?, ?, ?, ?)"
+         " ON CONFLICT (id) DO UPDATE SET name = excluded.name,"
+         " price_cents = excluded.price_cents, quantity = excluded.quantity"},
+        {&db->selectUsers,
+         "SELECT username, salt, hash, is_admin, iterations FROM users ORDER BY rowid"},
+        {&db->insertUser,
+         "INSERT INTO users (username, salt, hash, is_admin, iterations) VALUES (?, ?, ?, ?, ?)"},
+        {&db->updateUser,
+         "UPDATE users SET username = ?, salt = ?, hash = ?, is_admin = ?, iterations = ?"
+         " WHERE username = ?"},
+        {&db->readUsersVersion, "SELECT value FROM meta WHERE key = 'users_version'"},
+        {&db->bumpUsersVersion, "UPDATE meta SET value = value + 1 WHERE key = 'users_version'"},
+    };
+    for (const Statement &statement : statements) {
+        if (!ok) {
+            break;
+        }
+        *statement.query = QSqlQuery(db->db);
+        if (!statement.query->prepare(statement.sql)) {
+            setError(errorMessage, "Database error: " + statement.query->lastError().text());
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        delete db;
+        return nullptr;
+    }
+    connections.setLocalData(db);
+    return db;
+}
+
+bool SqliteBackend::migrate(Connection *db, QString *errorMessage)
+{
+    // One-time import of the CSV files; they are left in place as a backup.
+    // Products go through a CSV-mode store so journalled edits come along.
+    QSqlQuery check(db->db);
+    if (!check.exec("SELECT value FROM meta WHERE key = 'csv_migrated'")) {
+        setError(errorMessage, "Database error: " + check.lastError().text());
+        return false;
+    }
+    if (check.next()) {
+        return true;
+    }
+    check.finish();
+
+    InventoryStore csv;
+    csv.setWritable(false);
+    if (!csv.load(false, errorMessage)) {
+        return false;
+    }
+    const ProductStore &products = csv.products();
+    QVector<UserStore::UserRecord> users;
+    if (!UserStore::loadUsersIfExists(&users, errorMessage, nullptr)) {
+        return false;
+    }
+
+    if (!db->db.transaction()) {
+        setError(errorMessage, "Database error: " + db->db.lastError().text());
+        return false;
+    }
+    QSqlQuery insertProduct(db->db);
+    insertProduct.prepare("INSERT OR IGNORE INTO products (id, name, price_cents, quantity)"
+                          " VALUES (?, ?, ?, ?)");
+    QSqlQuery insertUser(db->db);
+    insertUser.prepare("INSERT OR IGNORE INTO users (username, salt, hash, is_admin, iterations)"
+                       " VALUES (?, ?, ?, ?, ?)");
+    bool ok = true;
+    for (int row = 0; ok && row < products.size(); ++row) {
+        bindProduct(insertProduct, products.product(row));
+        ok = run(insertProduct, errorMessage);
+    }
+    for (int i = 0; ok && i < users.size(); ++i) {
+        bindUser(insertUser, users.at(i));
+        ok = run(insertUser, errorMessage);
+    }
+    ok = ok && run(db->bumpUsersVersion, errorMessage);
+    ok = ok && runText(db->db, "INSERT INTO meta (key, value) VALUES ('csv_migrated', 1)",
+                       errorMessage);
+    if (!ok || !db->db.commit()) {
+        db->db.rollback();
+        if (ok) {
+            setError(errorMessage, "Could not import the CSV files.");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool SqliteBackend::loadProducts(ProductStore *out, QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    db->selectProducts.setForwardOnly(true);
+    if (!run(db->selectProducts, errorMessage)) {
+        return false;
+    }
+    ProductStore loaded;
+    Product product;
+    while (db->selectProducts.next()) {
+        product.id = db->selectProducts.value(0).toString();
+        product.name = db->selectProducts.value(1).toString();
+        product.price = Money::fromCents(db->selectProducts.value(2).toLongLong());
+        product.quantity = db->selectProducts.value(3).toInt();
+        loaded.append(product);
+    }
+    db->selectProducts.finish();
+    *out = loaded;
+    return true;
+}
+
+bool SqliteBackend::addProduct(const Product &product, QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    bindProduct(db->insertProduct, product);
+    return run(db->insertProduct, errorMessage);
+}
+
+bool SqliteBackend::updateProduct(const QString &oldId, const Product &product,
+                                  QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    bindProduct(db->updateProduct, product);
+    db->updateProduct.bindValue(4, oldId);
+    return run(db->updateProduct, errorMessage);
+}
+
+bool SqliteBackend::removeProduct(const QString &id, QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    db->deleteProduct.bindValue(0, id);
+    return run(db->deleteProduct, errorMessage);
+}
+
+bool SqliteBackend::applyBatch(const QVector<Product> &upserts, const QStringList &deletes,
+                               QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    if (!db->db.transaction()) {
+        setError(errorMessage, "Database error: " + db->db.lastError().text());
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; ok && i < deletes.size(); ++i) {
+        db->deleteProduct.bindValue(0, deletes.at(i));
+        ok = run(db->deleteProduct, errorMessage);
+    }
+    for (int i = 0; ok && i < upserts.size(); ++i) {
+        bindProduct(db->upsertProduct, upserts.at(i));
+        ok = run(db->upsertProduct, errorMessage);
+    }
+    if (!ok || !db->db.commit()) {
+        db->db.rollback();
+        if (ok) {
+            setError(errorMessage, "Database error: " + db->db.lastError().text());
+        }
+        return false;
+    }
+    return true;
+}
+
+qint64 SqliteBackend::usersVersion(Connection *db)
+{
+    qint64 version = -1;
+    if (db->readUsersVersion.exec() && db->readUsersVersion.next()) {
+        version = db->readUsersVersion.value(0).toLongLong();
+    }
+    db->readUsersVersion.finish();
+    return version;
+}
+
+bool SqliteBackend::usersChanged()
+{
+    Connection *db = connection(nullptr);
+    return !db || usersVersion(db) != loadedUsersVersion.loadRelaxed();
+}
+
+bool SqliteBackend::loadUsers(QVector<UserStore::UserRecord> *out, QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    // Version first: a write landing in between only causes one more reload.
+    const qint64 version = usersVersion(db);
+    db->selectUsers.setForwardOnly(true);
+    if (!run(db->selectUsers, errorMessage)) {
+        return false;
+    }
+    out->clear();
+    while (db->selectUsers.next()) {
+        UserStore::UserRecord record;
+        record.username = db->selectUsers.value(0).toString();
+        record.salt = db->selectUsers.value(1).toByteArray();
+        record.hash = db->selectUsers.value(2).toByteArray();
+        record.isAdmin = db->selectUsers.value(3).toInt() != 0;
+        record.iterations = db->selectUsers.value(4).toInt();
+        out->push_back(record);
+    }
+    db->selectUsers.finish();
+    loadedUsersVersion.storeRelaxed(version);
+    return true;
+}
+
+bool SqliteBackend::addUser(const UserStore::UserRecord &record, QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    if (!db->db.transaction()) {
+        setError(errorMessage, "Database error: " + db->db.lastError().text());
+        return false;
+    }
+    bindUser(db->insertUser, record);
+    const bool ok = run(db->insertUser, errorMessage) &&
+                    run(db->bumpUsersVersion, errorMessage);
+    if (!ok || !db->db.commit()) {
+        db->db.rollback();
+        return false;
+    }
+    return true;
+}
+
+bool SqliteBackend::updateUser(const UserStore::UserRecord &record, QString *errorMessage)
+{
+    Connection *db = connection(errorMessage);
+    if (!db) {
+        return false;
+    }
+    if (!db->db.transaction()) {
+        setError(errorMessage, "Database error: " + db->db.lastError().text());
+        return false;
+    }
+    bindUser(db->updateUser, record);
+    db->updateUser.bindValue(5, record.username);
+    const bool ok = run(db->updateUser, errorMessage) &&
+                    run(db->bumpUsersVersion, errorMessage);
+    if (!ok || !db->db.commit()) {
+        db->db.rollback();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,568 @@
+#include "stockhistory.h"
+
+#include "trace.h"
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QTime>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[8] = {'S', 'M', 'S', 'T', 'O', 'C', 'K', 'H'};
+const quint32 kVersion = 1;
+// Movements per sealed block.
+const int kBlockPoints = 1024;
+// Rewrite the log without sealed movements once it grows past this.
+const qint64 kLogCompactBytes = 4 << 20;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 reserved;
+};
+static_assert(sizeof(FileHeader) == 16, "history header must stay 16 bytes");
+
+// Precedes each block's product ID (UTF-8) and payload.
+struct BlockHeader {
+    quint32 idBytes;
+    quint32 count;
+    quint32 timestampBytes;
+    quint32 deltaBytes;
+    qint64 firstTimestamp;
+    qint64 lastTimestamp;
+    qint64 sold;
+    qint64 net;
+};
+static_assert(sizeof(BlockHeader) == 48, "block header must stay 48 bytes");
+
+quint64 zigzag(qint64 value)
+{
+    return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+    return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+}
+
+void putVarint(QByteArray *out, quint64 value)
+{
+    while (value >= 0x80) {
+        out->append(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out->append(static_cast<char>(value));
+}
+
+bool getVarint(const uchar **at, const uchar *end, quint64 *value)
+{
+    quint64 result = 0;
+    for (int shift = 0; *at < end && shift < 64; shift += 7) {
+        const uchar byte = *(*at)++;
+        result |= static_cast<quint64>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+qint64 soldIn(const StockMovement &movement)
+{
+    return movement.reason == StockMovement::Sale ? -static_cast<qint64>(movement.delta) : 0;
+}
+
+// Bucket of timestamp among ascending edges, or -1 outside them.
+int bucketOf(const QVector<qint64> &edges, qint64 timestamp)
+{
+    if (timestamp < edges.first() || timestamp >= edges.last()) {
+        return -1;
+    }
+    return static_cast<int>(std::upper_bound(edges.begin(), edges.end(), timestamp) -
+                            edges.begin()) - 1;
+}
+
+QByteArray logLine(const QByteArray &productId, qint64 sequence, const StockMovement &movement)
+{
+    return productId + ',' + QByteArray::number(sequence) + ',' +
+           QByteArray::number(movement.timestamp) + ',' + QByteArray::number(movement.delta) +
+           ',' + QByteArray::number(static_cast<int>(movement.reason)) + '\n';
+}
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+}
+
+StockHistory::StockHistory(const QString &blocksPath, const QString &logPath)
+    : logPath(logPath)
+    , blocksFile(blocksPath)
+    , blocksSize(0)
+    , mapped(nullptr)
+    , mappedSize(0)
+    , logSize(0)
+    , logLimit(kLogCompactBytes)
+    , writable(false)
+{
+}
+
+StockHistory::~StockHistory()
+{
+    if (mapped) {
+        blocksFile.unmap(mapped);
+    }
+}
+
+bool StockHistory::open(bool writable, QString *errorMessage)
+{
+    Trace::Span span("StockHistory::open");
+    if (isOpen()) {
+        return true;
+    }
+    this->writable = writable;
+    if (!blocksFile.open(writable ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+        setError(errorMessage, "Could not open the stock history.");
+        return false;
+    }
+    if (!readBlocks(errorMessage) || !readLog(errorMessage)) {
+        blocksFile.close();
+        series.clear();
+        return false;
+    }
+    return true;
+}
+
+bool StockHistory::isOpen() const
+{
+    return blocksFile.isOpen();
+}
+
+bool StockHistory::readBlocks(QString *errorMessage)
+{
+    blocksSize = blocksFile.size();
+    if (blocksSize == 0 && !writable) {
+        return true;
+    }
+    if (blocksSize == 0) {
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        if (blocksFile.write(reinterpret_cast<const char *>(&header), sizeof(header)) !=
+            static_cast<qint64>(sizeof(header))) {
+            setError(errorMessage, "Could not write the stock history.");
+            return false;
+        }
+        blocksSize = sizeof(header);
+        return true;
+    }
+
+    FileHeader header;
+    if (blocksFile.read(reinterpret_cast<char *>(&header), sizeof(header)) !=
+            static_cast<qint64>(sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        setError(errorMessage, "The stock history file has an unknown format.");
+        return false;
+    }
+
+    // Only headers are read; payloads are read from the file when queried.
+    qint64 offset = sizeof(header);
+    BlockHeader block;
+    while (blocksFile.seek(offset) &&
+           blocksFile.read(reinterpret_cast<char *>(&block), sizeof(block)) ==
+               static_cast<qint64>(sizeof(block))) {
+        const qint64 end = offset + sizeof(block) + block.idBytes + block.timestampBytes +
+                           block.deltaBytes;
+        if (block.count == 0 || end > blocksSize) {
+            break;
+        }
+        const QByteArray id = blocksFile.read(block.idBytes);
+        if (id.size() != static_cast<int>(block.idBytes)) {
+            break;
+        }
+        Block info;
+        info.firstTimestamp = block.firstTimestamp;
+        info.lastTimestamp = block.lastTimestamp;
+        info.sold = block.sold;
+        info.net = block.net;
+        info.offset = offset + sizeof(block) + block.idBytes;
+        info.timestampBytes = block.timestampBytes;
+        info.deltaBytes = block.deltaBytes;
+        info.count = static_cast<int>(block.count);
+        Series &product = series[QString::fromUtf8(id)];
+        product.blocks.push_back(info);
+        product.sealed += info.count;
+        offset = end;
+    }
+
+    // A block cut short by a crash is dropped; the log still has it. Read
+    // only, it may be one the writer is still appending, so it is skipped.
+    if (writable && offset != blocksSize && !blocksFile.resize(offset)) {
+        setError(errorMessage, "Could not repair the stock history.");
+        return false;
+    }
+    blocksSize = offset;
+    return true;
+}
+
+bool StockHistory::readLog(QString *errorMessage)
+{
+    QFile log(logPath);
+    if (!log.exists()) {
+        return true;
+    }
+    if (!log.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        setError(errorMessage, "Could not read the stock history log.");
+        return false;
+    }
+    logSize = log.size();
+
+    // "id,sequence,timestamp,delta,reason" (the ID may hold commas); lines
+    // already sealed into a block, or torn, are skipped.
+    QTextStream in(&log);
+    while (!in.atEnd()) {
+        const QStringList fields = in.readLine().split(',');
+        const int n = fields.size();
+        if (n < 5) {
+            continue;
+        }
+        bool ok[4] = {false, false, false, false};
+        const qint64 sequence = fields.at(n - 4).toLongLong(&ok[0]);
+        StockMovement movement;
+        movement.timestamp = fields.at(n - 3).toLongLong(&ok[1]);
+        movement.delta = fields.at(n - 2).toInt(&ok[2]);
+        const int reason = fields.at(n - 1).toInt(&ok[3]);
+        if (!ok[0] || !ok[1] || !ok[2] || !ok[3] || reason < StockMovement::Sale ||
+            reason > StockMovement::Removed) {
+            continue;
+        }
+        movement.reason = static_cast<StockMovement::Reason>(reason);
+        Series &product = series[fields.mid(0, n - 4).join(',')];
+        if (sequence == product.sealed + product.open.size()) {
+            product.open.push_back(movement);
+            product.logged = product.open.size();
+        }
+    }
+    return true;
+}
+
+void StockHistory::record(const QString &productId, int delta, StockMovement::Reason reason,
+                          qint64 timestamp)
+{
+    Series &product = series[productId];
+    qint64 last = timestamp;
+    if (!product.open.isEmpty()) {
+        last = product.open.last().timestamp;
+    } else if (!product.blocks.isEmpty()) {
+        last = product.blocks.last().lastTimestamp;
+    }
+    StockMovement movement;
+    movement.timestamp = qMax(timestamp, last);
+    movement.delta = delta;
+    movement.reason = reason;
+    product.open.push_back(movement);
+    touched.insert(productId);
+}
+
+bool StockHistory::flush(QString *errorMessage)
+{
+    Trace::Span span("StockHistory::flush");
+    if (!isOpen() || !writable || touched.isEmpty()) {
+        return true;
+    }
+    // Log first, so a block is only written once its movements are safe.
+    if (!appendLog(errorMessage)) {
+        return false;
+    }
+    for (const QString &id : touched) {
+        Series &product = series[id];
+        while (product.open.size() >= kBlockPoints) {
+            if (!seal(id, &product, errorMessage)) {
+                return false;
+            }
+        }
+    }
+    touched.clear();
+    if (!blocksFile.flush()) {
+        setError(errorMessage, "Could not write the stock history.");
+        return false;
+    }
+    return logSize < logLimit || rewriteLog(errorMessage);
+}
+
+bool StockHistory::appendLog(QString *errorMessage)
+{
+    QFile log(logPath);
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        setError(errorMessage, "Could not write the stock history log.");
+        return false;
+    }
+    QByteArray lines;
+    for (const QString &id : touched) {
+        Series &product = series[id];
+        const QByteArray key = id.toUtf8();
+        for (int i = product.logged; i < product.open.size(); ++i) {
+            lines += logLine(key, product.sealed + i, product.open.at(i));
+        }
+        product.logged = product.open.size();
+    }
+    if (log.write(lines) != lines.size() || !log.flush()) {
+        setError(errorMessage, "Could not write the stock history log.");
+        return false;
+    }
+    logSize += lines.size();
+    return true;
+}
+
+bool StockHistory::rewriteLog(QString *errorMessage)
+{
+    // Keep only movements that are not in a block yet.
+    QSaveFile log(logPath);
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        setError(errorMessage, "Could not write the stock history log.");
+        return false;
+    }
+    QByteArray lines;
+    for (auto it = series.constBegin(); it != series.constEnd(); ++it) {
+        const Series &product = it.value();
+        const QByteArray key = it.key().toUtf8();
+        for (int i = 0; i < product.logged; ++i) {
+            lines += logLine(key, product.sealed + i, product.open.at(i));
+        }
+    }
+    if (log.write(lines) != lines.size() || !log.commit()) {
+        setError(errorMessage, "Could not write the stock history log.");
+        return false;
+    }
+    logSize = lines.size();
+    logLimit = qMax(kLogCompactBytes, 2 * logSize);
+    return true;
+}
+
+bool StockHistory::seal(const QString &productId, Series *product, QString *errorMessage)
+{
+    // Timestamps as delta-of-deltas (steady sales rates cost a byte or so),
+    // then deltas with the reason in the low two bits, both as varints.
+    const int count = kBlockPoints;
+    QByteArray timestamps;
+    QByteArray deltas;
+    Block block;
+    block.firstTimestamp = product->open.first().timestamp;
+    block.lastTimestamp = product->open.at(count - 1).timestamp;
+    block.count = count;
+    qint64 previous = block.firstTimestamp;
+    qint64 step = 0;
+    for (int i = 0; i < count; ++i) {
+        const StockMovement &movement = product->open.at(i);
+        if (i > 0) {
+            const qint64 next = movement.timestamp - previous;
+            putVarint(&timestamps, zigzag(next - step));
+            step = next;
+            previous = movement.timestamp;
+        }
+        putVarint(&deltas, (zigzag(movement.delta) << 2) | movement.reason);
+        block.sold += soldIn(movement);
+        block.net += movement.delta;
+    }
+    block.timestampBytes = static_cast<quint32>(timestamps.size());
+    block.deltaBytes = static_cast<quint32>(deltas.size());
+
+    const QByteArray id = productId.toUtf8();
+    BlockHeader header;
+    header.idBytes = static_cast<quint32>(id.size());
+    header.count = static_cast<quint32>(count);
+    header.timestampBytes = block.timestampBytes;
+    header.deltaBytes = block.deltaBytes;
+    header.firstTimestamp = block.firstTimestamp;
+    header.lastTimestamp = block.lastTimestamp;
+    header.sold = block.sold;
+    header.net = block.net;
+    QByteArray bytes(reinterpret_cast<const char *>(&header), sizeof(header));
+    bytes += id + timestamps + deltas;
+
+    // Windows cannot grow or cut a mapped file; the next query maps it again.
+    if (mapped) {
+        blocksFile.unmap(mapped);
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+    if (!blocksFile.seek(blocksSize) || blocksFile.write(bytes) != bytes.size()) {
+        // Leave the file as it was; the movements stay in the log.
+        blocksFile.resize(blocksSize);
+        setError(errorMessage, "Could not write the stock history.");
+        return false;
+    }
+    block.offset = blocksSize + sizeof(header) + id.size();
+    blocksSize += bytes.size();
+    product->blocks.push_back(block);
+    product->open.remove(0, count);
+    product->logged -= count;
+    product->sealed += count;
+    return true;
+}
+
+QByteArray StockHistory::payload(const Block &block) const
+{
+    const qint64 size = block.timestampBytes + block.deltaBytes;
+    // Map the file once it has grown; fall back to plain reads.
+    if (mappedSize != blocksSize) {
+        if (mapped) {
+            blocksFile.unmap(mapped);
+        }
+        mapped = blocksFile.map(0, blocksSize);
+        mappedSize = mapped ? blocksSize : 0;
+    }
+    if (mapped) {
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(mapped + block.offset),
+                                       static_cast<int>(size));
+    }
+    if (!blocksFile.seek(block.offset)) {
+        return QByteArray();
+    }
+    return blocksFile.read(size);
+}
+
+void StockHistory::decode(const Block &block, QVector<StockMovement> *out) const
+{
+    const QByteArray bytes = payload(block);
+    if (bytes.size() != static_cast<int>(block.timestampBytes + block.deltaBytes)) {
+        return;
+    }
+    const uchar *at = reinterpret_cast<const uchar *>(bytes.constData());
+    const uchar *timestampsEnd = at + block.timestampBytes;
+    const uchar *deltasEnd = timestampsEnd + block.deltaBytes;
+    const uchar *deltaAt = timestampsEnd;
+
+    qint64 timestamp = block.firstTimestamp;
+    qint64 step = 0;
+    for (int i = 0; i < block.count; ++i) {
+        quint64 value = 0;
+        if (i > 0) {
+            if (!getVarint(&at, timestampsEnd, &value)) {
+                return;
+            }
+            step += unzigzag(value);
+            timestamp += step;
+        }
+        if (!getVarint(&deltaAt, deltasEnd, &value)) {
+            return;
+        }
+        StockMovement movement;
+        movement.timestamp = timestamp;
+        movement.reason = static_cast<StockMovement::Reason>(value & 3);
+        movement.delta = static_cast<int>(unzigzag(value >> 2));
+        out->push_back(movement);
+    }
+}
+
+QVector<StockMovement> StockHistory::movements(const QString &productId, qint64 from,
+                                               qint64 to) const
+{
+    QVector<StockMovement> out;
+    const auto found = series.constFind(productId);
+    if (found == series.constEnd()) {
+        return out;
+    }
+    const Series &product = found.value();
+    auto block = std::partition_point(product.blocks.begin(), product.blocks.end(),
+                                      [from](const Block &b) { return b.lastTimestamp < from; });
+    QVector<StockMovement> decoded;
+    for (; block != product.blocks.end() && block->firstTimestamp < to; ++block) {
+        decoded.clear();
+        decode(*block, &decoded);
+        for (const StockMovement &movement : decoded) {
+            if (movement.timestamp >= from && movement.timestamp < to) {
+                out.push_back(movement);
+            }
+        }
+    }
+    for (const StockMovement &movement : product.open) {
+        if (movement.timestamp >= from && movement.timestamp < to) {
+            out.push_back(movement);
+        }
+    }
+    return out;
+}
+
+void StockHistory::addSales(const Series &product, const QVector<qint64> &edges,
+                            QVector<qint64> *buckets) const
+{
+    const qint64 from = edges.first();
+    const qint64 to = edges.last();
+    auto block = std::partition_point(product.blocks.begin(), product.blocks.end(),
+                                      [from](const Block &b) { return b.lastTimestamp < from; });
+    QVector<StockMovement> decoded;
+    for (; block != product.blocks.end() && block->firstTimestamp < to; ++block) {
+        // A block inside one bucket is answered by its header alone.
+        const int first = bucketOf(edges, block->firstTimestamp);
+        if (first >= 0 && first == bucketOf(edges, block->lastTimestamp)) {
+            (*buckets)[first] += block->sold;
+            continue;
+        }
+        decoded.clear();
+        decode(*block, &decoded);
+        for (const StockMovement &movement : decoded) {
+            const int bucket = bucketOf(edges, movement.timestamp);
+            if (bucket >= 0) {
+                (*buckets)[bucket] += soldIn(movement);
+            }
+        }
+    }
+    for (const StockMovement &movement : product.open) {
+        const int bucket = bucketOf(edges, movement.timestamp);
+        if (bucket >= 0) {
+            (*buckets)[bucket] += soldIn(movement);
+        }
+    }
+}
+
+QVector<qint64> StockHistory::unitsSold(const QString &productId,
+                                        const QVector<qint64> &edges) const
+{
+    QVector<qint64> buckets(qMax(0, edges.size() - 1), 0);
+    const auto found = series.constFind(productId);
+    if (!buckets.isEmpty() && found != series.constEnd()) {
+        addSales(found.value(), edges, &buckets);
+    }
+    return buckets;
+}
+
+QVector<qint64> StockHistory::dailyUnitsSold(const QString &productId, const QDate &first,
+                                             int days) const
+{
+    // Local midnights, so days stay calendar days across clock changes.
+    QVector<qint64> edges;
+    edges.reserve(days + 1);
+    for (int day = 0; day <= days; ++day) {
+        edges.push_back(QDateTime(first.addDays(day), QTime(0, 0)).toMSecsSinceEpoch());
+    }
+    return unitsSold(productId, edges);
+}
+
+QVector<QPair<QString, qint64>> StockHistory::topSellers(qint64 from, qint64 to,
+                                                         int count) const
+{
+    Trace::Span span("StockHistory::topSellers");
+    const QVector<qint64> edges = {from, to};
+    QVector<QPair<QString, qint64>> sellers;
+    for (auto it = series.constBegin(); it != series.constEnd(); ++it) {
+        QVector<qint64> sold(1, 0);
+        addSales(it.value(), edges, &sold);
+        if (sold.first() > 0) {
+            sellers.push_back(qMakePair(it.key(), sold.first()));
+        }
+    }
+    const int shown = qMin(qMax(0, count), sellers.size());
+    std::partial_sort(sellers.begin(), sellers.begin() + shown, sellers.end(),
+                      [](const QPair<QString, qint64> &a, const QPair<QString, qint64> &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    sellers.resize(shown);
+    return sellers;
+}
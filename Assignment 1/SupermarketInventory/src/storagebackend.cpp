@@ -0,0 +1,15 @@
+#include "storagebackend.h"
+
+namespace {
+StorageBackend *installed = nullptr;
+}
+
+StorageBackend *StorageBackend::current()
+{
+    return installed;
+}
+
+void StorageBackend::setCurrent(StorageBackend *backend)
+{
+    installed = backend;
+}
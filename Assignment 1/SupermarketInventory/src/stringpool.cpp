@@ -0,0 +1,216 @@
+#include "stringpool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Compact once this many dead characters pile up (and they make up at
+// least half of the arena).
+const int kCompactThreshold = 64 * 1024;
+// Smallest index; it doubles whenever it would pass half full.
+const int kMinSlots = 16;
+
+quint32 hashText(const QChar *data, int size)
+{
+    // FNV-1a over UTF-16 code units.
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < size; ++i) {
+        hash = (hash ^ data[i].unicode()) * 16777619u;
+    }
+    return hash;
+}
+}
+
+void StringPool::clear()
+{
+    arena.clear();
+    entries.clear();
+    freeHandles.clear();
+    slots.clear();
+    live = 0;
+    garbage = 0;
+}
+
+quint32 StringPool::intern(const QString &value)
+{
+    const quint32 hash = hashText(value.constData(), value.size());
+    const int slot = findSlot(value.constData(), value.size(), hash);
+    if (slot >= 0 && slots.at(slot) >= 0) {
+        const quint32 handle = static_cast<quint32>(slots.at(slot));
+        ++entries[handle].refs;
+        return handle;
+    }
+
+    Entry entry;
+    entry.offset = static_cast<quint32>(arena.size());
+    entry.length = static_cast<quint32>(value.size());
+    entry.refs = 1;
+    entry.hash = hash;
+    arena.append(value);
+
+    quint32 handle;
+    if (!freeHandles.isEmpty()) {
+        handle = freeHandles.takeLast();
+        entries[handle] = entry;
+    } else {
+        handle = static_cast<quint32>(entries.size());
+        entries.push_back(entry);
+    }
+    ++live;
+
+    // Keep the index at most half full so probes stay short.
+    if (live * 2 > slots.size()) {
+        rehash(live * 2);
+    } else {
+        const int mask = slots.size() - 1;
+        int empty = static_cast<int>(hash) & mask;
+        while (slots.at(empty) >= 0) {
+            empty = (empty + 1) & mask;
+        }
+        slots[empty] = static_cast<qint32>(handle);
+    }
+    return handle;
+}
+
+int StringPool::find(const QString &value) const
+{
+    const int slot = findSlot(value.constData(), value.size(),
+                              hashText(value.constData(), value.size()));
+    return slot >= 0 ? slots.at(slot) : -1;
+}
+
+void StringPool::release(quint32 handle)
+{
+    Entry &entry = entries[handle];
+    if (--entry.refs > 0) {
+        return;
+    }
+    unindex(handle);
+    garbage += static_cast<int>(entry.length);
+    entry.length = 0;
+    freeHandles.push_back(handle);
+    --live;
+    if (garbage >= kCompactThreshold && garbage * 2 >= arena.size()) {
+        compact();
+    }
+}
+
+QString StringPool::text(quint32 handle) const
+{
+    const Entry &entry = entries.at(handle);
+    return QString::fromRawData(arena.constData() + entry.offset,
+                                static_cast<int>(entry.length));
+}
+
+int StringPool::length(quint32 handle) const
+{
+    return static_cast<int>(entries.at(handle).length);
+}
+
+int StringPool::compare(quint32 a, quint32 b) const
+{
+    if (a == b) {
+        return 0;
+    }
+    const Entry &x = entries.at(a);
+    const Entry &y = entries.at(b);
+    const QChar *base = arena.constData();
+    const quint32 common = std::min(x.length, y.length);
+    for (quint32 i = 0; i < common; ++i) {
+        const ushort l = base[x.offset + i].unicode();
+        const ushort r = base[y.offset + i].unicode();
+        if (l != r) {
+            return l < r ? -1 : 1;
+        }
+    }
+    return x.length < y.length ? -1 : (y.length < x.length ? 1 : 0);
+}
+
+int StringPool::count() const
+{
+    return live;
+}
+
+void StringPool::compact()
+{
+    if (garbage == 0) {
+        return;
+    }
+    QString compacted;
+    compacted.reserve(arena.size() - garbage);
+    for (Entry &entry : entries) {
+        if (entry.refs == 0) {
+            continue;
+        }
+        const quint32 offset = static_cast<quint32>(compacted.size());
+        compacted.append(arena.constData() + entry.offset, static_cast<int>(entry.length));
+        entry.offset = offset;
+    }
+    arena = compacted;
+    garbage = 0;
+}
+
+int StringPool::findSlot(const QChar *data, int size, quint32 hash) const
+{
+    // Slot holding the string, or the empty slot where it would go.
+    if (slots.isEmpty()) {
+        return -1;
+    }
+    const int mask = slots.size() - 1;
+    for (int slot = static_cast<int>(hash) & mask; ; slot = (slot + 1) & mask) {
+        const qint32 handle = slots.at(slot);
+        if (handle < 0) {
+            return slot;
+        }
+        const Entry &entry = entries.at(handle);
+        if (entry.hash == hash && entry.length == static_cast<quint32>(size) &&
+            std::memcmp(arena.constData() + entry.offset, data, sizeof(QChar) * size) == 0) {
+            return slot;
+        }
+    }
+}
+
+void StringPool::rehash(int capacity)
+{
+    int size = kMinSlots;
+    while (size < capacity) {
+        size *= 2;
+    }
+    slots.fill(-1, size);
+    const int mask = size - 1;
+    for (int handle = 0; handle < entries.size(); ++handle) {
+        if (entries.at(handle).refs == 0) {
+            continue;
+        }
+        int slot = static_cast<int>(entries.at(handle).hash) & mask;
+        while (slots.at(slot) >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = handle;
+    }
+}
+
+void StringPool::unindex(quint32 handle)
+{
+    const int mask = slots.size() - 1;
+    int hole = static_cast<int>(entries.at(handle).hash) & mask;
+    while (slots.at(hole) != static_cast<qint32>(handle)) {
+        hole = (hole + 1) & mask;
+    }
+
+    // Backward-shift deletion: later entries of the probe run move into the
+    // hole unless their home slot lies between it and them, so lookups never
+    // meet a tombstone.
+    slots[hole] = -1;
+    for (int next = (hole + 1) & mask; slots.at(next) >= 0; next = (next + 1) & mask) {
+        const int home = static_cast<int>(entries.at(slots.at(next)).hash) & mask;
+        const bool stays = hole <= next ? (hole < home && home <= next)
+                                        : (hole < home || home <= next);
+        if (stays) {
+            continue;
+        }
+        slots[hole] = slots.at(next);
+        slots[next] = -1;
+        hole = next;
+    }
+}
@@ -0,0 +1,199 @@
+#include "trace.h"
+
+#include "appdata.h"
+#include <QDateTime>
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QVector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace {
+// Spans kept per thread (about 400 KB each).
+const int kRingSize = 16384;
+
+struct Event {
+    const char *name;
+    qint64 start;
+    qint64 end;
+};
+
+// Written only by its owning thread; head counts every span ever recorded,
+// so slot head % kRingSize is the next one to be overwritten.
+struct Ring {
+    Event events[kRingSize];
+    std::atomic<quint64> head{0};
+    int tid = 0;
+};
+
+// Rings of every thread that has traced. A thread takes a ring on its first
+// span and hands it back when it exits, so worker threads that come and go
+// reuse rings (and their spans stay readable).
+struct Registry {
+    QMutex mutex;
+    QVector<Ring *> rings;
+    QVector<Ring *> spare;
+};
+
+Registry &registry()
+{
+    // Leaked on purpose: threads may still trace during static destruction.
+    static Registry *instance = new Registry;
+    return *instance;
+}
+
+// Start of the current recording; spans from before it are skipped.
+std::atomic<qint64> since{0};
+
+class RingOwner
+{
+public:
+    ~RingOwner()
+    {
+        if (ring) {
+            Registry &reg = registry();
+            QMutexLocker lock(&reg.mutex);
+            reg.spare.push_back(ring);
+        }
+    }
+
+    Ring *get()
+    {
+        if (!ring) {
+            Registry &reg = registry();
+            QMutexLocker lock(&reg.mutex);
+            if (!reg.spare.isEmpty()) {
+                ring = reg.spare.takeLast();
+            } else {
+                ring = new Ring;
+                ring->tid = reg.rings.size() + 1;
+                reg.rings.push_back(ring);
+            }
+        }
+        return ring;
+    }
+
+private:
+    Ring *ring = nullptr;
+};
+
+thread_local RingOwner owner;
+
+// Copy the spans of ring that started at or after from. A span the writer
+// overwrote while it was being copied is dropped rather than reported torn.
+void collect(const Ring &ring, qint64 from, QVector<Event> *out)
+{
+    const quint64 head = ring.head.load(std::memory_order_acquire);
+    const quint64 first = head > quint64(kRingSize) ? head - kRingSize : 0;
+    const int mark = out->size();
+    for (quint64 i = first; i < head; ++i) {
+        out->push_back(ring.events[i % kRingSize]);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const quint64 after = ring.head.load(std::memory_order_relaxed);
+    // The writer may be filling slot "after", which held span after - kRingSize.
+    const quint64 valid = after >= quint64(kRingSize) ? after - kRingSize + 1 : 0;
+    const int stale = valid > first ? static_cast<int>(std::min(valid, head) - first) : 0;
+    out->remove(mark, stale);
+
+    auto early = std::remove_if(out->begin() + mark, out->end(),
+                                [from](const Event &event) { return event.start < from; });
+    out->erase(early, out->end());
+}
+
+void appendJsonEvent(QByteArray *json, const Event &event, int tid, qint64 origin)
+{
+    // Chrome wants microseconds; keep nanosecond precision in the fraction.
+    *json += "{\"name\":\"";
+    *json += event.name;
+    *json += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+    *json += QByteArray::number(tid);
+    *json += ",\"ts\":";
+    *json += QByteArray::number((event.start - origin) / 1000.0, 'f', 3);
+    *json += ",\"dur\":";
+    *json += QByteArray::number((event.end - event.start) / 1000.0, 'f', 3);
+    *json += '}';
+}
+}
+
+namespace Trace {
+
+namespace Detail {
+
+QAtomicInt enabled;
+
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void record(const char *name, qint64 start, qint64 end)
+{
+    Ring *ring = owner.get();
+    const quint64 head = ring->head.load(std::memory_order_relaxed);
+    Event &event = ring->events[head % kRingSize];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+}
+
+void setEnabled(bool enabled)
+{
+    if (enabled && !isEnabled()) {
+        since.store(Detail::now(), std::memory_order_relaxed);
+    }
+    Detail::enabled.storeRelaxed(enabled ? 1 : 0);
+}
+
+bool writeJson(const QString &path, QString *errorMessage)
+{
+    const qint64 from = since.load(std::memory_order_relaxed);
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"args\":{\"name\":\"SupermarketInventory\"}}";
+    {
+        Registry &reg = registry();
+        QMutexLocker lock(&reg.mutex);
+        QVector<Event> events;
+        for (const Ring *ring : reg.rings) {
+            events.clear();
+            collect(*ring, from, &events);
+            for (const Event &event : events) {
+                json += ",\n";
+                appendJsonEvent(&json, event, ring->tid, from);
+            }
+        }
+    }
+    json += "]}\n";
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        if (errorMessage) {
+            *errorMessage = "Could not write trace file.";
+        }
+        return false;
+    }
+    if (!file.commit()) {
+        if (errorMessage) {
+            *errorMessage = "Could not finalize trace file.";
+        }
+        return false;
+    }
+    return true;
+}
+
+QString defaultPath()
+{
+    return AppData::dataDir() + QDir::separator() + "trace-" +
+           QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+}
+
+}
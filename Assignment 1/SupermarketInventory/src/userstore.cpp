@@ -1,9 +1,17 @@
 #include "userstore.h"
 
 #include "appdata.h"
+#include "storagebackend.h"
+#include <QAtomicInt>
 #include <QCryptographicHash>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QLockFile>
+#include <QMessageAuthenticationCode>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QRandomGenerator>
 #include <QSaveFile>
 #include <QTextStream>
@@ -11,11 +19,64 @@
 
 namespace {
 
-// Hash a password with a provided salt (simple SHA-256 for this app).
-QByteArray hashPassword(const QString &password, const QByteArray &salt)
+// First line of users.csv.
+const char kUsersHeader[] = "username,salt,hash,role,iterations\n";
+
+// Bounds for the KDF work factor (also applied to counts read from disk).
+const int kMinIterations = 10000;
+const int kMaxIterations = 10000000;
+// Iterations timed by calibrateWorkFactor.
+const int kCalibrationIterations = 4096;
+// How long a change to users.csv waits for another process's change.
+const int kUsersLockWaitMs = 5000;
+// A stored hash is only redone once its count is below the work factor
+// divided by this, so calibration noise between starts never triggers it.
+const int kUpgradeDivisor = 2;
+
+// Work factor for new hashes; replaced by calibrateWorkFactor.
+QAtomicInt currentWorkFactor(100000);
+
+// PBKDF2-HMAC-SHA256 with a single 32-byte output block.
+QByteArray pbkdf2(const QByteArray &password, const QByteArray &salt, int iterations)
+{
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, password);
+    mac.addData(salt);
+    mac.addData("\0\0\0\1", 4);
+    QByteArray block = mac.result();
+    QByteArray derived = block;
+    for (int i = 1; i < iterations; ++i) {
+        mac.reset();
+        mac.addData(block);
+        block = mac.result();
+        for (int j = 0; j < derived.size(); ++j) {
+            derived[j] = static_cast<char>(derived[j] ^ block[j]);
+        }
+    }
+    return derived;
+}
+
+// Hash a password with a provided salt. Records with no work factor predate
+// the KDF and use a single salted SHA-256.
+QByteArray hashPassword(const QString &password, const QByteArray &salt, int iterations)
 {
-    return QCryptographicHash::hash(salt + password.toUtf8(),
-                                    QCryptographicHash::Sha256);
+    if (iterations <= 0) {
+        return QCryptographicHash::hash(salt + password.toUtf8(),
+                                        QCryptographicHash::Sha256);
+    }
+    return pbkdf2(password.toUtf8(), salt, iterations);
+}
+
+// Compare digests without stopping at the first difference.
+bool sameDigest(const QByteArray &a, const QByteArray &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    char diff = 0;
+    for (int i = 0; i < a.size(); ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
 }
 
 // Generate a random salt.
@@ -62,9 +123,200 @@ bool parseUserRecord(const QString &line, UserStore::UserRecord *out)
         const QString role = parts[3].trimmed().toLower();
         out->isAdmin = (role == "admin" || role == "true" || role == "1");
     }
+    out->iterations = 0;
+    if (parts.size() >= 5) {
+        bool ok = false;
+        const int iterations = parts[4].trimmed().toInt(&ok);
+        if (!ok || iterations < 0 || iterations > kMaxIterations) {
+            return false;
+        }
+        out->iterations = iterations;
+    }
     return !out->salt.isEmpty() && !out->hash.isEmpty();
 }
 
+// Read every valid record from path.
+bool readUsers(const QString &path, QVector<UserStore::UserRecord> *records,
+               QString *errorMessage)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (errorMessage) {
+            *errorMessage = "Could not open users file.";
+        }
+        return false;
+    }
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        UserStore::UserRecord record;
+        if (parseUserRecord(in.readLine(), &record)) {
+            records->push_back(record);
+        }
+    }
+    return true;
+}
+
+QString formatUserRecord(const UserStore::UserRecord &record)
+{
+    const QString role = record.isAdmin ? "admin" : "user";
+    return record.username + "," + QString::fromLatin1(record.salt.toHex()) + "," +
+           QString::fromLatin1(record.hash.toHex()) + "," + role + "," +
+           QString::number(record.iterations) + "\n";
+}
+
+// Held around every change to users.csv, so one process never rewrites it
+// over a line another has just appended.
+QString usersLockPath()
+{
+    return AppData::usersFilePath() + ".lock";
+}
+
+// Cached users.csv: records, first record per username, admin count, and
+// the file stamp the cache was built from (or, with a storage backend,
+// whether it has been loaded at all).
+struct Directory {
+    QMutex lock;
+    QVector<UserStore::UserRecord> records;
+    QHash<QString, int> byName;
+    int admins = 0;
+    qint64 size = -2;
+    qint64 modified = -2;
+    bool loaded = false;
+};
+
+Directory &directory()
+{
+    static Directory instance;
+    return instance;
+}
+
+// Add a record to the cache (caller holds the lock).
+void cacheRecord(Directory &dir, const UserStore::UserRecord &record)
+{
+    if (dir.byName.contains(record.username)) {
+        return;
+    }
+    dir.byName.insert(record.username, dir.records.size());
+    dir.records.push_back(record);
+    if (record.isAdmin) {
+        ++dir.admins;
+    }
+}
+
+// Replace the cache contents (caller holds the lock).
+void cacheRecords(Directory &dir, const QVector<UserStore::UserRecord> &records)
+{
+    dir.records.clear();
+    dir.byName.clear();
+    dir.admins = 0;
+    dir.records.reserve(records.size());
+    dir.byName.reserve(records.size());
+    for (const UserStore::UserRecord &record : records) {
+        cacheRecord(dir, record);
+    }
+}
+
+// Rewrite users.csv with records.
+bool writeUsers(const QVector<UserStore::UserRecord> &records, QString *errorMessage)
+{
+    QString dirError;
+    if (!AppData::ensureDataDir(&dirError)) {
+        if (errorMessage) {
+            *errorMessage = dirError;
+        }
+        return false;
+    }
+
+    QSaveFile file(UserStore::primaryPath());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (errorMessage) {
+            *errorMessage = "Could not write users file.";
+        }
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << kUsersHeader;
+    for (const UserStore::UserRecord &record : records) {
+        out << formatUserRecord(record);
+    }
+
+    if (!file.commit()) {
+        if (errorMessage) {
+            *errorMessage = "Could not finalize users file.";
+        }
+        return false;
+    }
+    return true;
+}
+
+// Legacy hashes, and ones well below the current work factor.
+bool underStrength(int iterations)
+{
+    return iterations < kMinIterations ||
+           iterations < currentWorkFactor.loadRelaxed() / kUpgradeDivisor;
+}
+
+// Re-hash a record that was just verified with the current work factor and
+// write it back. Failures, or a record changed meanwhile, leave the old
+// hash in place.
+void upgradeRecord(const UserStore::UserRecord &verified, const QString &password)
+{
+    const int iterations = currentWorkFactor.loadRelaxed();
+    UserStore::UserRecord upgraded;
+    upgraded.salt = randomSalt();
+    upgraded.hash = hashPassword(password, upgraded.salt, iterations);
+    upgraded.iterations = iterations;
+
+    StorageBackend *backend = StorageBackend::current();
+    QLockFile fileLock(usersLockPath());
+    if (!backend && !fileLock.tryLock(kUsersLockWaitMs)) {
+        return;
+    }
+    Directory &dir = directory();
+    QMutexLocker locker(&dir.lock);
+    // The file is rewritten whole, so first pick up users another process
+    // (a second window or the batch tool) added since it was last read.
+    if (!backend) {
+        qint64 size = 0;
+        qint64 modified = 0;
+        AppData::fileStamp(UserStore::primaryPath(), &size, &modified);
+        if (size != dir.size || modified != dir.modified) {
+            QVector<UserStore::UserRecord> records;
+            if (size < 0 || !readUsers(UserStore::primaryPath(), &records, nullptr)) {
+                return;
+            }
+            cacheRecords(dir, records);
+            dir.size = size;
+            dir.modified = modified;
+        }
+    }
+    const auto it = dir.byName.constFind(verified.username);
+    if (it == dir.byName.constEnd()) {
+        return;
+    }
+    UserStore::UserRecord &record = dir.records[it.value()];
+    if (record.salt != verified.salt || record.hash != verified.hash) {
+        return;
+    }
+    const UserStore::UserRecord previous = record;
+    upgraded.username = record.username;
+    upgraded.isAdmin = record.isAdmin;
+    record = upgraded;
+    if (backend) {
+        if (!backend->updateUser(record, nullptr)) {
+            record = previous;
+        }
+        return;
+    }
+    if (!writeUsers(dir.records, nullptr)) {
+        record = previous;
+        return;
+    }
+    AppData::fileStamp(UserStore::primaryPath(), &dir.size, &dir.modified);
+}
+
 }
 
 namespace UserStore {
@@ -89,120 +341,204 @@ bool loadUsersIfExists(QVector<UserRecord> *records, QString *errorMessage, QStr
     if (!QFileInfo::exists(pathToOpen)) {
         return true;
     }
-    //open file
     if (pathUsed) {
         *pathUsed = pathToOpen;
     }
-    //read each line
-    QFile file(pathToOpen);
-    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        if (errorMessage) {
-            *errorMessage = "Could not open users file.";
-        }
-        return false;
-    }
+    return readUsers(pathToOpen, records, errorMessage);
+}
 
-    QTextStream in(&file);
-    while(!in.atEnd()) {
-        UserRecord record;
-        const QString line = in.readLine();
-        if (!parseUserRecord(line, &record)) {
-            continue;
-        }
-        records->push_back(record);
+bool saveUsers(const QVector<UserRecord> &records, QString *errorMessage)
+{
+    if (!writeUsers(records, errorMessage)) {
+        return false;
     }
 
-    file.close();
+    // The cache now matches what was written.
+    Directory &dir = directory();
+    QMutexLocker locker(&dir.lock);
+    cacheRecords(dir, records);
+    AppData::fileStamp(primaryPath(), &dir.size, &dir.modified);
     return true;
 }
 
-bool saveUsers(const QVector<UserRecord> &records, QString *errorMessage)
+bool refresh(QString *errorMessage)
 {
-    QString dirError;
-    if (!AppData::ensureDataDir(&dirError)) {
-        if (errorMessage) {
-            *errorMessage = dirError;
-        }
-        return false;
-    }
+    Directory &dir = directory();
+    QMutexLocker locker(&dir.lock);
 
-    QSaveFile file(primaryPath());
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        if (errorMessage) {
-            *errorMessage = "Could not write users file.";
+    if (StorageBackend *backend = StorageBackend::current()) {
+        if (dir.loaded && !backend->usersChanged()) {
+            return true;
         }
-        return false;
+        QVector<UserRecord> records;
+        if (!backend->loadUsers(&records, errorMessage)) {
+            return false;
+        }
+        cacheRecords(dir, records);
+        dir.loaded = true;
+        return true;
     }
 
-    QTextStream out(&file);
-    out << "username,salt,hash,role\n";
-    for (const UserRecord &record : records) {
-        const QString role = record.isAdmin ? "admin" : "user";
-        out << record.username << "," << record.salt.toHex() << "," << record.hash.toHex()
-            << "," << role << "\n";
+    qint64 size = 0;
+    qint64 modified = 0;
+    AppData::fileStamp(primaryPath(), &size, &modified);
+    if (size == dir.size && modified == dir.modified) {
+        return true;
     }
 
-    if (!file.commit()) {
-        if (errorMessage) {
-            *errorMessage = "Could not finalize users file.";
-        }
+    QVector<UserRecord> records;
+    if (size >= 0 && !readUsers(primaryPath(), &records, errorMessage)) {
         return false;
     }
+    cacheRecords(dir, records);
+    dir.size = size;
+    dir.modified = modified;
     return true;
 }
-//loop through and find username and password
-bool verifyUser(const QVector<UserRecord> &records,
-                const QString &username,
-                const QString &password,
-                bool *isAdmin)
+
+bool hasUsers()
+{
+    Directory &dir = directory();
+    QMutexLocker locker(&dir.lock);
+    return !dir.records.isEmpty();
+}
+
+bool usernameExists(const QString &username)
+{
+    Directory &dir = directory();
+    QMutexLocker locker(&dir.lock);
+    return dir.byName.contains(username);
+}
+
+bool anyAdmin()
+{
+    Directory &dir = directory();
+    QMutexLocker locker(&dir.lock);
+    return dir.admins > 0;
+}
+
+bool verifyUser(const QString &username, const QString &password, bool *isAdmin)
 {
     if (isAdmin) {
         *isAdmin = false;
     }
 
-    for (const UserRecord &record : records) {
-        if (record.username != username) {
-            continue;
-        }
-        const QByteArray computed = hashPassword(password, record.salt);
-        if (computed == record.hash) {
-            if (isAdmin) {
-                *isAdmin = record.isAdmin;
-            }
-            return true;
+    // Copy the record out so hashing does not hold the lock.
+    UserRecord record;
+    {
+        Directory &dir = directory();
+        QMutexLocker locker(&dir.lock);
+        const auto it = dir.byName.constFind(username);
+        if (it == dir.byName.constEnd()) {
+            return false;
         }
+        record = dir.records.at(it.value());
+    }
+
+    if (!sameDigest(hashPassword(password, record.salt, record.iterations), record.hash)) {
+        return false;
+    }
+    if (isAdmin) {
+        *isAdmin = record.isAdmin;
+    }
+    // Legacy and clearly under-strength hashes move to the current work
+    // factor; ones near it are left alone.
+    if (underStrength(record.iterations)) {
+        upgradeRecord(record, password);
     }
-    return false;
+    return true;
 }
 
-bool usernameExists(const QVector<UserRecord> &records, const QString &username)
+bool addUser(const UserRecord &record, QString *errorMessage)
 {
-    for (const UserRecord &record : records) {
-        if (record.username == username) {
-            return true;
+    if (!AppData::ensureDataDir(errorMessage)) {
+        return false;
+    }
+    // Another process's signup lands before the name check, not after it.
+    QLockFile fileLock(usersLockPath());
+    if (!StorageBackend::current() && !fileLock.tryLock(kUsersLockWaitMs)) {
+        if (errorMessage) {
+            *errorMessage = "The users file is busy; try again.";
         }
+        return false;
+    }
+    if (!refresh(errorMessage)) {
+        return false;
     }
-    return false;
-}
 
-bool anyAdmin(const QVector<UserRecord> &records)
-{
-    for (const UserRecord &record : records) {
-        if (record.isAdmin) {
-            return true;
+    Directory &dir = directory();
+    QMutexLocker locker(&dir.lock);
+    if (dir.byName.contains(record.username)) {
+        if (errorMessage) {
+            *errorMessage = "Username already exists.";
         }
+        return false;
+    }
+
+    // A backend stores the one record in its own transaction.
+    if (StorageBackend *backend = StorageBackend::current()) {
+        if (!backend->addUser(record, errorMessage)) {
+            return false;
+        }
+        cacheRecord(dir, record);
+        return true;
     }
-    return false;
-}
 
+    // Append one line instead of rewriting the file; a new file gets the
+    // header, and a last line missing its newline is terminated first.
+    QFile file(primaryPath());
+    if (!file.open(QIODevice::ReadWrite)) {
+        if (errorMessage) {
+            *errorMessage = "Could not write users file.";
+        }
+        return false;
+    }
+    QByteArray line;
+    if (file.size() == 0) {
+        line = kUsersHeader;
+    } else if (file.seek(file.size() - 1) && file.read(1) != "\n") {
+        line = "\n";
+    }
+    line += formatUserRecord(record).toUtf8();
+    if (!file.seek(file.size()) || file.write(line) != line.size() || !file.flush()) {
+        if (errorMessage) {
+            *errorMessage = "Could not save user.";
+        }
+        return false;
+    }
+    file.close();
+
+    cacheRecord(dir, record);
+    AppData::fileStamp(primaryPath(), &dir.size, &dir.modified);
+    return true;
+}
 UserRecord createUser(const QString &username, const QString &password, bool isAdmin)
 {
     UserRecord record;
     record.username = username;
     record.salt = randomSalt();
-    record.hash = hashPassword(password, record.salt);
+    record.iterations = workFactor();
+    record.hash = hashPassword(password, record.salt, record.iterations);
     record.isAdmin = isAdmin;
     return record;
 }
 
+int calibrateWorkFactor(int budgetMs)
+{
+    // Time a short run and scale it up to the budget.
+    QElapsedTimer timer;
+    timer.start();
+    pbkdf2("calibration", "calibration-salt", kCalibrationIterations);
+    const qint64 elapsedNs = qMax<qint64>(1, timer.nsecsElapsed());
+    const qint64 wanted = qint64(budgetMs) * 1000000 * kCalibrationIterations / elapsedNs;
+    const int iterations = static_cast<int>(qBound<qint64>(kMinIterations, wanted, kMaxIterations));
+    currentWorkFactor.storeRelaxed(iterations);
+    return iterations;
+}
+
+int workFactor()
+{
+    return currentWorkFactor.loadRelaxed();
+}
+
 }
@@ -0,0 +1,211 @@
+#include "inventoryjournal.h"
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+Product product(const QString &id, int quantity)
+{
+    Product result;
+    result.id = id;
+    result.name = "Item " + id;
+    result.price = Money::fromCents(250);
+    result.quantity = quantity;
+    return result;
+}
+
+bool writeFile(const QString &path, const QByteArray &contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+           file.write(contents) == contents.size();
+}
+
+QStringList keys(const QVector<JournalEntry> &entries)
+{
+    QStringList result;
+    for (const JournalEntry &entry : entries) {
+        result.push_back(entry.key);
+    }
+    return result;
+}
+}
+
+class InventoryJournalTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void replaysEntries();
+    void dropsTornLine();
+    void discardsJournalOfOlderCsv();
+    void checkpointKeepsOnlyLaterEdits();
+    void failedCheckpointKeepsEverything();
+    void interruptedCheckpointIsFoldedIn();
+
+private:
+    QString csvPath() const { return dir->filePath("inventory.csv"); }
+    QString journalPath() const { return dir->filePath("inventory.journal"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void InventoryJournalTest::initTestCase()
+{
+    // Rewrites make sure the data folder exists; keep that out of the real one.
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void InventoryJournalTest::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvPath(), "id,name,price,quantity\n"));
+}
+
+void InventoryJournalTest::replaysEntries()
+{
+    QString error;
+    {
+        InventoryJournal journal(journalPath());
+        QVector<JournalEntry> entries;
+        QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+        QVERIFY(entries.isEmpty());
+        QVERIFY(journal.logAdd(product("A1", 5)));
+        QVERIFY(journal.logUpdate("A1", product("A2", 7)));
+        QVERIFY(journal.logUpserts({product("B1", 1), product("C1", 2)}));
+        QVERIFY(journal.logDeletes({"B1"}));
+        QVERIFY(journal.logDelete("C1"));
+        QCOMPARE(journal.entryCount(), 6);
+    }
+
+    InventoryJournal journal(journalPath());
+    QVector<JournalEntry> entries;
+    QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+    QCOMPARE(keys(entries), QStringList({"A1", "A1", "B1", "C1", "B1", "C1"}));
+    QCOMPARE(entries.at(0).op, JournalEntry::Add);
+    QCOMPARE(entries.at(1).op, JournalEntry::Update);
+    QCOMPARE(entries.at(1).product.id, QString("A2"));
+    QCOMPARE(entries.at(1).product.quantity, 7);
+    QCOMPARE(entries.at(1).product.price, Money::fromCents(250));
+    QCOMPARE(entries.at(4).op, JournalEntry::Delete);
+    QCOMPARE(entries.at(5).op, JournalEntry::Delete);
+}
+
+void InventoryJournalTest::dropsTornLine()
+{
+    QString error;
+    {
+        InventoryJournal journal(journalPath());
+        QVERIFY2(journal.open(csvPath(), nullptr, &error), qPrintable(error));
+        QVERIFY(journal.logAdd(product("A1", 5)));
+    }
+    // A crash in the middle of an append leaves a line without its newline.
+    QFile file(journalPath());
+    QVERIFY(file.open(QIODevice::Append));
+    file.write("A,B1,Item");
+    file.close();
+
+    InventoryJournal journal(journalPath());
+    QVector<JournalEntry> entries;
+    QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+    QCOMPARE(keys(entries), QStringList({"A1"}));
+    // The journal was rewritten clean, so later appends replay too.
+    QVERIFY(journal.logAdd(product("C1", 1)));
+    InventoryJournal reopened(journalPath());
+    QVERIFY2(reopened.open(csvPath(), &entries, &error), qPrintable(error));
+    QCOMPARE(keys(entries), QStringList({"A1", "C1"}));
+}
+
+void InventoryJournalTest::discardsJournalOfOlderCsv()
+{
+    QString error;
+    {
+        InventoryJournal journal(journalPath());
+        QVERIFY2(journal.open(csvPath(), nullptr, &error), qPrintable(error));
+        QVERIFY(journal.logAdd(product("A1", 5)));
+    }
+    // A CSV written since then already holds the edits.
+    QVERIFY(writeFile(csvPath(), "id,name,price,quantity\nA1,Item A1,2.50,5\n"));
+
+    InventoryJournal journal(journalPath());
+    QVector<JournalEntry> entries;
+    QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+    QVERIFY(entries.isEmpty());
+}
+
+void InventoryJournalTest::checkpointKeepsOnlyLaterEdits()
+{
+    QString error;
+    {
+        InventoryJournal journal(journalPath());
+        QVERIFY2(journal.open(csvPath(), nullptr, &error), qPrintable(error));
+        QVERIFY(journal.logAdd(product("A1", 5)));
+        QVERIFY2(journal.beginCheckpoint(&error), qPrintable(error));
+        // Made while the CSV is being written, so not in it.
+        QVERIFY(journal.logAdd(product("B1", 3)));
+        QVERIFY(writeFile(csvPath(), "id,name,price,quantity\nA1,Item A1,2.50,5\n"));
+        QVERIFY2(journal.finishCheckpoint(csvPath(), true, &error), qPrintable(error));
+        QCOMPARE(journal.entryCount(), 1);
+        QVERIFY(journal.logAdd(product("C1", 1)));
+    }
+    QVERIFY(!QFile::exists(journalPath() + ".pending"));
+
+    InventoryJournal journal(journalPath());
+    QVector<JournalEntry> entries;
+    QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+    QCOMPARE(keys(entries), QStringList({"B1", "C1"}));
+}
+
+void InventoryJournalTest::failedCheckpointKeepsEverything()
+{
+    QString error;
+    {
+        InventoryJournal journal(journalPath());
+        QVERIFY2(journal.open(csvPath(), nullptr, &error), qPrintable(error));
+        QVERIFY(journal.logAdd(product("A1", 5)));
+        QVERIFY2(journal.beginCheckpoint(&error), qPrintable(error));
+        QVERIFY(journal.logAdd(product("B1", 3)));
+        QVERIFY2(journal.finishCheckpoint(csvPath(), false, &error), qPrintable(error));
+        QCOMPARE(journal.entryCount(), 2);
+    }
+
+    InventoryJournal journal(journalPath());
+    QVector<JournalEntry> entries;
+    QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+    QCOMPARE(keys(entries), QStringList({"A1", "B1"}));
+}
+
+void InventoryJournalTest::interruptedCheckpointIsFoldedIn()
+{
+    QString error;
+    {
+        InventoryJournal journal(journalPath());
+        QVERIFY2(journal.open(csvPath(), nullptr, &error), qPrintable(error));
+        QVERIFY(journal.logAdd(product("A1", 5)));
+        QVERIFY2(journal.beginCheckpoint(&error), qPrintable(error));
+        QVERIFY(journal.logAdd(product("B1", 3)));
+        // The save never finishes: the CSV is unchanged and the pending
+        // segment is left behind.
+    }
+    QVERIFY(QFile::exists(journalPath() + ".pending"));
+
+    QVector<JournalEntry> entries;
+    {
+        InventoryJournal journal(journalPath());
+        QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+        QCOMPARE(keys(entries), QStringList({"A1", "B1"}));
+    }
+    QVERIFY(!QFile::exists(journalPath() + ".pending"));
+
+    // Folding it in is done once.
+    InventoryJournal journal(journalPath());
+    QVERIFY2(journal.open(csvPath(), &entries, &error), qPrintable(error));
+    QCOMPARE(keys(entries), QStringList({"A1", "B1"}));
+}
+
+QTEST_GUILESS_MAIN(InventoryJournalTest)
+#include "tst_inventoryjournal.moc"
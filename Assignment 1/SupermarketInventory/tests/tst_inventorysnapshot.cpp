@@ -0,0 +1,141 @@
+#include "inventorysnapshot.h"
+#include "productstore.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+// Header size, from the layout in inventorysnapshot.h.
+const int kHeaderBytes = 64;
+
+bool writeFile(const QString &path, const QByteArray &contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+           file.write(contents) == contents.size();
+}
+
+ProductStore sampleProducts()
+{
+    ProductStore products;
+    const QStringList names = {"Apples", QString::fromUtf8("Crème fraîche"), "Apples", ""};
+    for (int i = 0; i < 100; ++i) {
+        Product product;
+        product.id = QString("P-%1").arg(i, 3, 10, QChar('0'));
+        product.name = names.at(i % names.size()) + QString::number(i % 7);
+        product.price = Money::fromCents(i * 37 - 50);
+        product.quantity = i * 11;
+        products.append(product);
+    }
+    return products;
+}
+}
+
+class InventorySnapshotTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void roundTrip();
+    void emptyCatalog();
+    void staleAfterCsvChanges();
+    void rejectsCorruption();
+    void missingFile();
+
+private:
+    QString csvPath() const { return dir->filePath("inventory.csv"); }
+    QString snapshotPath() const { return dir->filePath("inventory.snapshot"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void InventorySnapshotTest::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    // Only its size and mtime matter to the snapshot.
+    QVERIFY(writeFile(csvPath(), "id,name,price,quantity\nP-000,Apples0,-0.50,0\n"));
+}
+
+void InventorySnapshotTest::roundTrip()
+{
+    const ProductStore products = sampleProducts();
+    QString error;
+    QVERIFY2(InventorySnapshot::write(products, snapshotPath(), csvPath(), &error),
+             qPrintable(error));
+
+    ProductStore loaded;
+    QVERIFY2(InventorySnapshot::read(snapshotPath(), csvPath(), &loaded, &error),
+             qPrintable(error));
+    QCOMPARE(loaded.size(), products.size());
+    for (int row = 0; row < products.size(); ++row) {
+        QCOMPARE(loaded.id(row), products.id(row));
+        QCOMPARE(loaded.name(row), products.name(row));
+        QCOMPARE(loaded.price(row), products.price(row));
+        QCOMPARE(loaded.quantity(row), products.quantity(row));
+    }
+    // The ID index is rebuilt too.
+    QCOMPARE(loaded.findId("P-042"), 42);
+    QCOMPARE(loaded.findId("P-999"), -1);
+}
+
+void InventorySnapshotTest::emptyCatalog()
+{
+    QString error;
+    QVERIFY2(InventorySnapshot::write(ProductStore(), snapshotPath(), csvPath(), &error),
+             qPrintable(error));
+    ProductStore loaded = sampleProducts();
+    QVERIFY2(InventorySnapshot::read(snapshotPath(), csvPath(), &loaded, &error),
+             qPrintable(error));
+    QCOMPARE(loaded.size(), 0);
+}
+
+void InventorySnapshotTest::staleAfterCsvChanges()
+{
+    QString error;
+    QVERIFY2(InventorySnapshot::write(sampleProducts(), snapshotPath(), csvPath(), &error),
+             qPrintable(error));
+    QVERIFY(writeFile(csvPath(), "id,name,price,quantity\n"));
+
+    ProductStore loaded;
+    QVERIFY(!InventorySnapshot::read(snapshotPath(), csvPath(), &loaded, &error));
+    QCOMPARE(loaded.size(), 0);
+}
+
+void InventorySnapshotTest::rejectsCorruption()
+{
+    QString error;
+    QVERIFY2(InventorySnapshot::write(sampleProducts(), snapshotPath(), csvPath(), &error),
+             qPrintable(error));
+    QFile file(snapshotPath());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.size() > kHeaderBytes);
+    QVERIFY(file.seek(kHeaderBytes + 3));
+    char byte = 0;
+    QVERIFY(file.getChar(&byte));
+    QVERIFY(file.seek(kHeaderBytes + 3));
+    QVERIFY(file.putChar(static_cast<char>(byte ^ 0x40)));
+    file.close();
+
+    ProductStore loaded;
+    QVERIFY(!InventorySnapshot::read(snapshotPath(), csvPath(), &loaded, &error));
+    QCOMPARE(loaded.size(), 0);
+
+    // A truncated file is refused the same way.
+    QVERIFY2(InventorySnapshot::write(sampleProducts(), snapshotPath(), csvPath(), &error),
+             qPrintable(error));
+    QVERIFY(QFile::resize(snapshotPath(), QFileInfo(snapshotPath()).size() - 8));
+    QVERIFY(!InventorySnapshot::read(snapshotPath(), csvPath(), &loaded, &error));
+}
+
+void InventorySnapshotTest::missingFile()
+{
+    ProductStore loaded;
+    QString error;
+    QVERIFY(!InventorySnapshot::read(snapshotPath(), csvPath(), &loaded, &error));
+}
+
+QTEST_GUILESS_MAIN(InventorySnapshotTest)
+#include "tst_inventorysnapshot.moc"
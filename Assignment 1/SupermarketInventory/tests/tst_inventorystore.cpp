@@ -0,0 +1,239 @@
+#include "appdata.h"
+#include "inventorystore.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QtTest>
+
+namespace {
+Product product(const QString &id, int quantity)
+{
+    Product result;
+    result.id = id;
+    result.name = "Item " + id;
+    result.price = Money::fromCents(199);
+    result.quantity = quantity;
+    return result;
+}
+
+SaleEvent sale(const QString &id, int delta)
+{
+    SaleEvent event;
+    event.productId = id;
+    event.delta = delta;
+    event.timestamp = QDateTime::currentMSecsSinceEpoch();
+    return event;
+}
+
+int quantityOf(const InventoryStore &store, const QString &id)
+{
+    const int row = store.find(id);
+    return row < 0 ? -1 : store.products().quantity(row);
+}
+
+int journalLines()
+{
+    QFile file(AppData::inventoryJournalPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    return file.readAll().count('\n');
+}
+}
+
+class InventoryStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void undoEditKeepsLaterSales();
+    void undoEditStopsAtZero();
+    void undoDeleteRestoresSoldStockAndLevel();
+    void journalReplayAndCheckpoint();
+    void readOnlyRejectsWrites();
+
+private:
+    bool open(InventoryStore *store);
+};
+
+void InventoryStoreTest::initTestCase()
+{
+    // The store works in the AppData folder; use a throwaway one.
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void InventoryStoreTest::init()
+{
+    QDir(AppData::dataDir()).removeRecursively();
+    QVERIFY(AppData::ensureDataDir());
+}
+
+void InventoryStoreTest::cleanup()
+{
+    QDir(AppData::dataDir()).removeRecursively();
+}
+
+bool InventoryStoreTest::open(InventoryStore *store)
+{
+    store->setWritable(true);
+    QString error;
+    if (!store->load(false, &error)) {
+        qWarning("load failed: %s", qPrintable(error));
+        return false;
+    }
+    return true;
+}
+
+void InventoryStoreTest::undoEditKeepsLaterSales()
+{
+    InventoryStore store;
+    QVERIFY(open(&store));
+    QString error;
+    QVERIFY2(store.add(product("P1", 10), &error), qPrintable(error));
+    Product edited = product("P1", 20);
+    edited.name = "Whole milk";
+    QVERIFY2(store.update(0, edited, &error), qPrintable(error));
+
+    StockDeltaResult result;
+    QVERIFY2(store.applyStockDeltas({sale("P1", -3), sale("P1", -1)}, &result, &error),
+             qPrintable(error));
+    QCOMPARE(result.applied, 1);
+    QCOMPARE(quantityOf(store, "P1"), 16);
+    QCOMPARE(store.undoText(), QString("Update P1"));
+
+    // Undo takes back the +10 of the edit, not the sales made since.
+    QVERIFY2(store.undo(&error), qPrintable(error));
+    QCOMPARE(quantityOf(store, "P1"), 6);
+    QCOMPARE(store.products().name(0), QString("Item P1"));
+    QCOMPARE(store.totals().units, qint64(6));
+
+    QVERIFY2(store.applyStockDeltas({sale("P1", -2)}, &result, &error), qPrintable(error));
+    QVERIFY2(store.redo(&error), qPrintable(error));
+    QCOMPARE(quantityOf(store, "P1"), 14);
+    QCOMPARE(store.products().name(0), QString("Whole milk"));
+    QCOMPARE(store.totals().units, qint64(14));
+}
+
+void InventoryStoreTest::undoEditStopsAtZero()
+{
+    InventoryStore store;
+    QVERIFY(open(&store));
+    QString error;
+    QVERIFY2(store.add(product("P1", 10), &error), qPrintable(error));
+    QVERIFY2(store.update(0, product("P1", 20), &error), qPrintable(error));
+    StockDeltaResult result;
+    QVERIFY2(store.applyStockDeltas({sale("P1", -15)}, &result, &error), qPrintable(error));
+    QCOMPARE(quantityOf(store, "P1"), 5);
+
+    // 5 - 10 would go below zero; redo gives back only what undo took.
+    QVERIFY2(store.undo(&error), qPrintable(error));
+    QCOMPARE(quantityOf(store, "P1"), 0);
+    QVERIFY2(store.redo(&error), qPrintable(error));
+    QCOMPARE(quantityOf(store, "P1"), 5);
+}
+
+void InventoryStoreTest::undoDeleteRestoresSoldStockAndLevel()
+{
+    InventoryStore store;
+    QVERIFY(open(&store));
+    QString error;
+    // Above the default level of 10, so only P2 is ever low.
+    QVERIFY2(store.add(product("P1", 50), &error), qPrintable(error));
+    QVERIFY2(store.add(product("P2", 8), &error), qPrintable(error));
+    QVERIFY2(store.add(product("P3", 30), &error), qPrintable(error));
+    QVERIFY2(store.setReorderLevel(1, 4, &error), qPrintable(error));
+    StockDeltaResult result;
+    QVERIFY2(store.applyStockDeltas({sale("P2", -5)}, &result, &error), qPrintable(error));
+    QVERIFY(store.isLowStock(1));
+
+    QVERIFY2(store.remove(1, &error), qPrintable(error));
+    QCOMPARE(store.find("P2"), -1);
+    QCOMPARE(store.find("P3"), 1);
+
+    QVERIFY2(store.undo(&error), qPrintable(error));
+    QCOMPARE(store.find("P2"), 1);
+    QCOMPARE(quantityOf(store, "P2"), 3);
+    QCOMPARE(store.reorderLevel(1), 4);
+    QVERIFY(store.isLowStock(1));
+    QCOMPARE(store.lowStockCount(), 1);
+
+    QVERIFY2(store.redo(&error), qPrintable(error));
+    QCOMPARE(store.find("P2"), -1);
+    QCOMPARE(store.size(), 2);
+    QCOMPARE(store.lowStockCount(), 0);
+}
+
+void InventoryStoreTest::journalReplayAndCheckpoint()
+{
+    QString error;
+    {
+        InventoryStore store;
+        QVERIFY(open(&store));
+        QVERIFY2(store.add(product("P1", 10), &error), qPrintable(error));
+        QVERIFY2(store.add(product("P2", 5), &error), qPrintable(error));
+        QVERIFY2(store.update(0, product("P1", 12), &error), qPrintable(error));
+        QVERIFY2(store.remove(1, &error), qPrintable(error));
+        StockDeltaResult result;
+        QVERIFY2(store.applyStockDeltas({sale("P1", -2)}, &result, &error), qPrintable(error));
+        QVERIFY(store.isModified());
+        // Gone without saving, as after a crash.
+    }
+    QVERIFY(!QFile::exists(AppData::inventoryFilePath()));
+    QVERIFY(journalLines() > 1);
+
+    {
+        InventoryStore store;
+        QVERIFY(open(&store));
+        QCOMPARE(store.size(), 1);
+        QCOMPARE(quantityOf(store, "P1"), 10);
+        QCOMPARE(store.find("P2"), -1);
+        // Replayed edits are not undoable steps of this session.
+        QVERIFY(!store.canUndo());
+
+        QVERIFY2(store.save(&error), qPrintable(error));
+        QVERIFY(!store.isModified());
+        QVERIFY(QFile::exists(AppData::inventoryFilePath()));
+        // The CSV holds everything, so the journal is down to its stamp.
+        QCOMPARE(journalLines(), 1);
+
+        QVERIFY2(store.add(product("P3", 7), &error), qPrintable(error));
+    }
+
+    InventoryStore store;
+    QVERIFY(open(&store));
+    QCOMPARE(store.size(), 2);
+    QCOMPARE(quantityOf(store, "P1"), 10);
+    QCOMPARE(quantityOf(store, "P3"), 7);
+    QCOMPARE(journalLines(), 2);
+}
+
+void InventoryStoreTest::readOnlyRejectsWrites()
+{
+    {
+        InventoryStore store;
+        QVERIFY(open(&store));
+        QString error;
+        QVERIFY2(store.add(product("P1", 10), &error), qPrintable(error));
+        QVERIFY2(store.save(&error), qPrintable(error));
+    }
+    const int lines = journalLines();
+
+    InventoryStore store;
+    store.setWritable(false);
+    QString error;
+    QVERIFY2(store.load(false, &error), qPrintable(error));
+    QCOMPARE(store.size(), 1);
+    QVERIFY(!store.add(product("P2", 1), &error));
+    QVERIFY(!error.isEmpty());
+    StockDeltaResult result;
+    QVERIFY(!store.applyStockDeltas({sale("P1", -1)}, &result, &error));
+    QCOMPARE(quantityOf(store, "P1"), 10);
+    QCOMPARE(journalLines(), lines);
+}
+
+QTEST_GUILESS_MAIN(InventoryStoreTest)
+#include "tst_inventorystore.moc"
@@ -0,0 +1,140 @@
+#include "salesqueue.h"
+#include <QThread>
+#include <QVector>
+#include <QtTest>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace {
+SaleEvent sale(const QString &id, int delta)
+{
+    SaleEvent event;
+    event.productId = id;
+    event.delta = delta;
+    event.timestamp = delta;
+    return event;
+}
+}
+
+class SalesQueueTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundsCapacityUp();
+    void refusesWhenFullAndEmpty();
+    void keepsOrder();
+    void contention();
+};
+
+void SalesQueueTest::roundsCapacityUp()
+{
+    QCOMPARE(SalesQueue(100).capacity(), 128);
+    QCOMPARE(SalesQueue(64).capacity(), 64);
+    QCOMPARE(SalesQueue(1).capacity(), 2);
+}
+
+void SalesQueueTest::refusesWhenFullAndEmpty()
+{
+    SalesQueue queue(4);
+    SaleEvent event;
+    QVERIFY(!queue.pop(&event));
+    for (int i = 0; i < queue.capacity(); ++i) {
+        QVERIFY(queue.push(sale("A", i)));
+    }
+    QCOMPARE(queue.size(), 4);
+    QVERIFY(!queue.push(sale("A", 99)));
+    QVERIFY(queue.pop(&event));
+    QVERIFY(queue.push(sale("A", 4)));
+    for (int i = 1; i <= 4; ++i) {
+        QVERIFY(queue.pop(&event));
+        QCOMPARE(event.delta, i);
+    }
+    QVERIFY(!queue.pop(&event));
+    QCOMPARE(queue.size(), 0);
+}
+
+void SalesQueueTest::keepsOrder()
+{
+    // Wrap around the ring many times.
+    SalesQueue queue(8);
+    SaleEvent event;
+    for (int i = 0; i < 1000; ++i) {
+        QVERIFY(queue.push(sale(QString::number(i), i)));
+        if (i % 3 == 2) {
+            for (int j = i - 2; j <= i; ++j) {
+                QVERIFY(queue.pop(&event));
+                QCOMPARE(event.delta, j);
+                QCOMPARE(event.productId, QString::number(j));
+                QCOMPARE(event.timestamp, qint64(j));
+            }
+        }
+    }
+}
+
+void SalesQueueTest::contention()
+{
+    // A small queue, so producers keep finding it full and consumers empty.
+    const int producers = 4;
+    const int consumers = 3;
+    const int perProducer = 50000;
+    SalesQueue queue(64);
+    std::atomic<int> popped{0};
+
+    // Each consumer notes what it got per producer; a producer's events
+    // must reach any one consumer in the order they were pushed.
+    QVector<QVector<QVector<int>>> seen(consumers, QVector<QVector<int>>(producers));
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back(QThread::create([&queue, p]() {
+            const QString id = QString::number(p);
+            for (int i = 0; i < perProducer; ++i) {
+                while (!queue.push(sale(id, i))) {
+                    QThread::yieldCurrentThread();
+                }
+            }
+        }));
+    }
+    for (int c = 0; c < consumers; ++c) {
+        QVector<QVector<int>> *mine = &seen[c];
+        threads.emplace_back(QThread::create([&queue, &popped, mine]() {
+            SaleEvent event;
+            while (popped.load() < producers * perProducer) {
+                if (queue.pop(&event)) {
+                    (*mine)[event.productId.toInt()].push_back(event.delta);
+                    popped.fetch_add(1);
+                } else {
+                    QThread::yieldCurrentThread();
+                }
+            }
+        }));
+    }
+    for (const auto &thread : threads) {
+        thread->start();
+    }
+    for (const auto &thread : threads) {
+        QVERIFY(thread->wait(60000));
+    }
+
+    QCOMPARE(popped.load(), producers * perProducer);
+    SaleEvent event;
+    QVERIFY(!queue.pop(&event));
+    for (int p = 0; p < producers; ++p) {
+        QVector<int> counts(perProducer, 0);
+        for (int c = 0; c < consumers; ++c) {
+            const QVector<int> &got = seen.at(c).at(p);
+            QVERIFY(std::is_sorted(got.begin(), got.end()));
+            for (int i : got) {
+                QVERIFY(i >= 0 && i < perProducer);
+                ++counts[i];
+            }
+        }
+        // Every event arrived exactly once.
+        QVERIFY(std::all_of(counts.begin(), counts.end(), [](int n) { return n == 1; }));
+    }
+}
+
+QTEST_GUILESS_MAIN(SalesQueueTest)
+#include "tst_salesqueue.moc"
@@ -0,0 +1,118 @@
+#include "scankernel.h"
+#include <QRandomGenerator>
+#include <QVector>
+#include <QtTest>
+
+Q_DECLARE_METATYPE(ScanKernel::Implementation)
+
+namespace {
+QVector<char16_t> randomText(QRandomGenerator *random, int size, int alphabet)
+{
+    QVector<char16_t> text(size);
+    for (char16_t &unit : text) {
+        unit = static_cast<char16_t>(u'a' + random->bounded(alphabet));
+    }
+    return text;
+}
+}
+
+class ScanKernelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void implementationIsAvailable();
+    void edgeCases_data();
+    void edgeCases();
+    void matchesScalar_data();
+    void matchesScalar();
+
+private:
+    void addImplementations();
+};
+
+void ScanKernelTest::addImplementations()
+{
+    QTest::addColumn<ScanKernel::Implementation>("implementation");
+    const ScanKernel::Implementation all[] = {ScanKernel::Sse2, ScanKernel::Avx2};
+    const char *names[] = {"sse2", "avx2"};
+    for (int i = 0; i < 2; ++i) {
+        if (ScanKernel::isAvailable(all[i])) {
+            QTest::newRow(names[i]) << all[i];
+        }
+    }
+    // Always at least one row, so the scalar fallback is checked on its own.
+    QTest::newRow("scalar") << ScanKernel::Scalar;
+}
+
+void ScanKernelTest::implementationIsAvailable()
+{
+    QVERIFY(ScanKernel::isAvailable(ScanKernel::Scalar));
+    const QByteArray name = ScanKernel::implementation();
+    QVERIFY(name == "scalar" || name == "sse2" || name == "avx2");
+    if (name == "avx2") {
+        QVERIFY(ScanKernel::isAvailable(ScanKernel::Avx2));
+    }
+}
+
+void ScanKernelTest::edgeCases_data()
+{
+    addImplementations();
+}
+
+void ScanKernelTest::edgeCases()
+{
+    QFETCH(ScanKernel::Implementation, implementation);
+    auto find = [implementation](const QString &text, const QString &needle) {
+        return ScanKernel::findWith(implementation,
+                                    reinterpret_cast<const char16_t *>(text.utf16()), text.size(),
+                                    reinterpret_cast<const char16_t *>(needle.utf16()),
+                                    needle.size());
+    };
+    QCOMPARE(find("abc", ""), qint64(0));
+    QCOMPARE(find("", "a"), qint64(-1));
+    QCOMPARE(find("ab", "abc"), qint64(-1));
+    QCOMPARE(find("abc", "abc"), qint64(0));
+    // Matches in the last vector, past it in the scalar tail, and straddling both.
+    const QString long32 = QString(32, 'x');
+    QCOMPARE(find(long32 + "needle", "needle"), qint64(32));
+    QCOMPARE(find(QString(15, 'x') + "ab", "ab"), qint64(15));
+    QCOMPARE(find(QString(17, 'x') + "ab", "ab"), qint64(17));
+    QCOMPARE(find(long32 + "y", "y"), qint64(32));
+    // Units differing only in the high byte must not match.
+    QCOMPARE(find(QString(20, QChar(0x0161)) + QChar(0x0061), QString(QChar(0x0061))), qint64(20));
+    QCOMPARE(find(QString(20, QChar(0x0161)), QString(QChar(0x0061))), qint64(-1));
+    // First and last units match everywhere; only the middle decides.
+    QCOMPARE(find(QString("axa").repeated(20) + "aya", "aya"), qint64(60));
+    // The NULs between fields hide nothing.
+    QCOMPARE(find(QString("milk") + QChar(0) + "12.50" + QChar(0), "2.5"), qint64(6));
+}
+
+void ScanKernelTest::matchesScalar_data()
+{
+    addImplementations();
+}
+
+void ScanKernelTest::matchesScalar()
+{
+    QFETCH(ScanKernel::Implementation, implementation);
+    QRandomGenerator random(20240611);
+    for (int round = 0; round < 20000; ++round) {
+        // A small alphabet makes partial matches common.
+        const int alphabet = 2 + random.bounded(3);
+        const QVector<char16_t> text = randomText(&random, random.bounded(200), alphabet);
+        const QVector<char16_t> needle = randomText(&random, 1 + random.bounded(6), alphabet);
+        const qint64 expected = ScanKernel::findWith(ScanKernel::Scalar, text.constData(),
+                                                     text.size(), needle.constData(),
+                                                     needle.size());
+        const qint64 actual = ScanKernel::findWith(implementation, text.constData(), text.size(),
+                                                   needle.constData(), needle.size());
+        if (actual != expected) {
+            QFAIL(qPrintable(QString("round %1: got %2, expected %3")
+                                 .arg(round).arg(actual).arg(expected)));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(ScanKernelTest)
+#include "tst_scankernel.moc"
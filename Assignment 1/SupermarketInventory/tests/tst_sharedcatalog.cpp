@@ -0,0 +1,118 @@
+#include "productstore.h"
+#include "sharedcatalog.h"
+#include <QCoreApplication>
+#include <QtTest>
+
+namespace {
+Product product(const QString &id, const QString &name, qint64 cents, int quantity)
+{
+    Product result;
+    result.id = id;
+    result.name = name;
+    result.price = Money::fromCents(cents);
+    result.quantity = quantity;
+    return result;
+}
+}
+
+class SharedCatalogTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void nothingPublished();
+    void lookupAfterPublish();
+    void refreshMovesToNewGeneration();
+    void backgroundPublishKeepsNewest();
+
+private:
+    // One key per test, so runs never see each other's segments.
+    QString key;
+    int keys = 0;
+};
+
+void SharedCatalogTest::init()
+{
+    key = QString("tst_sharedcatalog-%1-%2").arg(QCoreApplication::applicationPid()).arg(++keys);
+}
+
+void SharedCatalogTest::nothingPublished()
+{
+    SharedCatalogReader reader(key);
+    QString error;
+    QVERIFY(!reader.attach(&error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!reader.isAttached());
+}
+
+void SharedCatalogTest::lookupAfterPublish()
+{
+    ProductStore products;
+    products.append(product("A1", "Apples", 199, 40));
+    products.append(product("B2", "Bread", 250, 0));
+    products.append(product("C3", "Cheese", 1099, 7));
+
+    SharedCatalogPublisher publisher(key);
+    QString error;
+    QVERIFY2(publisher.publish(products, &error), qPrintable(error));
+
+    SharedCatalogReader reader(key);
+    QVERIFY2(reader.attach(&error), qPrintable(error));
+    QCOMPARE(reader.generation(), publisher.generation());
+    QCOMPARE(reader.size(), 3);
+    for (int row = 0; row < products.size(); ++row) {
+        const int found = reader.find(products.id(row));
+        QVERIFY(found >= 0);
+        QCOMPARE(reader.id(found), products.id(row));
+        QCOMPARE(reader.name(found), products.name(row));
+        QCOMPARE(reader.price(found), products.price(row));
+        QCOMPARE(reader.quantity(found), products.quantity(row));
+    }
+    QCOMPARE(reader.find("Z9"), -1);
+    QCOMPARE(reader.find(QString()), -1);
+}
+
+void SharedCatalogTest::refreshMovesToNewGeneration()
+{
+    ProductStore products;
+    products.append(product("A1", "Apples", 199, 40));
+
+    SharedCatalogPublisher publisher(key);
+    QString error;
+    QVERIFY2(publisher.publish(products, &error), qPrintable(error));
+    SharedCatalogReader reader(key);
+    QVERIFY2(reader.attach(&error), qPrintable(error));
+    QVERIFY(!reader.refresh());
+
+    products.setQuantity(0, 39);
+    products.append(product("D4", "Dates", 450, 12));
+    QVERIFY2(publisher.publish(products, &error), qPrintable(error));
+
+    QVERIFY(reader.refresh());
+    QCOMPARE(reader.generation(), publisher.generation());
+    QCOMPARE(reader.size(), 2);
+    QCOMPARE(reader.quantity(reader.find("A1")), 39);
+    QCOMPARE(reader.name(reader.find("D4")), QString("Dates"));
+}
+
+void SharedCatalogTest::backgroundPublishKeepsNewest()
+{
+    SharedCatalogPublisher publisher(key);
+    ProductStore products;
+    for (int i = 0; i < 20; ++i) {
+        products.append(product(QString("P%1").arg(i), "Item", 100 + i, i));
+        publisher.publishInBackground(products);
+    }
+    publisher.waitForFinished();
+    QVERIFY(publisher.lastError().isEmpty());
+
+    SharedCatalogReader reader(key);
+    QString error;
+    QVERIFY2(reader.attach(&error), qPrintable(error));
+    QCOMPARE(reader.size(), 20);
+    QCOMPARE(reader.quantity(reader.find("P19")), 19);
+}
+
+QTEST_GUILESS_MAIN(SharedCatalogTest)
+#include "tst_sharedcatalog.moc"
@@ -0,0 +1,272 @@
+#include "stockhistory.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+#include <limits>
+
+namespace {
+// Movements per sealed block (see stockhistory.cpp).
+const int kBlockPoints = 1024;
+const qint64 kEnd = std::numeric_limits<qint64>::max();
+
+// Sales with an occasional restock, at uneven intervals.
+QVector<StockMovement> sampleMovements(int count, qint64 start)
+{
+    QVector<StockMovement> out;
+    qint64 timestamp = start;
+    for (int i = 0; i < count; ++i) {
+        timestamp += 1000 * (1 + i % 5) + (i % 3);
+        StockMovement movement;
+        movement.timestamp = timestamp;
+        if (i % 7 == 0) {
+            movement.delta = 20;
+            movement.reason = StockMovement::Edit;
+        } else {
+            movement.delta = -(1 + i % 3);
+            movement.reason = StockMovement::Sale;
+        }
+        out.push_back(movement);
+    }
+    return out;
+}
+
+void recordAll(StockHistory *history, const QString &id, const QVector<StockMovement> &list)
+{
+    for (const StockMovement &movement : list) {
+        history->record(id, movement.delta, movement.reason, movement.timestamp);
+    }
+}
+
+qint64 soldBetween(const QVector<StockMovement> &list, qint64 from, qint64 to)
+{
+    qint64 sold = 0;
+    for (const StockMovement &movement : list) {
+        if (movement.reason == StockMovement::Sale && movement.timestamp >= from &&
+            movement.timestamp < to) {
+            sold -= movement.delta;
+        }
+    }
+    return sold;
+}
+
+bool sameMovements(const QVector<StockMovement> &a, const QVector<StockMovement> &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a.at(i).timestamp != b.at(i).timestamp || a.at(i).delta != b.at(i).delta ||
+            a.at(i).reason != b.at(i).reason) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+class StockHistoryTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void sealsAndReopens();
+    void rangeQueries();
+    void timestampsNeverGoBackwards();
+    void recoversTornBlock();
+    void readOnlyLeavesFilesAlone();
+    void rejectsUnknownFile();
+
+private:
+    QString blocksPath() const { return dir->filePath("stock-history.blocks"); }
+    QString logPath() const { return dir->filePath("stock-history.log"); }
+    // Blocks file with two full blocks of "A" whose second block was cut short.
+    void writeTornHistory(const QVector<StockMovement> &list, qint64 *goodSize);
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void StockHistoryTest::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+}
+
+void StockHistoryTest::sealsAndReopens()
+{
+    const QVector<StockMovement> a = sampleMovements(2 * kBlockPoints + 300, 1000000);
+    const QVector<StockMovement> b = sampleMovements(10, 5000000);
+    QString error;
+    {
+        StockHistory history(blocksPath(), logPath());
+        QVERIFY2(history.open(true, &error), qPrintable(error));
+        recordAll(&history, "A", a);
+        recordAll(&history, "B,with,commas", b);
+        QVERIFY2(history.flush(&error), qPrintable(error));
+        QVERIFY(sameMovements(history.movements("A", 0, kEnd), a));
+    }
+    // Two blocks of A were sealed; the rest of A and all of B are in the log.
+    QVERIFY(QFileInfo(blocksPath()).size() > 16);
+
+    StockHistory history(blocksPath(), logPath());
+    QVERIFY2(history.open(true, &error), qPrintable(error));
+    QVERIFY(sameMovements(history.movements("A", 0, kEnd), a));
+    QVERIFY(sameMovements(history.movements("B,with,commas", 0, kEnd), b));
+    QVERIFY(history.movements("C", 0, kEnd).isEmpty());
+
+    // New movements continue the same series after a reopen.
+    const QVector<StockMovement> more = sampleMovements(kBlockPoints, a.last().timestamp);
+    recordAll(&history, "A", more);
+    QVERIFY2(history.flush(&error), qPrintable(error));
+    StockHistory reopened(blocksPath(), logPath());
+    QVERIFY2(reopened.open(true, &error), qPrintable(error));
+    QVERIFY(sameMovements(reopened.movements("A", 0, kEnd), a + more));
+}
+
+void StockHistoryTest::rangeQueries()
+{
+    const QVector<StockMovement> a = sampleMovements(3 * kBlockPoints + 17, 1000000);
+    const QVector<StockMovement> b = sampleMovements(100, 1000000);
+    QString error;
+    StockHistory history(blocksPath(), logPath());
+    QVERIFY2(history.open(true, &error), qPrintable(error));
+    recordAll(&history, "A", a);
+    recordAll(&history, "B", b);
+    QVERIFY2(history.flush(&error), qPrintable(error));
+
+    // Edges inside blocks, on block boundaries and around the open tail.
+    const QVector<qint64> edges = {a.at(0).timestamp, a.at(500).timestamp,
+                                   a.at(kBlockPoints).timestamp,
+                                   a.at(3 * kBlockPoints - 1).timestamp,
+                                   a.at(3 * kBlockPoints + 5).timestamp, kEnd};
+    const QVector<qint64> sold = history.unitsSold("A", edges);
+    QCOMPARE(sold.size(), edges.size() - 1);
+    for (int i = 0; i + 1 < edges.size(); ++i) {
+        QCOMPARE(sold.at(i), soldBetween(a, edges.at(i), edges.at(i + 1)));
+    }
+
+    const qint64 from = a.at(700).timestamp;
+    const qint64 to = a.at(2100).timestamp;
+    const QVector<StockMovement> range = history.movements("A", from, to);
+    QVERIFY(sameMovements(range, a.mid(700, 1400)));
+
+    const QVector<QPair<QString, qint64>> top = history.topSellers(0, kEnd, 5);
+    QCOMPARE(top.size(), 2);
+    QCOMPARE(top.at(0).first, QString("A"));
+    QCOMPARE(top.at(0).second, soldBetween(a, 0, kEnd));
+    QCOMPARE(top.at(1).first, QString("B"));
+    QCOMPARE(top.at(1).second, soldBetween(b, 0, kEnd));
+}
+
+void StockHistoryTest::timestampsNeverGoBackwards()
+{
+    QString error;
+    StockHistory history(blocksPath(), logPath());
+    QVERIFY2(history.open(true, &error), qPrintable(error));
+    history.record("A", -1, StockMovement::Sale, 5000);
+    history.record("A", -2, StockMovement::Sale, 4000);
+    const QVector<StockMovement> list = history.movements("A", 0, kEnd);
+    QCOMPARE(list.size(), 2);
+    QCOMPARE(list.at(1).timestamp, qint64(5000));
+    QCOMPARE(list.at(1).delta, -2);
+}
+
+void StockHistoryTest::writeTornHistory(const QVector<StockMovement> &list, qint64 *goodSize)
+{
+    QString error;
+    {
+        StockHistory history(blocksPath(), logPath());
+        QVERIFY2(history.open(true, &error), qPrintable(error));
+        recordAll(&history, "A", list.mid(0, kBlockPoints + 10));
+        QVERIFY2(history.flush(&error), qPrintable(error));
+    }
+    *goodSize = QFileInfo(blocksPath()).size();
+    {
+        StockHistory history(blocksPath(), logPath());
+        QVERIFY2(history.open(true, &error), qPrintable(error));
+        recordAll(&history, "A", list.mid(kBlockPoints + 10));
+        QVERIFY2(history.flush(&error), qPrintable(error));
+    }
+    // A crash while the second block was written: its movements are in the
+    // log, but only part of the block reached the file.
+    const qint64 fullSize = QFileInfo(blocksPath()).size();
+    QVERIFY(fullSize > *goodSize + 64);
+    QVERIFY(QFile::resize(blocksPath(), fullSize - 7));
+}
+
+void StockHistoryTest::recoversTornBlock()
+{
+    const QVector<StockMovement> a = sampleMovements(2 * kBlockPoints + 50, 1000000);
+    qint64 goodSize = 0;
+    writeTornHistory(a, &goodSize);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    QString error;
+    {
+        StockHistory history(blocksPath(), logPath());
+        QVERIFY2(history.open(true, &error), qPrintable(error));
+        QCOMPARE(QFileInfo(blocksPath()).size(), goodSize);
+        QVERIFY(sameMovements(history.movements("A", 0, kEnd), a));
+        // The dropped block is sealed again by the next flush.
+        StockMovement last = a.last();
+        last.timestamp += 1000;
+        history.record("A", last.delta, last.reason, last.timestamp);
+        QVERIFY2(history.flush(&error), qPrintable(error));
+        QVERIFY(QFileInfo(blocksPath()).size() > goodSize);
+    }
+
+    StockHistory history(blocksPath(), logPath());
+    QVERIFY2(history.open(true, &error), qPrintable(error));
+    const QVector<StockMovement> list = history.movements("A", 0, kEnd);
+    QCOMPARE(list.size(), a.size() + 1);
+    QVERIFY(sameMovements(list.mid(0, a.size()), a));
+}
+
+void StockHistoryTest::readOnlyLeavesFilesAlone()
+{
+    const QVector<StockMovement> a = sampleMovements(2 * kBlockPoints + 50, 1000000);
+    qint64 goodSize = 0;
+    writeTornHistory(a, &goodSize);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+    const qint64 tornSize = QFileInfo(blocksPath()).size();
+    const qint64 logSize = QFileInfo(logPath()).size();
+
+    QString error;
+    StockHistory history(blocksPath(), logPath());
+    QVERIFY2(history.open(false, &error), qPrintable(error));
+    QVERIFY(sameMovements(history.movements("A", 0, kEnd), a));
+    history.record("A", -1, StockMovement::Sale, a.last().timestamp + 1000);
+    QVERIFY2(history.flush(&error), qPrintable(error));
+    QCOMPARE(QFileInfo(blocksPath()).size(), tornSize);
+    QCOMPARE(QFileInfo(logPath()).size(), logSize);
+
+    // Nor does it create missing files.
+    const QString otherBlocks = dir->filePath("other.blocks");
+    StockHistory empty(otherBlocks, dir->filePath("other.log"));
+    if (empty.open(false, &error)) {
+        QVERIFY(empty.movements("A", 0, kEnd).isEmpty());
+    }
+    QVERIFY(!QFile::exists(dir->filePath("other.log")));
+}
+
+void StockHistoryTest::rejectsUnknownFile()
+{
+    QFile file(blocksPath());
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not a stock history file");
+    file.close();
+
+    StockHistory history(blocksPath(), logPath());
+    QString error;
+    QVERIFY(!history.open(true, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!history.isOpen());
+}
+
+QTEST_GUILESS_MAIN(StockHistoryTest)
+#include "tst_stockhistory.moc"